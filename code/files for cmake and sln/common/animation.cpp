@@ -0,0 +1,166 @@
+#include <stdexcept>
+#include <glm/gtc/matrix_transform.hpp>
+#include "animation.h"
+#include "jobs.h"
+#include "profiler.h"
+
+using namespace glm;
+using namespace std;
+
+map<int, mat4> toJointLocalTransformations(const Pose& pose) {
+    map<int, mat4> jointLocalTransformations;
+    for (int j = 0; j < static_cast<int>(pose.size()); j++) {
+        jointLocalTransformations[j] =
+            translate(mat4(), pose[j].translation) * mat4_cast(pose[j].rotation);
+    }
+    return jointLocalTransformations;
+}
+
+void fromJointLocalTransformations(
+    const map<int, mat4>& jointLocalTransformations, Pose& pose) {
+    for (const auto& t : jointLocalTransformations) {
+        if (t.first >= static_cast<int>(pose.size())) {
+            pose.resize(t.first + 1);
+        }
+        pose[t.first].translation = vec3(t.second[3]);
+        pose[t.first].rotation = quat_cast(mat3(t.second));
+    }
+}
+
+JointPose interpolate(const JointPose& a, const JointPose& b, float w, BlendMode mode) {
+    JointPose result;
+    result.translation = mix(a.translation, b.translation, w);
+    if (mode == SLERP) {
+        result.rotation = slerp(a.rotation, b.rotation, w);
+    } else {
+        // nlerp along the shortest arc
+        quat qb = dot(a.rotation, b.rotation) < 0.0f ? -b.rotation : b.rotation;
+        result.rotation = normalize(a.rotation * (1.0f - w) + qb * w);
+    }
+    return result;
+}
+
+mat4 interpolateRigid(const mat4& a, const mat4& b, float w, BlendMode mode) {
+    JointPose pa = {vec3(a[3]), quat_cast(mat3(a))};
+    JointPose pb = {vec3(b[3]), quat_cast(mat3(b))};
+    JointPose p = interpolate(pa, pb, w, mode);
+    return translate(mat4(), p.translation) * mat4_cast(p.rotation);
+}
+
+JointMask createJointMask(int jointCount, const vector<int>& joints, float weight) {
+    JointMask mask(jointCount, 0.0f);
+    for (int j : joints) {
+        mask[j] = weight;
+    }
+    return mask;
+}
+
+void evaluateInputs(AnimationNode* a, AnimationNode* b, float time, JobSystem* jobs) {
+    if (jobs && jobs->workerCount() > 0) {
+        // a runs on a worker while this thread evaluates b
+        JobCounter counter;
+        jobs->run(counter, [a, time, jobs]() { a->evaluate(time, jobs); });
+        b->evaluate(time, jobs);
+        jobs->wait(counter);
+    } else {
+        a->evaluate(time, jobs);
+        b->evaluate(time, jobs);
+    }
+}
+
+AnimationNode::AnimationNode(int jointCount) : output(jointCount), frozen(NULL) {
+}
+
+ClipNode::ClipNode(int jointCount, const Sampler& sampler, float speed)
+    : AnimationNode(jointCount), sampler(sampler), speed(speed), timeOffset(0.0f) {
+}
+
+void ClipNode::evaluate(float time, JobSystem*) {
+    sampler(time * speed + timeOffset, output);
+}
+
+BlendNode::BlendNode(int jointCount, AnimationNode* a, AnimationNode* b,
+                     BlendMode mode)
+    : AnimationNode(jointCount), a(a), b(b), mode(mode), weight(0.5f) {
+}
+
+void BlendNode::evaluate(float time, JobSystem* jobs) {
+    evaluateInputs(a, b, time, jobs);
+
+    for (int j = 0; j < static_cast<int>(output.size()); j++) {
+        if (frozen && (*frozen)[j] != 0.0f) continue;
+        float w = mask.empty() ? weight : weight * mask[j];
+        output[j] = interpolate(a->output[j], b->output[j], w, mode);
+    }
+}
+
+AdditiveNode::AdditiveNode(int jointCount, AnimationNode* base,
+                           AnimationNode* additive, const Pose& reference)
+    : AnimationNode(jointCount), base(base), additive(additive),
+    reference(reference), weight(1.0f) {
+    this->reference.resize(jointCount);
+}
+
+void AdditiveNode::evaluate(float time, JobSystem* jobs) {
+    evaluateInputs(base, additive, time, jobs);
+
+    for (int j = 0; j < static_cast<int>(output.size()); j++) {
+        if (frozen && (*frozen)[j] != 0.0f) continue;
+        float w = mask.empty() ? weight : weight * mask[j];
+        const JointPose& pb = base->output[j];
+        const JointPose& pa = additive->output[j];
+        quat delta = inverse(reference[j].rotation) * pa.rotation;
+        output[j].translation = pb.translation +
+            w * (pa.translation - reference[j].translation);
+        output[j].rotation = normalize(pb.rotation * slerp(quat(), delta, w));
+    }
+}
+
+AnimationGraph::AnimationGraph(int jointCount) : jointCount(jointCount), root(NULL) {
+}
+
+AnimationGraph::~AnimationGraph() {
+    for (AnimationNode* node : nodes) {
+        delete node;
+    }
+}
+
+ClipNode* AnimationGraph::addClip(const ClipNode::Sampler& sampler, float speed) {
+    ClipNode* node = new ClipNode(jointCount, sampler, speed);
+    nodes.push_back(node);
+    root = node;
+    return node;
+}
+
+BlendNode* AnimationGraph::addBlend(AnimationNode* a, AnimationNode* b, BlendMode mode) {
+    BlendNode* node = new BlendNode(jointCount, a, b, mode);
+    nodes.push_back(node);
+    root = node;
+    return node;
+}
+
+AdditiveNode* AnimationGraph::addAdditive(AnimationNode* base, AnimationNode* additive,
+                                          const Pose& reference) {
+    AdditiveNode* node = new AdditiveNode(jointCount, base, additive, reference);
+    nodes.push_back(node);
+    root = node;
+    return node;
+}
+
+const Pose& AnimationGraph::evaluate(float time, JobSystem* jobs, const JointMask* frozen) {
+    PROFILE_SCOPE("AnimationGraph::evaluate");
+    if (root == NULL) {
+        throw runtime_error("Animation graph has no nodes");
+    }
+    for (AnimationNode* node : nodes) {
+        node->frozen = frozen;
+    }
+    root->evaluate(time, jobs);
+    return root->output;
+}
+
+void evaluateGraphs(const vector<AnimationGraph*>& graphs, float time, JobSystem& jobs) {
+    jobs.parallelFor(static_cast<int>(graphs.size()), [&graphs, time, &jobs](int i) {
+        graphs[i]->evaluate(time, &jobs);
+    });
+}
@@ -0,0 +1,156 @@
+#ifndef ANIMATION_H
+#define ANIMATION_H
+
+#include <vector>
+#include <map>
+#include <functional>
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+class JobSystem;
+
+/* Local transformation of a joint split in translation and rotation */
+struct JointPose {
+    glm::vec3 translation;
+    glm::quat rotation;
+};
+
+/* A flat pose buffer, indexed by joint */
+typedef std::vector<JointPose> Pose;
+
+/* Per joint blend weights in [0, 1], e.g. 1 only on the hand joints */
+typedef std::vector<float> JointMask;
+
+/* Convert between pose buffers and the maps used by Skeleton::setPose() */
+std::map<int, glm::mat4> toJointLocalTransformations(const Pose& pose);
+void fromJointLocalTransformations(
+    const std::map<int, glm::mat4>& jointLocalTransformations, Pose& pose);
+
+/**
+* Interpolate between two joint poses. LERP normalizes the interpolated
+* quaternion (nlerp), SLERP interpolates along the great arc.
+*/
+enum BlendMode { LERP, SLERP };
+JointPose interpolate(const JointPose& a, const JointPose& b, float w,
+                      BlendMode mode = SLERP);
+
+/* Interpolate transformations made of a rotation and a translation only */
+glm::mat4 interpolateRigid(const glm::mat4& a, const glm::mat4& b, float w,
+                           BlendMode mode = LERP);
+
+/* A mask that is weight on the given joints and 0 everywhere else */
+JointMask createJointMask(int jointCount, const std::vector<int>& joints,
+                          float weight = 1.0f);
+
+/**
+* A node of an animation graph. Every node owns the pose buffer it evaluates
+* into, so evaluating a graph allocates nothing.
+*/
+class AnimationNode {
+public:
+    AnimationNode(int jointCount);
+    virtual ~AnimationNode() {}
+
+    /* Evaluate the node (and its inputs) into output */
+    virtual void evaluate(float time, JobSystem* jobs) = 0;
+
+    Pose output;
+    // joints with a nonzero entry are skipped by the blending nodes and keep
+    // their last output, set by AnimationGraph::evaluate()
+    const JointMask* frozen;
+};
+
+/**
+* Samples a clip. The sampler writes the pose of the clip at the given local
+* time; it may be called from a worker thread.
+*/
+class ClipNode : public AnimationNode {
+public:
+    typedef std::function<void(float time, Pose& pose)> Sampler;
+
+    ClipNode(int jointCount, const Sampler& sampler, float speed = 1.0f);
+    void evaluate(float time, JobSystem* jobs) override;
+
+    Sampler sampler;
+    float speed;
+    float timeOffset;
+};
+
+/**
+* Blends b over a by weight, see interpolate(). An optional mask scales the
+* weight per joint, e.g. a hand only override.
+*/
+class BlendNode : public AnimationNode {
+public:
+    BlendNode(int jointCount, AnimationNode* a, AnimationNode* b,
+              BlendMode mode = SLERP);
+    void evaluate(float time, JobSystem* jobs) override;
+
+    AnimationNode* a;
+    AnimationNode* b;
+    BlendMode mode;
+    float weight;
+    JointMask mask;   // empty means every joint is blended by weight
+};
+
+/**
+* Adds the difference between additive and reference on top of base, scaled
+* by weight (and mask).
+*/
+class AdditiveNode : public AnimationNode {
+public:
+    AdditiveNode(int jointCount, AnimationNode* base, AnimationNode* additive,
+                 const Pose& reference);
+    void evaluate(float time, JobSystem* jobs) override;
+
+    AnimationNode* base;
+    AnimationNode* additive;
+    Pose reference;
+    float weight;
+    JointMask mask;
+};
+
+/**
+* Evaluates the two inputs of a node, in parallel when a job system is given.
+* Used by the nodes with more than one input.
+*/
+void evaluateInputs(AnimationNode* a, AnimationNode* b, float time, JobSystem* jobs);
+
+/**
+* An animation graph of one character. The graph owns its nodes; the node
+* added last is the output unless setRoot() is called. Nodes must form a tree,
+* since a node feeding two parents would be evaluated twice and possibly
+* concurrently.
+*/
+class AnimationGraph {
+public:
+    AnimationGraph(int jointCount);
+    AnimationGraph(const AnimationGraph&) = delete;
+    AnimationGraph& operator=(const AnimationGraph&) = delete;
+    ~AnimationGraph();
+
+    ClipNode* addClip(const ClipNode::Sampler& sampler, float speed = 1.0f);
+    BlendNode* addBlend(AnimationNode* a, AnimationNode* b, BlendMode mode = SLERP);
+    AdditiveNode* addAdditive(AnimationNode* base, AnimationNode* additive,
+                              const Pose& reference);
+    void setRoot(AnimationNode* node) { root = node; }
+
+    /**
+    * Evaluate the graph, independent branches run on the job system if any.
+    * The joints set in frozen are not blended and keep their last pose in the
+    * blending nodes; clips still sample every joint.
+    */
+    const Pose& evaluate(float time, JobSystem* jobs = NULL, const JointMask* frozen = NULL);
+
+    int jointCount;
+
+private:
+    std::vector<AnimationNode*> nodes;
+    AnimationNode* root;
+};
+
+/* Evaluate the graphs of many characters in parallel */
+void evaluateGraphs(const std::vector<AnimationGraph*>& graphs, float time,
+                    JobSystem& jobs);
+
+#endif
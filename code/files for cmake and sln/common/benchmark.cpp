@@ -0,0 +1,210 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include "benchmark.h"
+
+using namespace std;
+
+FrameTimer::FrameTimer(int latency) : queries(std::max(latency, 1)), frame(0), collected(0) {
+    glGenQueries(static_cast<GLsizei>(queries.size()), &queries[0]);
+}
+
+FrameTimer::~FrameTimer() {
+    glDeleteQueries(static_cast<GLsizei>(queries.size()), &queries[0]);
+}
+
+void FrameTimer::beginFrame() {
+    // the query about to be reused must have been read
+    if (frame - collected >= static_cast<int>(queries.size())) {
+        collect(true);
+    }
+    glBeginQuery(GL_TIME_ELAPSED, queries[frame % queries.size()]);
+    start = chrono::steady_clock::now();
+}
+
+void FrameTimer::endFrame() {
+    cpu.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    glEndQuery(GL_TIME_ELAPSED);
+    frame++;
+    collect(false);
+}
+
+void FrameTimer::finish() {
+    while (collected < frame) {
+        collect(true);
+    }
+}
+
+void FrameTimer::collect(bool wait) {
+    // results arrive in order, so stop at the first one that is not ready
+    while (collected < frame) {
+        GLuint query = queries[collected % queries.size()];
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(query, GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return;
+        }
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        gpu.push_back(nanoseconds / 1e6);
+        collected++;
+        wait = false;
+    }
+}
+
+LatencyTracker::LatencyTracker(int latency)
+    : queries(std::max(latency, 1)), inputTimes(queries.size()),
+    inputTime(chrono::steady_clock::now()), frame(0), collected(0), average(0) {
+    glGenQueries(static_cast<GLsizei>(queries.size()), &queries[0]);
+}
+
+LatencyTracker::~LatencyTracker() {
+    glDeleteQueries(static_cast<GLsizei>(queries.size()), &queries[0]);
+}
+
+void LatencyTracker::inputSampled() {
+    inputTime = chrono::steady_clock::now();
+}
+
+void LatencyTracker::frameSubmitted(double predictedSeconds) {
+    if (frame - collected >= static_cast<int>(queries.size())) {
+        collect(true);
+    }
+    int slot = frame % queries.size();
+    glQueryCounter(queries[slot], GL_TIMESTAMP);
+    inputTimes[slot] = inputTime;
+    FrameLatency latency;
+    latency.submitted = chrono::duration<double, milli>(
+        chrono::steady_clock::now() - inputTime).count();
+    latency.completed = 0;
+    latency.predicted = predictedSeconds * 1e3;
+    latencies.push_back(latency);
+    frame++;
+    collect(false);
+}
+
+void LatencyTracker::finish() {
+    while (collected < frame) {
+        collect(true);
+    }
+}
+
+void LatencyTracker::collect(bool wait) {
+    // the GPU clock is moved onto the CPU clock with the current offset
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    auto cpuNow = chrono::steady_clock::now();
+
+    // results arrive in order, so stop at the first one that is not ready
+    while (collected < frame) {
+        int slot = collected % queries.size();
+        if (!wait) {
+            GLint available = 0;
+            glGetQueryObjectiv(queries[slot], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) return;
+        }
+        GLuint64 completed = 0;
+        glGetQueryObjectui64v(queries[slot], GL_QUERY_RESULT, &completed);
+        auto completedTime = cpuNow - chrono::nanoseconds(gpuNow - static_cast<GLint64>(completed));
+        double milliseconds = std::max(chrono::duration<double, milli>(
+            completedTime - inputTimes[slot]).count(), 0.0);
+        latencies[collected].completed = milliseconds;
+        average = average == 0 ? milliseconds * 1e-3 : 0.9 * average + 0.1 * milliseconds * 1e-3;
+        collected++;
+        wait = false;
+    }
+}
+
+void writeLatencies(const string& path, const vector<FrameLatency>& latencies) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        throw runtime_error("Can't open the file: " + path);
+    }
+    fprintf(file, "frame,submitted_ms,completed_ms,predicted_ms\n");
+    for (size_t f = 0; f < latencies.size(); f++) {
+        fprintf(file, "%d,%.4f,%.4f,%.4f\n", static_cast<int>(f), latencies[f].submitted,
+                latencies[f].completed, latencies[f].predicted);
+    }
+    fclose(file);
+}
+
+TimingSummary summarizeTimings(vector<double> milliseconds) {
+    TimingSummary summary = {0, 0, 0, 0, 0, 0};
+    if (milliseconds.empty()) return summary;
+    sort(milliseconds.begin(), milliseconds.end());
+    size_t n = milliseconds.size();
+    auto percentile = [&](double p) {
+        size_t rank = static_cast<size_t>(ceil(p * n));
+        return milliseconds[std::min(std::max(rank, size_t(1)), n) - 1];
+    };
+    double sum = 0;
+    for (double m : milliseconds) sum += m;
+    summary.mean = sum / n;
+    summary.median = percentile(0.5);
+    summary.p95 = percentile(0.95);
+    summary.p99 = percentile(0.99);
+    summary.min = milliseconds.front();
+    summary.max = milliseconds.back();
+    return summary;
+}
+
+static void writeSummaryJSON(FILE* file, const char* name, const TimingSummary& s) {
+    fprintf(file, "\"%s\": {\"mean\": %.4f, \"median\": %.4f, \"p95\": %.4f, "
+            "\"p99\": %.4f, \"min\": %.4f, \"max\": %.4f}",
+            name, s.mean, s.median, s.p95, s.p99, s.min, s.max);
+}
+
+static string escapeJSON(const string& s) {
+    string out;
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out;
+}
+
+void writeTimings(const string& path, const vector<pair<string, string> >& info,
+                  const vector<double>& cpuMilliseconds,
+                  const vector<double>& gpuMilliseconds) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        throw runtime_error("Can't open the file: " + path);
+    }
+    TimingSummary cpu = summarizeTimings(cpuMilliseconds);
+    TimingSummary gpu = summarizeTimings(gpuMilliseconds);
+    size_t frames = std::min(cpuMilliseconds.size(), gpuMilliseconds.size());
+
+    bool json = path.size() >= 5 && path.compare(path.size() - 5, 5, ".json") == 0;
+    if (json) {
+        fprintf(file, "{\n  \"info\": {");
+        for (size_t i = 0; i < info.size(); i++) {
+            fprintf(file, "%s\"%s\": \"%s\"", i ? ", " : "",
+                    escapeJSON(info[i].first).c_str(), escapeJSON(info[i].second).c_str());
+        }
+        fprintf(file, "},\n  \"summary\": {");
+        writeSummaryJSON(file, "cpu", cpu);
+        fprintf(file, ", ");
+        writeSummaryJSON(file, "gpu", gpu);
+        fprintf(file, "},\n  \"frames\": [");
+        for (size_t f = 0; f < frames; f++) {
+            fprintf(file, "%s\n    {\"cpu\": %.4f, \"gpu\": %.4f}", f ? "," : "",
+                    cpuMilliseconds[f], gpuMilliseconds[f]);
+        }
+        fprintf(file, "\n  ]\n}\n");
+    } else {
+        for (const auto& entry : info) {
+            fprintf(file, "# %s: %s\n", entry.first.c_str(), entry.second.c_str());
+        }
+        fprintf(file, "# cpu ms: mean %.4f median %.4f p95 %.4f p99 %.4f min %.4f max %.4f\n",
+                cpu.mean, cpu.median, cpu.p95, cpu.p99, cpu.min, cpu.max);
+        fprintf(file, "# gpu ms: mean %.4f median %.4f p95 %.4f p99 %.4f min %.4f max %.4f\n",
+                gpu.mean, gpu.median, gpu.p95, gpu.p99, gpu.min, gpu.max);
+        fprintf(file, "frame,cpu_ms,gpu_ms\n");
+        for (size_t f = 0; f < frames; f++) {
+            fprintf(file, "%d,%.4f,%.4f\n", static_cast<int>(f),
+                    cpuMilliseconds[f], gpuMilliseconds[f]);
+        }
+    }
+    fclose(file);
+}
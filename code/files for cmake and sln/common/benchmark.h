@@ -0,0 +1,109 @@
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <utility>
+
+/**
+* Measures the CPU time between beginFrame() and endFrame() and the GPU time
+* of the commands issued in between with GL_TIME_ELAPSED queries. Queries
+* are read back latency frames later, when their result is available, so
+* timing does not stall the pipeline.
+*/
+class FrameTimer {
+public:
+    FrameTimer(int latency = 4);
+    FrameTimer(const FrameTimer&) = delete;
+    FrameTimer& operator=(const FrameTimer&) = delete;
+    ~FrameTimer();
+
+    void beginFrame();
+    void endFrame();
+
+    /* Wait for the outstanding queries, call before reading the timings */
+    void finish();
+
+    const std::vector<double>& cpuMilliseconds() const { return cpu; }
+    const std::vector<double>& gpuMilliseconds() const { return gpu; }
+
+private:
+    std::vector<GLuint> queries;
+    int frame, collected;
+    std::chrono::steady_clock::time_point start;
+    std::vector<double> cpu, gpu;
+
+private:
+    void collect(bool wait);
+};
+
+/* Latencies of one frame in milliseconds, measured from sampling its input */
+struct FrameLatency {
+    double submitted;  // until its last command was issued
+    double completed;  // until the GPU finished it, the closest to photons we see
+    double predicted;  // how far ahead the view was extrapolated
+};
+
+/**
+* Measures input to frame completion latency. A GL_TIMESTAMP query after the
+* last command of the frame gives when the GPU finished it; it is read back
+* a few frames later and moved onto the CPU clock. The smoothed completion
+* latency tells a late latched camera how far ahead to predict.
+*/
+class LatencyTracker {
+public:
+    LatencyTracker(int latency = 4);
+    LatencyTracker(const LatencyTracker&) = delete;
+    LatencyTracker& operator=(const LatencyTracker&) = delete;
+    ~LatencyTracker();
+
+    /* Call when the input of the frame has been read */
+    void inputSampled();
+
+    /* Call after the last command of the frame, e.g. after the buffer swap */
+    void frameSubmitted(double predictedSeconds);
+
+    /* Smoothed completion latency in seconds, 0 before the first measurement */
+    double averageLatency() const { return average; }
+
+    /* Wait for the outstanding queries, call before reading the latencies */
+    void finish();
+
+    const std::vector<FrameLatency>& frames() const { return latencies; }
+
+private:
+    std::vector<GLuint> queries;
+    std::vector<std::chrono::steady_clock::time_point> inputTimes;
+    std::chrono::steady_clock::time_point inputTime;
+    int frame, collected;
+    double average;
+    std::vector<FrameLatency> latencies;
+
+private:
+    void collect(bool wait);
+};
+
+/* One CSV row per frame: frame,submitted_ms,completed_ms,predicted_ms */
+void writeLatencies(const std::string& path, const std::vector<FrameLatency>& latencies);
+
+struct TimingSummary {
+    double mean, median, p95, p99, min, max;
+};
+
+/* Nearest rank percentiles of a series of timings */
+TimingSummary summarizeTimings(std::vector<double> milliseconds);
+
+/**
+* Write per frame timings and their summary. A path ending in .json gets
+* {"info": {...}, "summary": {...}, "frames": [...]}, any other path a CSV
+* with one row per frame and the summary as # comments. info holds key/value
+* pairs that identify the run (scene, renderer, build).
+*/
+void writeTimings(const std::string& path,
+                  const std::vector<std::pair<std::string, std::string> >& info,
+                  const std::vector<double>& cpuMilliseconds,
+                  const std::vector<double>& gpuMilliseconds);
+
+#endif
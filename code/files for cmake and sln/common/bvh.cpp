@@ -0,0 +1,332 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <glm/gtc/matrix_transform.hpp>
+#include "bvh.h"
+#include "skeleton.h"
+
+using namespace glm;
+using namespace std;
+
+// tokenizer working directly on the mapped bytes, which are not null
+// terminated
+
+static bool isSpace(char c) {
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+static void skipSpaces(const char*& p, const char* end) {
+    while (p < end && isSpace(*p)) p++;
+}
+
+static string nextToken(const char*& p, const char* end) {
+    skipSpaces(p, end);
+    const char* start = p;
+    while (p < end && !isSpace(*p)) p++;
+    return string(start, p);
+}
+
+static void skipToken(const char*& p, const char* end) {
+    skipSpaces(p, end);
+    while (p < end && !isSpace(*p)) p++;
+}
+
+static void expectToken(const char*& p, const char* end, const char* expected) {
+    string token = nextToken(p, end);
+    if (token != expected) {
+        throw runtime_error("BVH: expected '" + string(expected) +
+                            "' but found '" + token + "'");
+    }
+}
+
+static float parseFloat(const char*& p, const char* end) {
+    skipSpaces(p, end);
+    if (p == end) throw runtime_error("BVH: unexpected end of file");
+
+    bool negative = false;
+    if (*p == '-' || *p == '+') {
+        negative = *p == '-';
+        p++;
+    }
+    double value = 0.0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10.0 + (*p - '0');
+        p++;
+    }
+    if (p < end && *p == '.') {
+        p++;
+        double scale = 0.1;
+        while (p < end && *p >= '0' && *p <= '9') {
+            value += (*p - '0') * scale;
+            scale *= 0.1;
+            p++;
+        }
+    }
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        p++;
+        bool negativeExponent = false;
+        if (p < end && (*p == '-' || *p == '+')) {
+            negativeExponent = *p == '-';
+            p++;
+        }
+        int exponent = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            exponent = exponent * 10 + (*p - '0');
+            p++;
+        }
+        value *= pow(10.0, negativeExponent ? -exponent : exponent);
+    }
+    if (p < end && !isSpace(*p)) {
+        throw runtime_error("BVH: malformed number");
+    }
+    return static_cast<float>(negative ? -value : value);
+}
+
+static BVHChannel parseChannel(const string& name) {
+    if (name == "Xposition") return XPOSITION;
+    if (name == "Yposition") return YPOSITION;
+    if (name == "Zposition") return ZPOSITION;
+    if (name == "Xrotation") return XROTATION;
+    if (name == "Yrotation") return YROTATION;
+    if (name == "Zrotation") return ZROTATION;
+    throw runtime_error("BVH: unknown channel " + name);
+}
+
+BVHClip::BVHClip(const string& path, int windowSize)
+    : frameCount(0), frameTime(0), channelCount(0), file(path),
+    motionBegin(NULL), windowSize(windowSize < 2 ? 2 : windowSize),
+    windowStart(0), windowCount(0), windowHead(0), resolvedMapping(NULL),
+    cursor(NULL), cursorFrame(0) {
+    const char* p = file.data();
+    const char* end = p + file.size();
+
+    expectToken(p, end, "HIERARCHY");
+    parseHierarchy(p, end);
+
+    expectToken(p, end, "Frames:");
+    frameCount = static_cast<int>(parseFloat(p, end));
+    expectToken(p, end, "Frame");
+    expectToken(p, end, "Time:");
+    frameTime = parseFloat(p, end);
+    if (frameCount <= 0 || frameTime <= 0.0f) {
+        throw runtime_error("BVH: invalid MOTION header in " + path);
+    }
+
+    motionBegin = p;
+    cursor = p;
+    cursorFrame = 0;
+    window.resize(this->windowSize * channelCount);
+}
+
+void BVHClip::parseHierarchy(const char*& p, const char* end) {
+    vector<int> stack;
+    string token = nextToken(p, end);
+    if (token != "ROOT") throw runtime_error("BVH: missing ROOT");
+
+    while (p < end) {
+        if (token == "ROOT" || token == "JOINT" || token == "End") {
+            BVHJoint joint;
+            joint.endSite = token == "End";
+            joint.name = nextToken(p, end);
+            if (joint.endSite) {
+                if (stack.empty()) throw runtime_error("BVH: End Site outside a joint");
+                joint.name = joints[stack.back()].name + "_end";
+            }
+            joint.parent = stack.empty() ? -1 : stack.back();
+            joint.firstChannel = channelCount;
+            expectToken(p, end, "{");
+            expectToken(p, end, "OFFSET");
+            joint.offset.x = parseFloat(p, end);
+            joint.offset.y = parseFloat(p, end);
+            joint.offset.z = parseFloat(p, end);
+            if (!joint.endSite) {
+                expectToken(p, end, "CHANNELS");
+                int n = static_cast<int>(parseFloat(p, end));
+                if (n < 0) throw runtime_error("BVH: negative channel count");
+                for (int i = 0; i < n; i++) {
+                    joint.channels.push_back(parseChannel(nextToken(p, end)));
+                }
+                channelCount += n;
+            }
+            stack.push_back(static_cast<int>(joints.size()));
+            joints.push_back(joint);
+        } else if (token == "}") {
+            if (stack.empty()) throw runtime_error("BVH: unbalanced braces");
+            stack.pop_back();
+        } else if (token == "MOTION") {
+            if (!stack.empty()) throw runtime_error("BVH: unbalanced braces");
+            if (channelCount == 0) throw runtime_error("BVH: no joint declares channels");
+            return;
+        } else {
+            throw runtime_error("BVH: unexpected token " + token);
+        }
+        token = nextToken(p, end);
+    }
+    throw runtime_error("BVH: missing MOTION section");
+}
+
+void BVHClip::decodeNext(float* out) {
+    const char* end = file.data() + file.size();
+    if (cursorFrame % CHECKPOINT_INTERVAL == 0 &&
+        cursorFrame / CHECKPOINT_INTERVAL == static_cast<int>(checkpoints.size())) {
+        checkpoints.push_back(cursor - motionBegin);
+    }
+    if (out) {
+        for (int i = 0; i < channelCount; i++) {
+            out[i] = parseFloat(cursor, end);
+        }
+    } else {
+        for (int i = 0; i < channelCount; i++) {
+            skipToken(cursor, end);
+        }
+    }
+    cursorFrame++;
+}
+
+void BVHClip::seek(int index) {
+    // restart from the closest known checkpoint unless the cursor is already
+    // closer, then skip the remaining frames without decoding them
+    int checkpoint = std::min(index / CHECKPOINT_INTERVAL,
+                              static_cast<int>(checkpoints.size()) - 1);
+    if (checkpoint >= 0 &&
+        (cursorFrame > index || cursorFrame < checkpoint * CHECKPOINT_INTERVAL)) {
+        cursor = motionBegin + checkpoints[checkpoint];
+        cursorFrame = checkpoint * CHECKPOINT_INTERVAL;
+    }
+    while (cursorFrame < index) {
+        decodeNext(NULL);
+    }
+}
+
+const float* BVHClip::frame(int index) {
+    if (index < 0 || index >= frameCount) {
+        throw out_of_range("BVH: frame index out of range");
+    }
+
+    // already decoded
+    if (index >= windowStart && index < windowStart + windowCount) {
+        return &window[((windowHead + index - windowStart) % windowSize) * channelCount];
+    }
+
+    // a frame behind the window or too far ahead: refill from that frame
+    int windowEnd = windowStart + windowCount;
+    if (index < windowStart || index - windowEnd >= windowSize) {
+        seek(index);
+        windowStart = index;
+        windowCount = 0;
+        windowHead = 0;
+    }
+
+    // slide the window forward until it contains the frame
+    int slot = 0;
+    while (windowStart + windowCount <= index) {
+        if (windowCount < windowSize) {
+            slot = (windowHead + windowCount) % windowSize;
+            windowCount++;
+        } else {
+            slot = windowHead;
+            windowHead = (windowHead + 1) % windowSize;
+            windowStart++;
+        }
+        decodeNext(&window[slot * channelCount]);
+    }
+    return &window[slot * channelCount];
+}
+
+map<int, mat4> BVHClip::getJointLocalTransformations(int index) {
+    const float* values = frame(index);
+    map<int, mat4> jointLocalTransformations;
+    for (int j = 0; j < static_cast<int>(joints.size()); j++) {
+        const BVHJoint& joint = joints[j];
+        vec3 translation = joint.offset;
+        mat4 rotation;
+        for (int c = 0; c < static_cast<int>(joint.channels.size()); c++) {
+            float value = values[joint.firstChannel + c];
+            switch (joint.channels[c]) {
+            case XPOSITION: translation.x += value; break;
+            case YPOSITION: translation.y += value; break;
+            case ZPOSITION: translation.z += value; break;
+            case XROTATION: rotation = rotate(rotation, radians(value), vec3(1, 0, 0)); break;
+            case YROTATION: rotation = rotate(rotation, radians(value), vec3(0, 1, 0)); break;
+            case ZROTATION: rotation = rotate(rotation, radians(value), vec3(0, 0, 1)); break;
+            }
+        }
+        jointLocalTransformations[j] = translate(mat4(), translation) * rotation;
+    }
+    return jointLocalTransformations;
+}
+
+void BVHClip::createJoints(Skeleton* skeleton) const {
+    for (int j = 0; j < static_cast<int>(joints.size()); j++) {
+        Joint* joint = new Joint();
+        joint->parent = joints[j].parent < 0 ? NULL : skeleton->joints[joints[j].parent];
+        joint->jointLocalTransformation = translate(mat4(), joints[j].offset);
+        skeleton->joints[j] = joint;
+    }
+}
+
+int BVHClip::findJoint(const string& name) const {
+    for (int j = 0; j < static_cast<int>(joints.size()); j++) {
+        if (joints[j].name == name) return j;
+    }
+    return -1;
+}
+
+vector<pair<int, int> > BVHClip::resolve(const vector<BVHChannelMapping>& mapping) const {
+    vector<pair<int, int> > result;
+    for (const auto& m : mapping) {
+        int j = findJoint(m.joint);
+        if (j < 0) {
+            throw runtime_error("BVH: no joint named " + m.joint);
+        }
+        const BVHJoint& joint = joints[j];
+        int channel = -1;
+        for (int c = 0; c < static_cast<int>(joint.channels.size()); c++) {
+            if (joint.channels[c] == m.channel) channel = joint.firstChannel + c;
+        }
+        if (channel < 0) {
+            throw runtime_error("BVH: joint " + m.joint + " lacks the mapped channel");
+        }
+        result.push_back(make_pair(channel, m.coordinate));
+    }
+    return result;
+}
+
+void BVHClip::sampleCoordinates(
+    float time,
+    const vector<BVHChannelMapping>& mapping,
+    map<int, float>& q) {
+    if (resolvedMapping != &mapping || resolved.size() != mapping.size()) {
+        resolved = resolve(mapping);
+        resolvedMapping = &mapping;
+    }
+
+    float duration = frameCount * frameTime;
+    float t = fmod(time, duration);
+    if (t < 0.0f) t += duration;
+    int f0 = std::min(static_cast<int>(t / frameTime), frameCount - 1);
+    int f1 = (f0 + 1) % frameCount;
+    float alpha = t / frameTime - f0;
+
+    // read the first frame before the second one may slide it out, aside
+    // from q since two mappings may target the same coordinate
+    const float* values = frame(f0);
+    firstValues.resize(resolved.size());
+    for (size_t i = 0; i < resolved.size(); i++) {
+        firstValues[i] = values[resolved[i].first];
+    }
+    values = frame(f1);
+    for (int i = 0; i < static_cast<int>(resolved.size()); i++) {
+        const BVHChannelMapping& m = mapping[i];
+        float a = firstValues[i];
+        float b = values[resolved[i].first];
+        if (m.channel >= XROTATION) {
+            // interpolate angles along the shortest arc
+            float delta = b - a;
+            delta -= 360.0f * floor((delta + 180.0f) / 360.0f);
+            q[resolved[i].second] = (a + alpha * delta) * m.scale;
+        } else {
+            q[resolved[i].second] = (a + alpha * (b - a)) * m.scale;
+        }
+    }
+}
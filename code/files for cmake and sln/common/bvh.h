@@ -0,0 +1,115 @@
+#ifndef BVH_H
+#define BVH_H
+
+#include <vector>
+#include <string>
+#include <map>
+#include <glm/glm.hpp>
+#include "util.h"
+
+struct Skeleton;
+
+/* Channels that a BVH joint can declare, in the spelling of the file format */
+enum BVHChannel {
+    XPOSITION = 0, YPOSITION, ZPOSITION, XROTATION, YROTATION, ZROTATION
+};
+
+struct BVHJoint {
+    std::string name;
+    int parent;                  // index in BVHClip::joints, -1 for the root
+    glm::vec3 offset;            // rest offset from the parent joint
+    std::vector<BVHChannel> channels;
+    int firstChannel;            // index of the first channel inside a frame
+    bool endSite;                // End Site entries carry no channels
+};
+
+/**
+* Maps a BVH channel onto one of the generalized coordinates of a rig (the
+* CoordinateName enumerations of the lab). Rotations are in degrees, as in the
+* lab. Every channel is multiplied by scale, e.g. to convert positions from cm
+* or to flip the sign of a rotation.
+*/
+struct BVHChannelMapping {
+    std::string joint;
+    BVHChannel channel;
+    int coordinate;
+    float scale;
+};
+
+/**
+* A .bvh motion capture clip. The file is memory mapped and only the HIERARCHY
+* and the MOTION header are parsed on construction. Frames are decoded on
+* demand into a sliding window of windowSize frames, so playing back an hour
+* long take uses the same memory as a short one. Sequential playback slides the
+* window forward; random access seeks using sparse byte offsets that are
+* recorded every CHECKPOINT_INTERVAL frames while the file is scanned.
+*/
+class BVHClip {
+public:
+    static const int CHECKPOINT_INTERVAL = 64;
+
+    BVHClip(const std::string& path, int windowSize = 256);
+
+    /* Channel values of a frame, valid until the window slides again */
+    const float* frame(int index);
+
+    /* Joint local transformations of a frame, keyed by joint index */
+    std::map<int, glm::mat4> getJointLocalTransformations(int index);
+
+    /**
+    * Create one Joint per BVH joint (End Sites included) and add them to the
+    * skeleton using the joint index as key. Parents always have a smaller
+    * index than their children.
+    */
+    void createJoints(Skeleton* skeleton) const;
+
+    /* Resolve a mapping to (channel index in frame, coordinate) pairs */
+    std::vector<std::pair<int, int> > resolve(
+        const std::vector<BVHChannelMapping>& mapping) const;
+
+    /**
+    * Write the mapped channels at the given time (seconds) into q,
+    * interpolating linearly between the two nearest frames. The clip loops.
+    * The mapping is resolved once and cached, so pass a long lived table.
+    */
+    void sampleCoordinates(
+        float time,
+        const std::vector<BVHChannelMapping>& mapping,
+        std::map<int, float>& q);
+
+    int findJoint(const std::string& name) const;
+
+public:
+    std::vector<BVHJoint> joints;
+    int frameCount;
+    float frameTime;
+    int channelCount;
+
+private:
+    MappedFile file;
+    const char* motionBegin;     // first byte of the first frame
+
+    // sliding window of decoded frames, stored as a ring buffer
+    int windowSize;
+    std::vector<float> window;
+    int windowStart, windowCount, windowHead;
+
+    // byte offset of every CHECKPOINT_INTERVAL-th frame seen so far
+    std::vector<size_t> checkpoints;
+
+    // cached result of resolve() for the last mapping passed to sample
+    const std::vector<BVHChannelMapping>* resolvedMapping;
+    std::vector<std::pair<int, int> > resolved;
+    std::vector<float> firstValues;  // the mapped channels of the earlier frame
+
+    // scanning position, i.e. the frame that will be decoded next
+    const char* cursor;
+    int cursorFrame;
+
+private:
+    void parseHierarchy(const char*& p, const char* end);
+    void seek(int index);
+    void decodeNext(float* out);
+};
+
+#endif
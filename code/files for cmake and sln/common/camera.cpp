@@ -4,6 +4,25 @@
 
 using namespace glm;
 
+static mat4 viewFromAngles(const vec3& position, float horizontalAngle, float verticalAngle) {
+    vec3 direction(
+        cos(verticalAngle) * sin(horizontalAngle),
+        sin(verticalAngle),
+        cos(verticalAngle) * cos(horizontalAngle)
+    );
+    vec3 right(
+        sin(horizontalAngle - 3.14f / 2.0f),
+        0,
+        cos(horizontalAngle - 3.14f / 2.0f)
+    );
+    vec3 up = cross(right, direction);
+    return lookAt(
+        position,
+        position + direction,
+        up
+    );
+}
+
 Camera::Camera(GLFWwindow* window) : window(window) {
     position = vec3(0, 10, 5.0f);
     horizontalAngle = 3.14f;
@@ -12,6 +31,9 @@ Camera::Camera(GLFWwindow* window) : window(window) {
     speed = 3.0f;
     mouseSpeed = 0.001f;
     fovSpeed = 2.0f;
+    captureCursor = true;
+    velocity = vec3(0);
+    horizontalAngularVelocity = verticalAngularVelocity = 0.0f;
 }
 
 void Camera::update() {
@@ -21,16 +43,19 @@ void Camera::update() {
     // Compute time difference between current and last frame
     double currentTime = glfwGetTime();
     float deltaTime = float(currentTime - lastTime);
+    vec3 lastPosition = position;
+    float lastHorizontalAngle = horizontalAngle, lastVerticalAngle = verticalAngle;
 
     // Get mouse position
-    double xPos, yPos;
-    glfwGetCursorPos(window, &xPos, &yPos);
-
     int width, height;
     glfwGetWindowSize(window, &width, &height);
+    double xPos = width / 2, yPos = height / 2;
+    if (captureCursor) {
+        glfwGetCursorPos(window, &xPos, &yPos);
 
-    // Reset mouse position for next frame
-    glfwSetCursorPos(window, width / 2, height / 2);
+        // Reset mouse position for next frame
+        glfwSetCursorPos(window, width / 2, height / 2);
+    }
 
     // Task 5.1: simple camera movement that moves in +-z and +-x axes
     /*/
@@ -81,9 +106,6 @@ void Camera::update() {
         cos(horizontalAngle - 3.14f / 2.0f)
     );
 
-    // Up vector
-    vec3 up = cross(right, direction);
-
     // Task 5.5: update camera position using the direction/right vectors
     // Move forward
     if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
@@ -111,16 +133,32 @@ void Camera::update() {
     }
 
     // Task 5.7: construct projection and view matrices
-    projectionMatrix = perspective(radians(FoV), 4.0f / 3.0f, 0.1f, 1000.0f);
-    viewMatrix = lookAt(
-        position,
-        position + direction,
-        up
-    );
+    updateMatrices();
     //*/
 
     // Homework XX: perform orthographic projection
 
+    // velocities averaged over a few frames, mouse input arrives unevenly
+    if (deltaTime > 0.0f) {
+        const float smoothing = 0.5f;
+        velocity = mix(velocity, (position - lastPosition) / deltaTime, smoothing);
+        horizontalAngularVelocity = mix(horizontalAngularVelocity,
+            (horizontalAngle - lastHorizontalAngle) / deltaTime, smoothing);
+        verticalAngularVelocity = mix(verticalAngularVelocity,
+            (verticalAngle - lastVerticalAngle) / deltaTime, smoothing);
+    }
+
     // For the next frame, the "last time" will be "now"
     lastTime = currentTime;
 }
+
+void Camera::updateMatrices() {
+    projectionMatrix = perspective(radians(FoV), 4.0f / 3.0f, 0.1f, 1000.0f);
+    viewMatrix = viewFromAngles(position, horizontalAngle, verticalAngle);
+}
+
+mat4 Camera::predictViewMatrix(float seconds) const {
+    return viewFromAngles(position + velocity * seconds,
+                          horizontalAngle + horizontalAngularVelocity * seconds,
+                          verticalAngle + verticalAngularVelocity * seconds);
+}
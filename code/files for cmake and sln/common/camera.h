@@ -19,9 +19,18 @@ public:
     float speed; // units / second
     float mouseSpeed;
     float fovSpeed;
+    // read the mouse and warp it back to the center, off for headless runs
+    bool captureCursor;
+    // smoothed rates of change measured by update(), for prediction
+    glm::vec3 velocity;
+    float horizontalAngularVelocity, verticalAngularVelocity;
 
     Camera(GLFWwindow* window);
     void update();
+    /* Recompute the matrices from position, angles and FoV (e.g. on replay) */
+    void updateMatrices();
+    /* View matrix of the pose extrapolated the given seconds ahead */
+    glm::mat4 predictViewMatrix(float seconds) const;
 };
 
 #endif
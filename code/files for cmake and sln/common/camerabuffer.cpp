@@ -0,0 +1,38 @@
+#include "camerabuffer.h"
+
+using namespace glm;
+
+CameraUniformBuffer::CameraUniformBuffer(GLuint binding) : binding(binding) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, 2 * CAMERA_EYES * sizeof(mat4), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+CameraUniformBuffer::~CameraUniformBuffer() {
+    glDeleteBuffers(1, &buffer);
+}
+
+void CameraUniformBuffer::update(const mat4& viewMatrix, const mat4& projectionMatrix) {
+    mat4 viewMatrices[CAMERA_EYES], projectionMatrices[CAMERA_EYES];
+    for (int eye = 0; eye < CAMERA_EYES; eye++) {
+        viewMatrices[eye] = viewMatrix;
+        projectionMatrices[eye] = projectionMatrix;
+    }
+    update(viewMatrices, projectionMatrices);
+}
+
+void CameraUniformBuffer::update(const mat4* viewMatrices, const mat4* projectionMatrices) {
+    // std140 lays mat4 arrays out as consecutive vec4 columns, like glm; the
+    // old storage is orphaned so that frames still in flight keep their matrices
+    mat4 matrices[2 * CAMERA_EYES];
+    for (int eye = 0; eye < CAMERA_EYES; eye++) {
+        matrices[eye] = viewMatrices[eye];
+        matrices[CAMERA_EYES + eye] = projectionMatrices[eye];
+    }
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(matrices), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(matrices), matrices);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
@@ -0,0 +1,37 @@
+#ifndef CAMERABUFFER_H
+#define CAMERABUFFER_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+/* Eyes of stereo rendering, mono uses the first */
+const int CAMERA_EYES = 2;
+
+/**
+* The view and projection matrices of each eye in a uniform buffer shared by
+* every program that declares
+*
+*     layout(std140) uniform CameraBlock { mat4 V[2]; mat4 P[2]; };
+*
+* and binds it to the buffer's binding point. As the matrices are no longer
+* uniforms of each program, the view can be sampled right before the draws
+* are submitted and written once.
+*/
+class CameraUniformBuffer {
+public:
+    CameraUniformBuffer(GLuint binding = 0);
+    CameraUniformBuffer(const CameraUniformBuffer&) = delete;
+    CameraUniformBuffer& operator=(const CameraUniformBuffer&) = delete;
+    ~CameraUniformBuffer();
+
+    /* Mono: every eye gets the same matrices */
+    void update(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+
+    /* Stereo: CAMERA_EYES matrices each, left eye first */
+    void update(const glm::mat4* viewMatrices, const glm::mat4* projectionMatrices);
+
+public:
+    GLuint buffer, binding;
+};
+
+#endif
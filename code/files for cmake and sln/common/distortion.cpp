@@ -0,0 +1,155 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "distortion.h"
+#include "glstate.h"
+
+using namespace glm;
+using namespace std;
+
+// interleaved vertex: position, eye, red, green and blue coordinates
+const int DISTORTION_VERTEX_FLOATS = 9;
+
+LensProfile defaultLensProfile() {
+    LensProfile lens;
+    lens.k1 = 0.22f;
+    lens.k2 = 0.24f;
+    lens.channelScale = vec3(0.994f, 1.0f, 1.014f);
+    // the top and bottom edges of the view sample those of the image
+    lens.scale = 1.0f / (1.0f + lens.k1 + lens.k2);
+    return lens;
+}
+
+void distortionCoordinates(const LensProfile& lens, const vec2& point, float aspect,
+                           vec2 coordinates[3]) {
+    // r is measured in half heights, so the lens stays round on wide views
+    vec2 p(point.x * aspect, point.y);
+    float r2 = dot(p, p);
+    float distortion = (1.0f + lens.k1 * r2 + lens.k2 * r2 * r2) * lens.scale;
+    for (int c = 0; c < 3; c++) {
+        vec2 q = p * (distortion * lens.channelScale[c]);
+        coordinates[c] = vec2(q.x / aspect, q.y) * 0.5f + 0.5f;
+    }
+}
+
+DistortionMesh::DistortionMesh(const LensProfile& lens, int eyes, float eyeAspect,
+                               int resolution)
+    : lens(lens), eyes(eyes), eyeAspect(eyeAspect) {
+    if (eyes < 1 || resolution < 1) {
+        throw runtime_error("Distortion mesh needs an eye and a quad per side");
+    }
+    int side = resolution + 1;
+    vector<float> data;
+    vector<unsigned int> indices;
+    data.reserve(eyes * side * side * DISTORTION_VERTEX_FLOATS);
+    for (int eye = 0; eye < eyes; eye++) {
+        unsigned int first = static_cast<unsigned int>(eye * side * side);
+        for (int j = 0; j < side; j++) {
+            for (int i = 0; i < side; i++) {
+                vec2 point = vec2(i, j) / static_cast<float>(resolution) * 2.0f - 1.0f;
+                vec2 coordinates[3];
+                distortionCoordinates(lens, point, eyeAspect, coordinates);
+                // the eye's viewport is its slice of the target
+                data.push_back((eye + 0.5f * (point.x + 1.0f)) * 2.0f / eyes - 1.0f);
+                data.push_back(point.y);
+                data.push_back(static_cast<float>(eye));
+                for (int c = 0; c < 3; c++) {
+                    data.push_back(coordinates[c].x);
+                    data.push_back(coordinates[c].y);
+                }
+            }
+        }
+        for (int j = 0; j < resolution; j++) {
+            for (int i = 0; i < resolution; i++) {
+                unsigned int corner = first + j * side + i;
+                indices.insert(indices.end(), {
+                    corner, corner + 1, corner + side + 1,
+                    corner, corner + side + 1, corner + side});
+            }
+        }
+    }
+    vertices = eyes * side * side;
+    indexCount = static_cast<GLsizei>(indices.size());
+
+    glGenVertexArrays(1, &VAO);
+    glBindVertexArray(VAO);
+
+    glGenBuffers(1, &VBO);
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, data.size() * sizeof(float), &data[0], GL_STATIC_DRAW);
+    GLsizei stride = DISTORTION_VERTEX_FLOATS * sizeof(float);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, stride, NULL);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(1, 1, GL_FLOAT, GL_FALSE, stride,
+                          reinterpret_cast<void*>(2 * sizeof(float)));
+    glEnableVertexAttribArray(1);
+    for (int c = 0; c < 3; c++) {
+        glVertexAttribPointer(2 + c, 2, GL_FLOAT, GL_FALSE, stride,
+                              reinterpret_cast<void*>((3 + 2 * c) * sizeof(float)));
+        glEnableVertexAttribArray(2 + c);
+    }
+
+    glGenBuffers(1, &elementVBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementVBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                 &indices[0], GL_STATIC_DRAW);
+
+    glBindVertexArray(0);
+}
+
+DistortionMesh::~DistortionMesh() {
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &elementVBO);
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void DistortionMesh::draw(GLStateCache* stateCache) {
+    if (stateCache) {
+        stateCache->bindVertexArray(VAO);
+    } else {
+        glBindVertexArray(VAO);
+    }
+    glDrawElements(GL_TRIANGLES, indexCount, GL_UNSIGNED_INT, NULL);
+}
+
+/* GL_LINEAR with GL_CLAMP_TO_EDGE of one channel, at normalized coordinates */
+static float sampleBilinear(const vector<unsigned char>& pixels, int width, int height,
+                            int channel, float u, float v) {
+    float x = u * width - 0.5f, y = v * height - 0.5f;
+    int x0 = static_cast<int>(floor(x)), y0 = static_cast<int>(floor(y));
+    float fx = x - x0, fy = y - y0;
+    auto texel = [&](int tx, int ty) {
+        tx = std::min(std::max(tx, 0), width - 1);
+        ty = std::min(std::max(ty, 0), height - 1);
+        return static_cast<float>(pixels[(ty * width + tx) * 4 + channel]);
+    };
+    return mix(mix(texel(x0, y0), texel(x0 + 1, y0), fx),
+               mix(texel(x0, y0 + 1), texel(x0 + 1, y0 + 1), fx), fy);
+}
+
+void distortionReference(const LensProfile& lens, int eyes,
+                         const vector<unsigned char>& source, int width, int height,
+                         vector<unsigned char>& destination) {
+    destination.assign(width * height * 4, 0);
+    int eyeWidth = width / eyes;
+    float aspect = static_cast<float>(eyeWidth) / height;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            int eye = std::min(x / eyeWidth, eyes - 1);
+            vec2 point((x - eye * eyeWidth + 0.5f) / eyeWidth * 2.0f - 1.0f,
+                       (y + 0.5f) / height * 2.0f - 1.0f);
+            vec2 coordinates[3];
+            distortionCoordinates(lens, point, aspect, coordinates);
+            unsigned char* pixel = &destination[(y * width + x) * 4];
+            for (int c = 0; c < 3; c++) {
+                const vec2& uv = coordinates[c];
+                // outside the eye image stays black
+                if (uv.x < 0.0f || uv.x > 1.0f || uv.y < 0.0f || uv.y > 1.0f) continue;
+                float value = sampleBilinear(source, width, height, c,
+                                             (eye + uv.x) / eyes, uv.y);
+                pixel[c] = static_cast<unsigned char>(std::min(value + 0.5f, 255.0f));
+            }
+            pixel[3] = 255;
+        }
+    }
+}
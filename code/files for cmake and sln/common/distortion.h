@@ -0,0 +1,79 @@
+#ifndef DISTORTION_H
+#define DISTORTION_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+class GLStateCache;
+
+/**
+* Radial model of a headset lens. A point at distance r from the lens center,
+* in units of the eye's half height, is drawn from the eye image at
+*
+*     r * (1 + k1 r^2 + k2 r^4) * scale * channelScale[c]
+*
+* for color channel c, which pre-distorts the image into a barrel that the
+* lens' pincushion undoes. The lens spreads colors apart, so each channel is
+* scaled a little differently to correct the chromatic aberration.
+*/
+struct LensProfile {
+    float k1, k2;
+    glm::vec3 channelScale;  // red, green, blue
+    float scale;             // zoom that fits the distorted image to the view
+};
+
+/* A lens profile of typical consumer headsets */
+LensProfile defaultLensProfile();
+
+/**
+* Where the output point of an eye samples the eye image, per color channel.
+* point is in [-1, 1] over the eye's viewport, aspect its width / height; the
+* coordinates are in [0, 1] over the eye image when inside it.
+*/
+void distortionCoordinates(const LensProfile& lens, const glm::vec2& point, float aspect,
+                           glm::vec2 coordinates[3]);
+
+/**
+* Warps eye images, side by side in one texture, through a mesh with the
+* distortion coordinates of each channel computed on the CPU at its vertices
+* and interpolated in between, instead of evaluating the polynomial for every
+* pixel. Finer meshes follow the lens more closely at the cost of vertices.
+* Drawn with the Distortion shaders.
+*/
+class DistortionMesh {
+public:
+    /* resolution is the quads along each side of an eye's grid */
+    DistortionMesh(const LensProfile& lens, int eyes, float eyeAspect, int resolution);
+    DistortionMesh(const DistortionMesh&) = delete;
+    DistortionMesh& operator=(const DistortionMesh&) = delete;
+    ~DistortionMesh();
+
+    /* Bind the eye texture to the program's eyeTexture sampler first */
+    void draw(GLStateCache* stateCache = NULL);
+
+    int vertexCount() const { return vertices; }
+    int triangleCount() const { return static_cast<int>(indexCount / 3); }
+
+public:
+    LensProfile lens;
+    int eyes;
+    float eyeAspect;
+
+private:
+    GLuint VAO, VBO, elementVBO;
+    int vertices;
+    GLsizei indexCount;
+};
+
+/**
+* CPU reference of the warp: the exact distortion at every pixel center and
+* bilinear filtering like the GPU's. Pixels are RGBA8 with rows bottom to top
+* as RenderTarget::readColor() returns them; source and destination have the
+* same size.
+*/
+void distortionReference(const LensProfile& lens, int eyes,
+                         const std::vector<unsigned char>& source, int width, int height,
+                         std::vector<unsigned char>& destination);
+
+#endif
@@ -0,0 +1,48 @@
+#include <cmath>
+#include <algorithm>
+#include "dynamicresolution.h"
+
+using namespace std;
+
+ResolutionController::ResolutionController(double targetMilliseconds, float minScale,
+                                           float maxScale)
+    : targetMilliseconds(targetMilliseconds), minScale(minScale), maxScale(maxScale),
+    headroom(0.1), dropFrames(2), raiseFrames(30), maxRaise(0.05f), settleFrames(4),
+    changes(0), current(maxScale), smoothed(0), over(0), under(0), settling(0) {
+}
+
+float ResolutionController::update(double gpuMilliseconds) {
+    // a timer query without a result, scaling by it would be unbounded
+    if (!(gpuMilliseconds > 0.0)) {
+        return current;
+    }
+    // the GPU times arrive a few frames late, those of the old scale first
+    if (settling > 0) {
+        settling--;
+        return current;
+    }
+    smoothed = smoothed > 0 ? 0.7 * smoothed + 0.3 * gpuMilliseconds : gpuMilliseconds;
+    over = smoothed > targetMilliseconds * (1.0 + headroom) ? over + 1 : 0;
+    under = smoothed < targetMilliseconds * (1.0 - headroom) ? under + 1 : 0;
+    if (over < dropFrames && under < raiseFrames) {
+        return current;
+    }
+
+    // aim a little below the target, time scales with the pixel count
+    float ideal = current * static_cast<float>(
+        sqrt(targetMilliseconds * (1.0 - 0.5 * headroom) / smoothed));
+    float next = under > 0 ? std::min(ideal, current + maxRaise) : ideal;
+    next = std::min(std::max(next, minScale), maxScale);
+    if (next != current) {
+        current = next;
+        smoothed = 0;
+        settling = settleFrames;
+        changes++;
+    }
+    over = under = 0;
+    return current;
+}
+
+int ResolutionController::scaled(int size) const {
+    return std::max(static_cast<int>(size * current + 0.5f), 1);
+}
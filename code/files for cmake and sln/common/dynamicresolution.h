@@ -0,0 +1,44 @@
+#ifndef DYNAMICRESOLUTION_H
+#define DYNAMICRESOLUTION_H
+
+/**
+* Picks the render scale, per axis of the output size, that holds a target
+* GPU frame time. The GPU time is assumed to grow with the pixel count, i.e.
+* the square of the scale. Over budget the scale drops after a couple of
+* frames, under budget it only rises after many frames and in small steps,
+* and times within the headroom around the target change nothing, so the
+* resolution does not oscillate with the noise of the measurements.
+*/
+class ResolutionController {
+public:
+    ResolutionController(double targetMilliseconds, float minScale = 0.5f,
+                         float maxScale = 1.0f);
+
+    /**
+    * Feed the GPU time of a finished frame, returns the scale to render at.
+    * Times that are not positive are ignored.
+    */
+    float update(double gpuMilliseconds);
+
+    float scale() const { return current; }
+
+    /* Scaled size of an output dimension, at least a pixel */
+    int scaled(int size) const;
+
+public:
+    double targetMilliseconds;
+    float minScale, maxScale;
+    double headroom;          // fraction of the target that counts as on target
+    int dropFrames;           // frames over budget before scaling down
+    int raiseFrames;          // frames under budget before scaling up
+    float maxRaise;           // largest scale increase at once
+    int settleFrames;         // measurements ignored after a change, in flight
+    int changes;              // scale changes so far
+
+private:
+    float current;
+    double smoothed;
+    int over, under, settling;
+};
+
+#endif
@@ -0,0 +1,71 @@
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include "foveation.h"
+
+using namespace glm;
+using namespace std;
+
+FoveationLayout::FoveationLayout(int width, int height, int eyes, float insetFraction,
+                                 float peripheryScale)
+    : width(width), height(height), eyes(eyes) {
+    if (eyes < 1 || insetFraction <= 0.0f || insetFraction > 1.0f ||
+        peripheryScale <= 0.0f || peripheryScale > 1.0f) {
+        throw runtime_error("Foveation needs an eye, an inset fraction and a periphery "
+                            "scale in (0, 1]");
+    }
+    // equal margins on both sides keep the inset's center on the eye's
+    int eyeWidth = width / eyes;
+    int marginX = static_cast<int>(eyeWidth * (1.0f - insetFraction) * 0.5f + 0.5f);
+    int marginY = static_cast<int>(height * (1.0f - insetFraction) * 0.5f + 0.5f);
+    insetWidth = std::max(eyeWidth - 2 * marginX, 1);
+    insetHeight = std::max(height - 2 * marginY, 1);
+    peripheryWidth = std::max(static_cast<int>(width * peripheryScale + 0.5f), eyes);
+    peripheryHeight = std::max(static_cast<int>(height * peripheryScale + 0.5f), 1);
+}
+
+PixelRect FoveationLayout::inset(int eye) const {
+    int eyeWidth = width / eyes;
+    PixelRect rect = {eye * eyeWidth + (eyeWidth - insetWidth) / 2,
+                      (height - insetHeight) / 2, insetWidth, insetHeight};
+    return rect;
+}
+
+PixelRect FoveationLayout::insetSource(int eye) const {
+    PixelRect rect = {eye * insetWidth, 0, insetWidth, insetHeight};
+    return rect;
+}
+
+PixelRect FoveationLayout::peripheryHole(int eye) const {
+    // inward to whole periphery pixels, then a pixel more: linear filtering
+    // reads the neighbours of the pixels just outside the inset
+    PixelRect output = inset(eye);
+    float scaleX = static_cast<float>(peripheryWidth) / width;
+    float scaleY = static_cast<float>(peripheryHeight) / height;
+    int x0 = static_cast<int>(ceil(output.x * scaleX)) + 1;
+    int y0 = static_cast<int>(ceil(output.y * scaleY)) + 1;
+    int x1 = static_cast<int>(floor((output.x + output.width) * scaleX)) - 1;
+    int y1 = static_cast<int>(floor((output.y + output.height) * scaleY)) - 1;
+    PixelRect rect = {x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0)};
+    return rect;
+}
+
+mat4 FoveationLayout::insetProjection(const mat4& eyeProjection) const {
+    // stretch the inset's share of the clip space over all of it
+    mat4 zoom;
+    zoom[0][0] = static_cast<float>(width / eyes) / insetWidth;
+    zoom[1][1] = static_cast<float>(height) / insetHeight;
+    return zoom * eyeProjection;
+}
+
+long FoveationLayout::insetPixels() const {
+    return eyes * static_cast<long>(insetWidth) * insetHeight;
+}
+
+long FoveationLayout::peripheryPixels() const {
+    long pixels = static_cast<long>(peripheryWidth) * peripheryHeight;
+    for (int eye = 0; eye < eyes; eye++) {
+        pixels -= peripheryHole(eye).pixels();
+    }
+    return pixels;
+}
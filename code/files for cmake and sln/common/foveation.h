@@ -0,0 +1,56 @@
+#ifndef FOVEATION_H
+#define FOVEATION_H
+
+#include <glm/glm.hpp>
+
+/* Rectangle of pixels, x and y of its bottom left pixel */
+struct PixelRect {
+    int x, y, width, height;
+
+    long pixels() const { return static_cast<long>(width) * height; }
+};
+
+/**
+* Sizes of foveated rendering. Each eye's center (the inset) is rendered at
+* full resolution into a target of its own, and the whole view (the
+* periphery) at a reduced resolution into another; both hold the eyes side
+* by side like the output. Compositing scales the periphery up and puts the
+* insets over it. The part of the periphery under the insets is not shaded.
+*/
+class FoveationLayout {
+public:
+    /**
+    * insetFraction is the inset's share of each side of an eye, rounded so
+    * that the inset is centered on whole pixels; peripheryScale the
+    * resolution of the periphery per axis.
+    */
+    FoveationLayout(int width, int height, int eyes, float insetFraction,
+                    float peripheryScale);
+
+    /* Where the eye's inset goes in the output */
+    PixelRect inset(int eye) const;
+
+    /* The eye's inset in the inset target */
+    PixelRect insetSource(int eye) const;
+
+    /**
+    * The part of the periphery the eye's inset covers entirely, also after
+    * filtering it up, so it may be left unshaded. Empty for small insets.
+    */
+    PixelRect peripheryHole(int eye) const;
+
+    /* Projection of the inset, the center of that of the whole eye */
+    glm::mat4 insetProjection(const glm::mat4& eyeProjection) const;
+
+    /* Shaded pixels per frame */
+    long insetPixels() const;
+    long peripheryPixels() const;
+    long outputPixels() const { return static_cast<long>(width) * height; }
+
+public:
+    int width, height, eyes;    // of the output, the eyes side by side
+    int insetWidth, insetHeight;            // of one eye's inset
+    int peripheryWidth, peripheryHeight;    // of the periphery target
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include <algorithm>
+#include "frustum.h"
+
+// NO_SSE builds the scalar fallback on SSE targets too, e.g. to test it
+#if !defined(NO_SSE) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define FRUSTUM_USE_SSE
+#endif
+
+using namespace glm;
+using namespace std;
+
+BoundingSphere boundingSphere(const vector<vec3>& points) {
+    BoundingSphere sphere = {vec3(0.0f), 0.0f};
+    if (points.empty()) return sphere;
+
+    vec3 lower = points[0], upper = points[0];
+    for (const vec3& p : points) {
+        lower = min(lower, p);
+        upper = max(upper, p);
+    }
+    sphere.center = 0.5f * (lower + upper);
+    for (const vec3& p : points) {
+        sphere.radius = std::max(sphere.radius, distance(p, sphere.center));
+    }
+    return sphere;
+}
+
+BoundingBox boundingBox(const vector<vec3>& points) {
+    BoundingBox box = {vec3(0.0f), vec3(0.0f)};
+    if (points.empty()) return box;
+
+    box.lower = box.upper = points[0];
+    for (const vec3& p : points) {
+        box.lower = min(box.lower, p);
+        box.upper = max(box.upper, p);
+    }
+    return box;
+}
+
+BoundingSphere transformBounds(const BoundingSphere& sphere, const mat4& transformation) {
+    float scale = std::max(std::max(length(vec3(transformation[0])),
+                                    length(vec3(transformation[1]))),
+                           length(vec3(transformation[2])));
+    BoundingSphere moved = {vec3(transformation * vec4(sphere.center, 1.0f)),
+                            sphere.radius * scale};
+    return moved;
+}
+
+BoundingBox transformBounds(const BoundingBox& box, const mat4& transformation) {
+    // Arvo: per axis, the smaller and the larger product of each matrix
+    // entry with the corners' coordinates add up to the new extents
+    BoundingBox moved = {vec3(transformation[3]), vec3(transformation[3])};
+    for (int column = 0; column < 3; column++) {
+        vec3 a = vec3(transformation[column]) * box.lower[column];
+        vec3 b = vec3(transformation[column]) * box.upper[column];
+        moved.lower += min(a, b);
+        moved.upper += max(a, b);
+    }
+    return moved;
+}
+
+Frustum::Frustum(const mat4& viewProjection) {
+    // Gribb and Hartmann: each plane is the last row of the matrix plus or
+    // minus one of the others; glm matrices are indexed by column
+    vec4 rows[4];
+    for (int i = 0; i < 4; i++) {
+        rows[i] = vec4(viewProjection[0][i], viewProjection[1][i],
+                       viewProjection[2][i], viewProjection[3][i]);
+    }
+    planes[FRUSTUM_LEFT] = rows[3] + rows[0];
+    planes[FRUSTUM_RIGHT] = rows[3] - rows[0];
+    planes[FRUSTUM_BOTTOM] = rows[3] + rows[1];
+    planes[FRUSTUM_TOP] = rows[3] - rows[1];
+    planes[FRUSTUM_NEAR] = rows[3] + rows[2];
+    planes[FRUSTUM_FAR] = rows[3] - rows[2];
+    for (vec4& plane : planes) {
+        plane /= length(vec3(plane));
+    }
+}
+
+bool Frustum::intersects(const BoundingSphere& sphere) const {
+    for (const vec4& plane : planes) {
+        if (dot(vec3(plane), sphere.center) + plane.w < -sphere.radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool Frustum::intersects(const BoundingBox& box) const {
+    for (const vec4& plane : planes) {
+        // the corner furthest inside the plane
+        vec3 inside(plane.x >= 0.0f ? box.upper.x : box.lower.x,
+                    plane.y >= 0.0f ? box.upper.y : box.lower.y,
+                    plane.z >= 0.0f ? box.upper.z : box.lower.z);
+        if (dot(vec3(plane), inside) + plane.w < 0.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+int Frustum::intersects(const BoundingSphere* spheres, int count,
+                        unsigned char* visible) const {
+    int visibleCount = 0;
+    int i = 0;
+#ifdef FRUSTUM_USE_SSE
+    // four spheres per register, the planes broadcast
+    for (; i + 4 <= count; i += 4) {
+        const BoundingSphere* s = spheres + i;
+        __m128 x = _mm_setr_ps(s[0].center.x, s[1].center.x, s[2].center.x, s[3].center.x);
+        __m128 y = _mm_setr_ps(s[0].center.y, s[1].center.y, s[2].center.y, s[3].center.y);
+        __m128 z = _mm_setr_ps(s[0].center.z, s[1].center.z, s[2].center.z, s[3].center.z);
+        __m128 r = _mm_setr_ps(-s[0].radius, -s[1].radius, -s[2].radius, -s[3].radius);
+        __m128 outside = _mm_setzero_ps();
+        for (const vec4& plane : planes) {
+            __m128 d = _mm_mul_ps(x, _mm_set1_ps(plane.x));
+            d = _mm_add_ps(d, _mm_mul_ps(y, _mm_set1_ps(plane.y)));
+            d = _mm_add_ps(d, _mm_mul_ps(z, _mm_set1_ps(plane.z)));
+            d = _mm_add_ps(d, _mm_set1_ps(plane.w));
+            outside = _mm_or_ps(outside, _mm_cmplt_ps(d, r));
+        }
+        int mask = _mm_movemask_ps(outside);
+        for (int lane = 0; lane < 4; lane++) {
+            visible[i + lane] = (mask & (1 << lane)) == 0;
+            visibleCount += visible[i + lane];
+        }
+    }
+#endif
+    for (; i < count; i++) {
+        visible[i] = intersects(spheres[i]);
+        visibleCount += visible[i];
+    }
+    return visibleCount;
+}
+
+Frustum Frustum::stereo(const Frustum& leftEye, const Frustum& rightEye) {
+    Frustum combined = leftEye;
+    combined.planes[FRUSTUM_RIGHT] = rightEye.planes[FRUSTUM_RIGHT];
+    return combined;
+}
@@ -0,0 +1,74 @@
+#ifndef FRUSTUM_H
+#define FRUSTUM_H
+
+#include <vector>
+#include <glm/glm.hpp>
+
+struct BoundingSphere {
+    glm::vec3 center;
+    float radius;
+};
+
+/* Axis aligned box, lower and upper corners */
+struct BoundingBox {
+    glm::vec3 lower, upper;
+};
+
+/* Sphere around the box of the points, not the smallest one but close */
+BoundingSphere boundingSphere(const std::vector<glm::vec3>& points);
+
+BoundingBox boundingBox(const std::vector<glm::vec3>& points);
+
+/* The sphere moved by an affine transformation, grown by its largest scale */
+BoundingSphere transformBounds(const BoundingSphere& sphere, const glm::mat4& transformation);
+
+/* Axis aligned box around the box moved by an affine transformation */
+BoundingBox transformBounds(const BoundingBox& box, const glm::mat4& transformation);
+
+/* Counts of culling decisions, e.g. over a run */
+struct CullingStats {
+    long visible = 0, culled = 0;
+};
+
+/* Order of the frustum planes */
+enum FrustumPlane {
+    FRUSTUM_LEFT, FRUSTUM_RIGHT, FRUSTUM_BOTTOM, FRUSTUM_TOP, FRUSTUM_NEAR,
+    FRUSTUM_FAR, FRUSTUM_PLANES
+};
+
+/**
+* The six planes bounding what a view projection matrix sees. A plane is
+* (normal, distance) with the unit normal pointing inside, so a point p is
+* inside the plane when dot(normal, p) + distance >= 0.
+*/
+struct Frustum {
+    glm::vec4 planes[FRUSTUM_PLANES];
+
+    Frustum() {}
+
+    /* Frustum of a view projection matrix, in world space */
+    explicit Frustum(const glm::mat4& viewProjection);
+
+    /* False only if the sphere is entirely outside, so it may be culled */
+    bool intersects(const BoundingSphere& sphere) const;
+
+    /* The same for a box, which is tighter around long and thin parts */
+    bool intersects(const BoundingBox& box) const;
+
+    /**
+    * The sphere test for many spheres, four at a time where SSE is
+    * available. Sets visible to 1 or 0 per sphere and returns how many are.
+    */
+    int intersects(const BoundingSphere* spheres, int count, unsigned char* visible) const;
+
+    /**
+    * One frustum containing both eyes, to cull once for a stereo frame: the
+    * left plane of the left eye, the right plane of the right eye and the
+    * other planes of the left eye. Eyes must look the same way and have the
+    * same projection, only offset sideways (as in instanced stereo), so that
+    * their bottom, top, near and far planes coincide.
+    */
+    static Frustum stereo(const Frustum& leftEye, const Frustum& rightEye);
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include <cstring>
+#include "glstate.h"
+
+using namespace glm;
+using namespace std;
+
+GLStateCache::GLStateCache() : uniforms(NULL) {
+    invalidate();
+    resetStats();
+}
+
+void GLStateCache::invalidate() {
+    program = vertexArray = mode = ~0u;
+    textures.clear();
+    programUniforms.clear();
+    uniforms = NULL;
+}
+
+void GLStateCache::resetStats() {
+    counters.issued = counters.skipped = 0;
+}
+
+bool GLStateCache::changed(GLuint& shadow, GLuint value) {
+    if (shadow == value) {
+        counters.skipped++;
+        return false;
+    }
+    shadow = value;
+    counters.issued++;
+    return true;
+}
+
+bool GLStateCache::changed(GLint location, const void* data, size_t size) {
+    // -1 is silently ignored by GL as well
+    if (location < 0) return false;
+    if (uniforms == NULL) {
+        // no program bound through the cache, nothing to compare with
+        counters.issued++;
+        return true;
+    }
+    if (location >= static_cast<GLint>(uniforms->size())) {
+        uniforms->resize(location + 1);
+    }
+    vector<unsigned char>& shadow = (*uniforms)[location];
+    if (shadow.size() == size && memcmp(&shadow[0], data, size) == 0) {
+        counters.skipped++;
+        return false;
+    }
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    shadow.assign(bytes, bytes + size);
+    counters.issued++;
+    return true;
+}
+
+void GLStateCache::useProgram(GLuint value) {
+    if (changed(program, value)) {
+        glUseProgram(value);
+        uniforms = &programUniforms[value];
+    }
+}
+
+void GLStateCache::bindVertexArray(GLuint value) {
+    if (changed(vertexArray, value)) {
+        glBindVertexArray(value);
+    }
+}
+
+void GLStateCache::polygonMode(GLenum value) {
+    if (changed(mode, value)) {
+        glPolygonMode(GL_FRONT_AND_BACK, value);
+    }
+}
+
+void GLStateCache::bindTexture(GLuint unit, GLenum target, GLuint value) {
+    if (unit >= textures.size()) {
+        textures.resize(unit + 1, ~0u);
+    }
+    if (changed(textures[unit], value)) {
+        glActiveTexture(GL_TEXTURE0 + unit);
+        glBindTexture(target, value);
+    }
+}
+
+void GLStateCache::uniform1i(GLint location, int value) {
+    if (changed(location, &value, sizeof(value))) {
+        glUniform1i(location, value);
+    }
+}
+
+void GLStateCache::uniform1f(GLint location, float value) {
+    if (changed(location, &value, sizeof(value))) {
+        glUniform1f(location, value);
+    }
+}
+
+void GLStateCache::uniform3f(GLint location, const vec3& value) {
+    if (changed(location, &value[0], sizeof(value))) {
+        glUniform3fv(location, 1, &value[0]);
+    }
+}
+
+void GLStateCache::uniform4f(GLint location, const vec4& value) {
+    if (changed(location, &value[0], sizeof(value))) {
+        glUniform4fv(location, 1, &value[0]);
+    }
+}
+
+void GLStateCache::uniformMatrix4fv(GLint location, const mat4& value) {
+    uniformMatrix4fv(location, 1, &value);
+}
+
+void GLStateCache::uniformMatrix4fv(GLint location, int count, const mat4* values) {
+    if (changed(location, &values[0][0][0], count * sizeof(mat4))) {
+        glUniformMatrix4fv(location, count, GL_FALSE, &values[0][0][0]);
+    }
+}
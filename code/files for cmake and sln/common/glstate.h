@@ -0,0 +1,61 @@
+#ifndef GLSTATE_H
+#define GLSTATE_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <unordered_map>
+#include <glm/glm.hpp>
+
+/* GL calls that went to the driver and calls the cache found redundant */
+struct GLStateStats {
+    long long issued;
+    long long skipped;
+};
+
+/**
+* Shadows the bound program, vertex array, polygon mode and textures and, per
+* program, the last value of every uniform, and only forwards calls that change
+* something. All state changes of the code using it must go through the
+* cache; call invalidate() after GL code that bypasses it.
+*/
+class GLStateCache {
+public:
+    GLStateCache();
+
+    void useProgram(GLuint program);
+    void bindVertexArray(GLuint vertexArray);
+    void polygonMode(GLenum mode);  // for GL_FRONT_AND_BACK
+    // one target per unit is shadowed; the active unit only changes when the
+    // bind is issued, so direct binds must select their unit themselves
+    void bindTexture(GLuint unit, GLenum target, GLuint texture);
+
+    // uniforms of the program bound with useProgram()
+    void uniform1i(GLint location, int value);
+    void uniform1f(GLint location, float value);
+    void uniform3f(GLint location, const glm::vec3& value);
+    void uniform4f(GLint location, const glm::vec4& value);
+    void uniformMatrix4fv(GLint location, const glm::mat4& value);
+    void uniformMatrix4fv(GLint location, int count, const glm::mat4* values);
+
+    /* Forget the shadowed state, the next calls are all issued */
+    void invalidate();
+
+    const GLStateStats& stats() const { return counters; }
+    void resetStats();
+
+private:
+    // ~0 means unknown, which no real name or mode equals
+    GLuint program, vertexArray;
+    GLenum mode;
+    std::vector<GLuint> textures;  // per unit
+    // last uploaded bytes of every uniform location, per program
+    std::unordered_map<GLuint, std::vector<std::vector<unsigned char> > > programUniforms;
+    std::vector<std::vector<unsigned char> >* uniforms;
+    GLStateStats counters;
+
+private:
+    bool changed(GLint location, const void* data, size_t size);
+    bool changed(GLuint& shadow, GLuint value);
+};
+
+#endif
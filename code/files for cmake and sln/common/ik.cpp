@@ -0,0 +1,229 @@
+#include <chrono>
+#include <cmath>
+#include <stdexcept>
+#include "ik.h"
+#include "profiler.h"
+
+// NO_SSE builds the scalar fallback on SSE targets too, e.g. to test it
+#if !defined(NO_SSE) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define IK_USE_SSE
+#endif
+
+using namespace glm;
+using namespace std;
+
+namespace {
+
+// four lanes of floats, masks are all ones/zeros (SSE) or 1/0 (scalar)
+#ifdef IK_USE_SSE
+struct F4 {
+    __m128 v;
+    F4() {}
+    F4(__m128 v) : v(v) {}
+    F4(float s) : v(_mm_set1_ps(s)) {}
+    static F4 load(const float* p) { return _mm_loadu_ps(p); }
+    void store(float* p) const { _mm_storeu_ps(p, v); }
+};
+inline F4 operator+(F4 a, F4 b) { return _mm_add_ps(a.v, b.v); }
+inline F4 operator-(F4 a, F4 b) { return _mm_sub_ps(a.v, b.v); }
+inline F4 operator*(F4 a, F4 b) { return _mm_mul_ps(a.v, b.v); }
+inline F4 operator/(F4 a, F4 b) { return _mm_div_ps(a.v, b.v); }
+inline F4 min4(F4 a, F4 b) { return _mm_min_ps(a.v, b.v); }
+inline F4 max4(F4 a, F4 b) { return _mm_max_ps(a.v, b.v); }
+inline F4 abs4(F4 a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v); }
+inline F4 round4(F4 a) { return _mm_cvtepi32_ps(_mm_cvtps_epi32(a.v)); }
+inline F4 cmplt4(F4 a, F4 b) { return _mm_cmplt_ps(a.v, b.v); }
+inline F4 maskOr(F4 a, F4 b) { return _mm_or_ps(a.v, b.v); }
+inline F4 select(F4 mask, F4 a, F4 b) {
+    return _mm_or_ps(_mm_and_ps(mask.v, a.v), _mm_andnot_ps(mask.v, b.v));
+}
+inline int movemask(F4 mask) { return _mm_movemask_ps(mask.v); }
+#else
+struct F4 {
+    float v[4];
+    F4() {}
+    F4(float s) { v[0] = v[1] = v[2] = v[3] = s; }
+    static F4 load(const float* p) { F4 r; for (int i = 0; i < 4; i++) r.v[i] = p[i]; return r; }
+    void store(float* p) const { for (int i = 0; i < 4; i++) p[i] = v[i]; }
+};
+#define IK_LANEWISE(expr) F4 r; for (int i = 0; i < 4; i++) r.v[i] = (expr); return r
+inline F4 operator+(F4 a, F4 b) { IK_LANEWISE(a.v[i] + b.v[i]); }
+inline F4 operator-(F4 a, F4 b) { IK_LANEWISE(a.v[i] - b.v[i]); }
+inline F4 operator*(F4 a, F4 b) { IK_LANEWISE(a.v[i] * b.v[i]); }
+inline F4 operator/(F4 a, F4 b) { IK_LANEWISE(a.v[i] / b.v[i]); }
+inline F4 min4(F4 a, F4 b) { IK_LANEWISE(a.v[i] < b.v[i] ? a.v[i] : b.v[i]); }
+inline F4 max4(F4 a, F4 b) { IK_LANEWISE(a.v[i] > b.v[i] ? a.v[i] : b.v[i]); }
+inline F4 abs4(F4 a) { IK_LANEWISE(fabs(a.v[i])); }
+inline F4 round4(F4 a) { IK_LANEWISE(floor(a.v[i] + 0.5f)); }
+inline F4 cmplt4(F4 a, F4 b) { IK_LANEWISE(a.v[i] < b.v[i] ? 1.0f : 0.0f); }
+inline F4 maskOr(F4 a, F4 b) { IK_LANEWISE(a.v[i] > b.v[i] ? a.v[i] : b.v[i]); }
+inline F4 select(F4 mask, F4 a, F4 b) { IK_LANEWISE(mask.v[i] != 0.0f ? a.v[i] : b.v[i]); }
+inline int movemask(F4 mask) {
+    int m = 0;
+    for (int i = 0; i < 4; i++) m |= (mask.v[i] != 0.0f) << i;
+    return m;
+}
+#undef IK_LANEWISE
+#endif
+
+const float PI = 3.14159265f;
+
+// polynomial atan2, absolute error around 1e-5 rad
+F4 atan2_4(F4 y, F4 x) {
+    F4 ax = abs4(x), ay = abs4(y);
+    F4 a = min4(ax, ay) / max4(max4(ax, ay), F4(1e-20f));
+    F4 s = a * a;
+    F4 r = ((F4(-0.0464964749f) * s + F4(0.15931422f)) * s - F4(0.327622764f)) * s * a + a;
+    r = select(cmplt4(ax, ay), F4(PI / 2) - r, r);
+    r = select(cmplt4(x, F4(0.0f)), F4(PI) - r, r);
+    return select(cmplt4(y, F4(0.0f)), F4(0.0f) - r, r);
+}
+
+// sine and cosine through range reduction to [-pi/2, pi/2] and Taylor
+// polynomials, absolute error below 1e-6
+void sincos4(F4 x, F4& s, F4& c) {
+    x = x - F4(2 * PI) * round4(x * F4(1 / (2 * PI)));
+    // fold onto [-pi/2, pi/2] with sin(pi - x) = sin(x), cos(pi - x) = -cos(x)
+    F4 high = cmplt4(F4(PI / 2), x), low = cmplt4(x, F4(-PI / 2));
+    x = select(high, F4(PI) - x, select(low, F4(-PI) - x, x));
+    F4 sign = select(maskOr(high, low), F4(-1.0f), F4(1.0f));
+    F4 x2 = x * x;
+    s = x * (F4(1.0f) + x2 * (F4(-1.0f / 6) + x2 * (F4(1.0f / 120) + x2 * (
+        F4(-1.0f / 5040) + x2 * (F4(1.0f / 362880) + x2 * F4(-1.0f / 39916800))))));
+    c = sign * (F4(1.0f) + x2 * (F4(-0.5f) + x2 * (F4(1.0f / 24) + x2 * (
+        F4(-1.0f / 720) + x2 * (F4(1.0f / 40320) + x2 * (F4(-1.0f / 3628800) +
+        x2 * F4(1.0f / 479001600)))))));
+}
+
+}
+
+IKSolver::IKSolver() : chains(0) {
+}
+
+int IKSolver::addChain(const IKChain& chain) {
+    int hinges = static_cast<int>(chain.coordinates.size());
+    if (hinges == 0 || hinges > MAX_CHAIN_JOINTS ||
+        static_cast<int>(chain.joints.size()) != hinges + 1 ||
+        static_cast<int>(chain.limits.size()) != hinges) {
+        throw runtime_error("Invalid IK chain description");
+    }
+
+    if (chains % 4 == 0) {
+        Batch batch = {};
+        for (int k = 0; k < MAX_CHAIN_JOINTS; k++) {
+            for (int lane = 0; lane < 4; lane++) batch.coordinate[k][lane] = -1;
+        }
+        batches.push_back(batch);
+    }
+    Batch& batch = batches.back();
+    int lane = batch.lanes++;
+
+    batch.baseU[lane] = chain.joints[0].x;
+    batch.baseV[lane] = chain.joints[0].y;
+    // unused joints of short chains keep zero length and a [0, 0] range
+    for (int k = 0; k < hinges; k++) {
+        vec2 segment = chain.joints[k + 1] - chain.joints[k];
+        batch.segmentU[k][lane] = segment.x;
+        batch.segmentV[k][lane] = segment.y;
+        batch.minAngle[k][lane] = radians(chain.limits[k].x);
+        batch.maxAngle[k][lane] = radians(chain.limits[k].y);
+        batch.coordinate[k][lane] = chain.coordinates[k];
+    }
+    // until a target is set, the chain is already at its target
+    batch.targetU[lane] = chain.joints.back().x;
+    batch.targetV[lane] = chain.joints.back().y;
+    return chains++;
+}
+
+void IKSolver::setTarget(int chain, const vec2& target) {
+    Batch& batch = batches[chain / 4];
+    batch.targetU[chain % 4] = target.x;
+    batch.targetV[chain % 4] = target.y;
+}
+
+IKStats IKSolver::solve(map<int, float>& q, float budgetMilliseconds,
+                        float tolerance, int maxIterations) {
+    PROFILE_SCOPE("IKSolver::solve");
+    typedef chrono::steady_clock Clock;
+    Clock::time_point start = Clock::now();
+    IKStats stats = {0, 0, 0.0f, 0.0f};
+    bool outOfTime = false;
+    const int N = MAX_CHAIN_JOINTS;
+
+    for (Batch& b : batches) {
+        // warm start from the current coordinates
+        for (int k = 0; k < N; k++) {
+            for (int lane = 0; lane < 4; lane++) {
+                int c = b.coordinate[k][lane];
+                float a = c >= 0 && q.count(c) ? radians(q[c]) : 0.0f;
+                b.angle[k][lane] = std::min(std::max(a, b.minAngle[k][lane]),
+                                            b.maxAngle[k][lane]);
+            }
+        }
+
+        F4 tu = F4::load(b.targetU), tv = F4::load(b.targetV);
+        F4 angle[N], pu[N + 1], pv[N + 1];
+        for (int k = 0; k < N; k++) angle[k] = F4::load(b.angle[k]);
+        F4 error2;
+
+        for (int iteration = 0; ; iteration++) {
+            // forward kinematics of the hinge positions
+            pu[0] = F4::load(b.baseU);
+            pv[0] = F4::load(b.baseV);
+            F4 accumulated(0.0f);
+            for (int k = 0; k < N; k++) {
+                F4 s, c;
+                accumulated = accumulated + angle[k];
+                sincos4(accumulated, s, c);
+                F4 su = F4::load(b.segmentU[k]), sv = F4::load(b.segmentV[k]);
+                pu[k + 1] = pu[k] + c * su - s * sv;
+                pv[k + 1] = pv[k] + s * su + c * sv;
+            }
+            F4 du = pu[N] - tu, dv = pv[N] - tv;
+            error2 = du * du + dv * dv;
+            F4 done = cmplt4(error2, F4(tolerance * tolerance));
+            if (movemask(done) == 0xF || iteration == maxIterations || outOfTime) {
+                break;
+            }
+
+            // one CCD sweep from the tip to the root; hinges closer to the root
+            // than k do not move, so only the end effector is updated
+            F4 eu = pu[N], ev = pv[N];
+            for (int k = N - 1; k >= 0; k--) {
+                F4 au = eu - pu[k], av = ev - pv[k];
+                F4 bu = tu - pu[k], bv = tv - pv[k];
+                F4 delta = atan2_4(au * bv - av * bu, au * bu + av * bv);
+                F4 target = min4(max4(angle[k] + delta, F4::load(b.minAngle[k])),
+                                 F4::load(b.maxAngle[k]));
+                F4 applied = select(done, F4(0.0f), target - angle[k]);
+                angle[k] = angle[k] + applied;
+                F4 s, c;
+                sincos4(applied, s, c);
+                eu = pu[k] + c * au - s * av;
+                ev = pv[k] + s * au + c * av;
+            }
+            stats.iterations++;
+
+            chrono::duration<float, milli> elapsed = Clock::now() - start;
+            outOfTime = elapsed.count() > budgetMilliseconds;
+        }
+
+        float e2[4];
+        error2.store(e2);
+        for (int k = 0; k < N; k++) angle[k].store(b.angle[k]);
+        for (int lane = 0; lane < b.lanes; lane++) {
+            float e = sqrt(e2[lane]);
+            stats.maxError = std::max(stats.maxError, e);
+            if (e < tolerance) stats.converged++;
+            for (int k = 0; k < N; k++) {
+                int c = b.coordinate[k][lane];
+                if (c >= 0) q[c] = degrees(b.angle[k][lane]);
+            }
+        }
+    }
+
+    stats.milliseconds = chrono::duration<float, milli>(Clock::now() - start).count();
+    return stats;
+}
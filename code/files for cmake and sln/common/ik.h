@@ -0,0 +1,69 @@
+#ifndef IK_H
+#define IK_H
+
+#include <vector>
+#include <map>
+#include <glm/glm.hpp>
+
+/**
+* A chain of hinge joints that all rotate about the same axis, like the finger
+* and leg chains of the lab rigs whose DOFs are rotations about X. Positions
+* are given in the plane of the hinges at zero angles (for X hinges the plane
+* is (y, z), and a positive angle turns y towards z as in rotate()).
+*/
+struct IKChain {
+    std::vector<glm::vec2> joints;  // hinge positions, then the end effector
+    std::vector<int> coordinates;   // generalized coordinate of every hinge
+    std::vector<glm::vec2> limits;  // (min, max) angle of every hinge, degrees
+};
+
+struct IKStats {
+    int iterations;      // CCD sweeps summed over the batches
+    int converged;       // chains that reached their target within tolerance
+    float maxError;      // largest remaining end effector distance
+    float milliseconds;  // time spent in solve()
+};
+
+/**
+* Solves many chains per call with cyclic coordinate descent. Chains are
+* stored structure of arrays in batches of four, one chain per SIMD lane
+* (SSE2 when available, scalar otherwise). The current coordinates are used
+* as the initial guess and the solved angles are written back into them.
+*/
+class IKSolver {
+public:
+    static const int MAX_CHAIN_JOINTS = 4;
+
+    IKSolver();
+
+    /* Returns the index of the chain used by setTarget() */
+    int addChain(const IKChain& chain);
+
+    void setTarget(int chain, const glm::vec2& target);
+
+    /**
+    * Solve every chain, stopping a batch when all its chains are within
+    * tolerance, after maxIterations sweeps, or when the time budget is spent.
+    */
+    IKStats solve(std::map<int, float>& q, float budgetMilliseconds = 0.25f,
+                  float tolerance = 1e-3f, int maxIterations = 16);
+
+    int chainCount() const { return chains; }
+
+private:
+    // four chains, one per lane; unused joints have zero length and no range
+    struct Batch {
+        float baseU[4], baseV[4];                          // first hinge
+        float segmentU[MAX_CHAIN_JOINTS][4], segmentV[MAX_CHAIN_JOINTS][4];
+        float minAngle[MAX_CHAIN_JOINTS][4], maxAngle[MAX_CHAIN_JOINTS][4];
+        float angle[MAX_CHAIN_JOINTS][4];                  // radians
+        int coordinate[MAX_CHAIN_JOINTS][4];               // -1 if unused
+        float targetU[4], targetV[4];
+        int lanes;
+    };
+
+    std::vector<Batch> batches;
+    int chains;
+};
+
+#endif
@@ -0,0 +1,97 @@
+#include <algorithm>
+#include "jobs.h"
+#include "profiler.h"
+
+using namespace std;
+
+JobSystem::JobSystem(int threads) : stopping(false) {
+    if (threads < 0) {
+        threads = static_cast<int>(thread::hardware_concurrency()) - 1;
+    }
+    for (int i = 0; i < threads; i++) {
+        workers.push_back(thread(&JobSystem::workerLoop, this));
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    available.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::run(JobCounter& counter, const Job& job) {
+    counter.pending++;
+    if (workers.empty()) {
+        // no workers, execute immediately on the calling thread
+        job();
+        counter.pending--;
+        return;
+    }
+    {
+        lock_guard<std::mutex> lock(mutex);
+        queue.push_back(Entry{job, &counter});
+    }
+    available.notify_one();
+}
+
+bool JobSystem::tryExecuteOne() {
+    Entry entry;
+    {
+        lock_guard<std::mutex> lock(mutex);
+        if (queue.empty()) return false;
+        entry = queue.front();
+        queue.pop_front();
+    }
+    entry.job();
+    entry.counter->pending--;
+    return true;
+}
+
+void JobSystem::wait(JobCounter& counter) {
+    while (counter.pending > 0) {
+        if (!tryExecuteOne()) {
+            // the remaining jobs are running on other threads
+            this_thread::yield();
+        }
+    }
+}
+
+void JobSystem::parallelFor(int count, const function<void(int)>& body) {
+    // one job per worker plus the caller, each taking a contiguous range
+    int chunks = std::min(count, workerCount() + 1);
+    JobCounter counter;
+    for (int c = 1; c < chunks; c++) {
+        int begin = count * c / chunks, end = count * (c + 1) / chunks;
+        run(counter, [begin, end, &body]() {
+            for (int i = begin; i < end; i++) body(i);
+        });
+    }
+    for (int i = 0; i < (chunks > 0 ? count / chunks : 0); i++) {
+        body(i);
+    }
+    wait(counter);
+}
+
+void JobSystem::workerLoop() {
+    Profiler::setThreadName("job worker");
+    while (true) {
+        Entry entry;
+        {
+            unique_lock<std::mutex> lock(mutex);
+            available.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (stopping && queue.empty()) return;
+            entry = queue.front();
+            queue.pop_front();
+        }
+        {
+            PROFILE_SCOPE("job");
+            entry.job();
+        }
+        entry.counter->pending--;
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef JOBS_H
+#define JOBS_H
+
+#include <vector>
+#include <deque>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+/* Counts the unfinished jobs of a group, see JobSystem::wait() */
+struct JobCounter {
+    std::atomic<int> pending;
+    JobCounter() : pending(0) {}
+};
+
+/**
+* A small pool of worker threads executing queued jobs. A thread that waits
+* for a group of jobs keeps executing queued jobs in the mean time, so jobs
+* may spawn and wait for other jobs (e.g. the branches of an animation graph)
+* without deadlocking the pool.
+*/
+class JobSystem {
+public:
+    typedef std::function<void()> Job;
+
+    /* threads < 0 uses one worker per hardware thread except the caller's */
+    JobSystem(int threads = -1);
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+    ~JobSystem();
+
+    /* Queue a job, counter is decremented when it has finished */
+    void run(JobCounter& counter, const Job& job);
+
+    /* Block until every job of the counter has finished */
+    void wait(JobCounter& counter);
+
+    /* Call body(i) for i in [0, count) spreading the calls across workers */
+    void parallelFor(int count, const std::function<void(int)>& body);
+
+    int workerCount() const { return static_cast<int>(workers.size()); }
+
+private:
+    struct Entry {
+        Job job;
+        JobCounter* counter;
+    };
+
+    std::vector<std::thread> workers;
+    std::deque<Entry> queue;
+    std::mutex mutex;
+    std::condition_variable available;
+    bool stopping;
+
+private:
+    bool tryExecuteOne();
+    void workerLoop();
+};
+
+#endif
@@ -0,0 +1,116 @@
+#include <algorithm>
+#include <stdexcept>
+#include "lod.h"
+#include "jobs.h"
+#include "profiler.h"
+
+using namespace glm;
+using namespace std;
+
+float projectedScreenHeight(float radius, float viewDepth,
+                            const mat4& projectionMatrix, float viewportHeight) {
+    // projectionMatrix[1][1] is cot(fov / 2) for a perspective projection
+    if (viewDepth <= 0.0f) return viewportHeight;
+    return radius * projectionMatrix[1][1] * viewportHeight / viewDepth;
+}
+
+AnimationLODManager::AnimationLODManager(const vector<AnimationLODLevel>& levels)
+    : levels(levels), frame(0), evaluated(0) {
+    if (levels.empty()) {
+        throw runtime_error("At least one animation LOD level is required");
+    }
+}
+
+int AnimationLODManager::addCharacter(AnimationGraph* graph, float boundingRadius,
+                                      const vector<int>& leafJoints) {
+    Character character;
+    character.graph = graph;
+    character.boundingRadius = boundingRadius;
+    character.leafJoints = leafJoints;
+    character.leafMask = createJointMask(graph->jointCount, leafJoints);
+    character.level = 0;
+    character.previousTime = character.currentTime = 0.0f;
+    character.initialized = false;
+    characters.push_back(character);
+    return static_cast<int>(characters.size()) - 1;
+}
+
+void AnimationLODManager::selectLevels(const vector<vec3>& characterPositions,
+                                       const mat4& viewMatrix,
+                                       const mat4& projectionMatrix,
+                                       float viewportHeight) {
+    for (int c = 0; c < static_cast<int>(characters.size()); c++) {
+        Character& character = characters[c];
+        float depth = -(viewMatrix * vec4(characterPositions[c], 1.0f)).z;
+        float height = projectedScreenHeight(character.boundingRadius, depth,
+                                             projectionMatrix, viewportHeight);
+        int level = static_cast<int>(levels.size()) - 1;
+        for (int l = 0; l < static_cast<int>(levels.size()); l++) {
+            if (height >= levels[l].minScreenHeight) {
+                level = l;
+                break;
+            }
+        }
+        character.level = level;
+    }
+}
+
+void AnimationLODManager::update(float time, JobSystem* jobs) {
+    PROFILE_SCOPE("AnimationLODManager::update");
+    // characters whose pose must be evaluated this frame; the character index
+    // staggers equal intervals over different frames
+    vector<int> due;
+    for (int c = 0; c < static_cast<int>(characters.size()); c++) {
+        const Character& character = characters[c];
+        int interval = levels[character.level].updateInterval;
+        if (!character.initialized || interval <= 1 || (frame + c) % interval == 0) {
+            due.push_back(c);
+        }
+    }
+
+    auto evaluate = [this, &due, time, jobs](int i) {
+        Character& character = characters[due[i]];
+        bool freeze = levels[character.level].freezeLeafJoints && character.initialized;
+        const JointMask* frozen = freeze ? &character.leafMask : NULL;
+        const Pose& evaluatedPose = character.graph->evaluate(time, jobs, frozen);
+
+        character.previous.swap(character.current);
+        character.previousTime = character.currentTime;
+        character.current = evaluatedPose;
+        character.currentTime = time;
+        if (freeze) {
+            // the graph left them out, unless its root is a clip
+            for (int j : character.leafJoints) {
+                character.current[j] = character.previous[j];
+            }
+        }
+        if (!character.initialized) {
+            character.previous = character.current;
+            character.previousTime = time;
+            character.initialized = true;
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(static_cast<int>(due.size()), evaluate);
+    } else {
+        for (int i = 0; i < static_cast<int>(due.size()); i++) evaluate(i);
+    }
+    evaluated = static_cast<int>(due.size());
+
+    // interpolate between the two last evaluated poses; the displayed pose
+    // runs one update interval behind the evaluated one
+    for (Character& character : characters) {
+        float span = character.currentTime - character.previousTime;
+        if (levels[character.level].updateInterval <= 1 || span <= 0.0f) {
+            character.pose = character.current;
+            continue;
+        }
+        float alpha = std::min(std::max((time - character.currentTime) / span, 0.0f), 1.0f);
+        character.pose.resize(character.current.size());
+        for (int j = 0; j < static_cast<int>(character.current.size()); j++) {
+            character.pose[j] = interpolate(character.previous[j], character.current[j],
+                                            alpha, LERP);
+        }
+    }
+    frame++;
+}
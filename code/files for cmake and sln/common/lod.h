@@ -0,0 +1,81 @@
+#ifndef LOD_H
+#define LOD_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "animation.h"
+
+/* Settings of an animation level of detail */
+struct AnimationLODLevel {
+    float minScreenHeight;   // projected height in pixels to use this level
+    int updateInterval;      // evaluate the pose every updateInterval frames
+    bool freezeLeafJoints;   // skip leaf joints (fingers, toes), keeping their last pose
+    int maxSkinInfluences;   // bone influences per vertex when skinning
+};
+
+/**
+* Chooses, per character, how often its pose is evaluated from its projected
+* screen size. Between evaluations the pose is interpolated from the last two
+* evaluated poses, so distant characters keep moving smoothly while costing a
+* fraction of a full update. Characters with the same update interval are
+* spread over different frames to keep the per frame cost even.
+*/
+class AnimationLODManager {
+public:
+    /* Levels must be sorted from the most to the least detailed */
+    AnimationLODManager(const std::vector<AnimationLODLevel>& levels);
+
+    /* Returns the character index */
+    int addCharacter(AnimationGraph* graph, float boundingRadius,
+                     const std::vector<int>& leafJoints);
+
+    /**
+    * Pick the level of every character. characterPositions are the world
+    * positions of the characters, viewportHeight is in pixels.
+    */
+    void selectLevels(const std::vector<glm::vec3>& characterPositions,
+                      const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+                      float viewportHeight);
+
+    /**
+    * Evaluate the graphs that are due this frame (on the job system if given)
+    * and interpolate the others. Call once per frame after selectLevels().
+    */
+    void update(float time, JobSystem* jobs = NULL);
+
+    const Pose& getPose(int character) const { return characters[character].pose; }
+    int getLevel(int character) const { return characters[character].level; }
+    const AnimationLODLevel& getLevelSettings(int character) const {
+        return levels[characters[character].level];
+    }
+
+    /* Graphs evaluated by the last update(), for profiling */
+    int evaluatedLastUpdate() const { return evaluated; }
+
+private:
+    struct Character {
+        AnimationGraph* graph;   // not owned
+        float boundingRadius;
+        std::vector<int> leafJoints;
+        JointMask leafMask;      // leafJoints as a mask over the graph's joints
+        int level;
+        // the two last evaluated poses and their times
+        Pose previous, current, pose;
+        float previousTime, currentTime;
+        bool initialized;
+    };
+
+    std::vector<AnimationLODLevel> levels;
+    std::vector<Character> characters;
+    long long frame;
+    int evaluated;
+};
+
+/**
+* Projected height in pixels of a sphere of the given radius placed at the
+* given view space depth.
+*/
+float projectedScreenHeight(float radius, float viewDepth,
+                            const glm::mat4& projectionMatrix, float viewportHeight);
+
+#endif
@@ -0,0 +1,35 @@
+#include <stdexcept>
+#include <string>
+#include "materialbuffer.h"
+
+using namespace glm;
+using namespace std;
+
+MaterialBuffer::MaterialBuffer(GLuint binding) : binding(binding) {
+    static_assert(sizeof(PackedMaterial) == 4 * sizeof(vec4), "std140 layout of PackedMaterial");
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, MATERIAL_BUFFER_CAPACITY * sizeof(PackedMaterial), NULL,
+                 GL_STATIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+MaterialBuffer::~MaterialBuffer() {
+    glDeleteBuffers(1, &buffer);
+}
+
+void MaterialBuffer::update(const vector<PackedMaterial>& materials) {
+    if (materials.size() > static_cast<size_t>(MATERIAL_BUFFER_CAPACITY)) {
+        throw runtime_error("A material buffer holds " + to_string(MATERIAL_BUFFER_CAPACITY) +
+                            " materials, not " + to_string(materials.size()));
+    }
+    if (materials.empty()) return;
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, 0, materials.size() * sizeof(PackedMaterial),
+                    &materials[0]);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+void MaterialBuffer::bind() {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
@@ -0,0 +1,49 @@
+#ifndef MATERIALBUFFER_H
+#define MATERIALBUFFER_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+/* Materials a uniform block holds, 64 bytes each within the 16 KB every GL has */
+const int MATERIAL_BUFFER_CAPACITY = 256;
+
+/**
+* A material as laid out by std140 in the block. The layers are those of the
+* diffuse and specular texture arrays bound with the draw, -1 for the color.
+*/
+struct PackedMaterial {
+    glm::vec4 Ka, Kd, Ks;
+    float Ns;
+    float diffuseLayer, specularLayer;
+    float padding;
+};
+
+/**
+* The materials of a model in a uniform buffer shared by the programs that
+* declare
+*
+*     struct PackedMaterial { vec4 Ka; vec4 Kd; vec4 Ks; vec4 NsLayers; };
+*     layout(std140) uniform MaterialBlock { PackedMaterial materials[256]; };
+*
+* and bind it to the buffer's binding point. A draw then selects its
+* material by index, one integer uniform instead of the material's uniforms.
+*/
+class MaterialBuffer {
+public:
+    MaterialBuffer(GLuint binding = 1);
+    MaterialBuffer(const MaterialBuffer&) = delete;
+    MaterialBuffer& operator=(const MaterialBuffer&) = delete;
+    ~MaterialBuffer();
+
+    /* Upload the materials, at most MATERIAL_BUFFER_CAPACITY */
+    void update(const std::vector<PackedMaterial>& materials);
+
+    /* Make it the block's buffer, e.g. before drawing the model it belongs to */
+    void bind();
+
+public:
+    GLuint buffer, binding;
+};
+
+#endif
@@ -1,12 +1,20 @@
 #include <iostream>
 #include <sstream>
 #include <map>
+#include <numeric>
+#include <algorithm>
+#include <tuple>
 #include <tinyxml2.h>
+// model.h declares the loader, the implementation goes in this file once
+#include "model.h"
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
 #include "util.h"
-#include "model.h"
 #include "texture.h"
+#include "glstate.h"
+#include "renderqueue.h"
+#include "shaderprogram.h"
+#include "profiler.h"
 
 using namespace glm;
 using namespace std;
@@ -327,6 +335,7 @@ void indexVBO(
 }
 
 Drawable::Drawable(string path) {
+    PROFILE_SCOPE("Drawable::load");
     if (path.substr(path.size() - 3, 3) == "obj") {
         loadOBJWithTiny(path.c_str(), vertices, uvs, normals, VEC_UINT_DEFAUTL_VALUE);
     } else if (path.substr(path.size() - 3, 3) == "vtp") {
@@ -351,17 +360,27 @@ Drawable::~Drawable() {
     glDeleteBuffers(1, &VAO);
 }
 
-void Drawable::bind() {
-    glBindVertexArray(VAO);
+void Drawable::bind(GLStateCache* stateCache) {
+    if (stateCache) {
+        stateCache->bindVertexArray(VAO);
+    } else {
+        glBindVertexArray(VAO);
+    }
 }
 
-void Drawable::draw(int mode) {
-    glDrawElements(mode, indices.size(), GL_UNSIGNED_INT, NULL);
+void Drawable::draw(int mode, int instances) {
+    if (instances > 1) {
+        glDrawElementsInstanced(mode, indices.size(), GL_UNSIGNED_INT, NULL, instances);
+    } else {
+        glDrawElements(mode, indices.size(), GL_UNSIGNED_INT, NULL);
+    }
 }
 
 void Drawable::createContext() {
     indices = vector<unsigned int>();
     indexVBO(vertices, uvs, normals, indices, indexedVertices, indexedUVS, indexedNormals);
+    sphereBounds = boundingSphere(indexedVertices);
+    boxBounds = boundingBox(indexedVertices);
 
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
@@ -414,6 +433,7 @@ Mesh::Mesh(Mesh&& other)
     indexedVertices{std::move(other.indexedVertices)}, indexedNormals{std::move(other.indexedNormals)},
     uvs{std::move(other.uvs)}, indexedUVS{std::move(other.indexedUVS)},
     indices{std::move(other.indices)}, mtl{std::move(other.mtl)},
+    materialIndex{other.materialIndex}, sphereBounds{other.sphereBounds},
     VAO{other.VAO}, verticesVBO{other.verticesVBO}, normalsVBO{other.normalsVBO},
     uvsVBO{other.uvsVBO}, elementVBO{other.elementVBO} {
     other.VAO = 0;
@@ -435,13 +455,18 @@ void Mesh::bind() {
     glBindVertexArray(VAO);
 }
 
-void Mesh::draw(int mode) {
-    glDrawElements(mode, indices.size(), GL_UNSIGNED_INT, NULL);
+void Mesh::draw(int mode, int instances) {
+    if (instances > 1) {
+        glDrawElementsInstanced(mode, indices.size(), GL_UNSIGNED_INT, NULL, instances);
+    } else {
+        glDrawElements(mode, indices.size(), GL_UNSIGNED_INT, NULL);
+    }
 }
 
 void Mesh::createContext() {
     indices = vector<unsigned int>();
     indexVBO(vertices, uvs, normals, indices, indexedVertices, indexedUVS, indexedNormals);
+    sphereBounds = boundingSphere(indexedVertices);
 
     glGenVertexArrays(1, &VAO);
     glBindVertexArray(VAO);
@@ -478,6 +503,38 @@ void Mesh::createContext() {
                  &indices[0], GL_STATIC_DRAW);
 }
 
+vector<PackedMaterial> ogl::packMaterials(const vector<tinyobj::material_t>& materials,
+                                          TextureArrays& textureArrays,
+                                          vector<TextureLayer>& diffuseLayers,
+                                          vector<TextureLayer>& specularLayers) {
+    if (materials.size() >= static_cast<size_t>(MATERIAL_BUFFER_CAPACITY)) {
+        throw runtime_error("A material buffer holds " + to_string(MATERIAL_BUFFER_CAPACITY) +
+                            " materials, with the one for none, not " +
+                            to_string(materials.size() + 1));
+    }
+    vector<PackedMaterial> packedMaterials;
+    for (const auto& material : materials) {
+        TextureLayer diffuse = textureArrays.add(material.diffuse_texname);
+        TextureLayer specular = textureArrays.add(material.specular_texname);
+        PackedMaterial packed = {
+            {material.ambient[0], material.ambient[1], material.ambient[2], 1},
+            {material.diffuse[0], material.diffuse[1], material.diffuse[2], 1},
+            {material.specular[0], material.specular[1], material.specular[2], 1},
+            material.shininess,
+            static_cast<float>(diffuse.layer),
+            static_cast<float>(specular.layer),
+            0.0f};
+        packedMaterials.push_back(packed);
+        diffuseLayers.push_back(diffuse);
+        specularLayers.push_back(specular);
+    }
+    TextureLayer none = {-1, -1};
+    packedMaterials.push_back({vec4(0), vec4(0), vec4(0), 0.0f, -1.0f, -1.0f, 0.0f});
+    diffuseLayers.push_back(none);
+    specularLayers.push_back(none);
+    return packedMaterials;
+}
+
 Model::Model(string path, Model::MTLUploadFunction* uploader)
     : uploadFunction{uploader} {
     if (path.substr(path.size() - 3, 3) == "obj") {
@@ -502,22 +559,86 @@ void Model::draw() {
     }
 }
 
+void Model::draw(ShaderProgram& program, int instances) {
+    PROFILE_SCOPE("Model::draw");
+    materialBuffer.bind();
+    program.setInt(UNIFORM("diffuseTextures"), MODEL_DIFFUSE_UNIT);
+    program.setInt(UNIFORM("specularTextures"), MODEL_SPECULAR_UNIT);
+    GLStateCache* stateCache = program.stateCache;
+    // materials without a texture leave the unit as it is, they do not sample it
+    int diffuseArray = -1, specularArray = -1;
+    auto bindArray = [&](GLuint unit, int array, int& bound) {
+        if (array < 0 || array == bound) return;
+        bound = array;
+        drawStats.arrayBinds++;
+        if (stateCache) {
+            stateCache->bindTexture(unit, GL_TEXTURE_2D_ARRAY, textureArrays.texture(array));
+        } else {
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D_ARRAY, textureArrays.texture(array));
+        }
+    };
+    int materialIndex = -1;
+    for (int m : drawOrder) {
+        Mesh& mesh = meshes[m];
+        bindArray(MODEL_DIFFUSE_UNIT, diffuseLayers[mesh.materialIndex].array, diffuseArray);
+        bindArray(MODEL_SPECULAR_UNIT, specularLayers[mesh.materialIndex].array, specularArray);
+        if (mesh.materialIndex != materialIndex) {
+            materialIndex = mesh.materialIndex;
+            drawStats.materialChanges++;
+        }
+        program.setInt(UNIFORM("materialIndex"), mesh.materialIndex);
+        if (stateCache) {
+            stateCache->bindVertexArray(mesh.VAO);
+        } else {
+            mesh.bind();
+        }
+        mesh.draw(GL_TRIANGLES, instances);
+        drawStats.draws++;
+    }
+}
+
+void Model::enqueue(RenderQueue& queue, ShaderProgram* program, const mat4* modelMatrix) {
+    for (const auto& mesh : meshes) {
+        DrawPacket packet = {0, program, &mesh.mtl, GL_FILL, mesh.VAO,
+                             static_cast<GLsizei>(mesh.indices.size()), modelMatrix, -1};
+        queue.add(packet, vec3(*modelMatrix * vec4(mesh.sphereBounds.center, 1.0f)));
+    }
+}
+
 void Model::loadOBJWithTiny(const std::string& filename) {
     tinyobj::attrib_t attrib;
     vector<tinyobj::shape_t> shapes;
     vector<tinyobj::material_t> materials;
 
+    // the .mtl and its images are next to the .obj
+    string directory = filename.substr(0, filename.find_last_of("/\\") + 1);
     string err;
-    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename.c_str())) {
+    if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &err, filename.c_str(),
+                          directory.c_str())) {
         throw runtime_error(err);
     }
+    for (auto& material : materials) {
+        for (string* name : {&material.ambient_texname, &material.diffuse_texname,
+                             &material.specular_texname, &material.specular_highlight_texname}) {
+            if (!name->empty()) *name = directory + *name;
+        }
+    }
 
-    for (const auto& material : materials) {
-        loadTexture(material.ambient_texname);
-        loadTexture(material.diffuse_texname);
-        loadTexture(material.specular_texname);
-        loadTexture(material.specular_highlight_texname);
+    // only the upload function binds a texture per image, the material
+    // buffer's layers index texture arrays
+    if (uploadFunction) {
+        for (const auto& material : materials) {
+            loadTexture(material.ambient_texname);
+            loadTexture(material.diffuse_texname);
+            loadTexture(material.specular_texname);
+            loadTexture(material.specular_highlight_texname);
+        }
     }
+    vector<PackedMaterial> packedMaterials = packMaterials(materials, textureArrays,
+                                                           diffuseLayers, specularLayers);
+    textureArrays.create();
+    materialBuffer.update(packedMaterials);
 
     for (const auto& shape : shapes) {
         vector<vec3> vertices{};
@@ -550,6 +671,7 @@ void Model::loadOBJWithTiny(const std::string& filename) {
             vertices.push_back(vertex);
         }
         Material mtl{};
+        int materialIndex = static_cast<int>(materials.size());
         if (materials.size() > 0 && shape.mesh.material_ids.size() > 0) {
             int idx = shape.mesh.material_ids[0];
             if (idx < 0 || idx >= static_cast<int>(materials.size()))
@@ -569,9 +691,20 @@ void Model::loadOBJWithTiny(const std::string& filename) {
             if (mtl.texKd) mtl.Kd.r = -1.0f;
             if (mtl.texKs) mtl.Ks.r = -1.0f;
             if (mtl.texNs) mtl.Ns = -1.0f;
+            // those without a material get the last one of the buffer, of zeros
+            if (shape.mesh.material_ids[0] >= 0) materialIndex = idx;
         }
         meshes.emplace_back(vertices, uvs, normals, mtl);
+        meshes.back().materialIndex = materialIndex;
     }
+
+    drawOrder.resize(meshes.size());
+    iota(drawOrder.begin(), drawOrder.end(), 0);
+    stable_sort(drawOrder.begin(), drawOrder.end(), [&](int a, int b) {
+        int ma = meshes[a].materialIndex, mb = meshes[b].materialIndex;
+        return make_tuple(diffuseLayers[ma].array, specularLayers[ma].array, ma) <
+            make_tuple(diffuseLayers[mb].array, specularLayers[mb].array, mb);
+    });
 }
 
 void Model::loadTexture(const std::string& filename) {
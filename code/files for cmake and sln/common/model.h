@@ -6,6 +6,13 @@
 #include <string>
 #include <map>
 #include <glm/glm.hpp>
+#include <tiny_obj_loader.h>
+#include "frustum.h"
+#include "materialbuffer.h"
+#include "texturearray.h"
+
+class RenderQueue;
+class ShaderProgram;
 
 static std::vector<unsigned int> VEC_UINT_DEFAUTL_VALUE{};
 static std::vector<glm::vec3> VEC_VEC3_DEFAUTL_VALUE{};
@@ -61,6 +68,8 @@ void indexVBO(
     std::vector<glm::vec3> & out_normals
 );
 
+class GLStateCache;
+
 class Drawable {
 public:
     Drawable(std::string path);
@@ -72,16 +81,21 @@ public:
 
     ~Drawable();
 
-    void bind();
+    /* Bind the VAO, through the state cache if one is given */
+    void bind(GLStateCache* stateCache = NULL);
 
-    /* Bind VAO before calling draw */
-    void draw(int mode = GL_TRIANGLES);
+    /* Bind VAO before calling draw, more than one instance draws instanced */
+    void draw(int mode = GL_TRIANGLES, int instances = 1);
 
 public:
     std::vector<glm::vec3> vertices, normals, indexedVertices, indexedNormals;
     std::vector<glm::vec2> uvs, indexedUVS;
     std::vector<unsigned int> indices;
 
+    // of the indexed vertices, for culling
+    BoundingSphere sphereBounds;
+    BoundingBox boxBounds;
+
     GLuint VAO, verticesVBO, uvsVBO, normalsVBO, elementVBO;
 
 private:
@@ -112,27 +126,86 @@ namespace ogl {
         Mesh(Mesh&& other);
         ~Mesh();
         void bind();
-        void draw(int mode = GL_TRIANGLES);
+
+        /* Bind VAO before calling draw, more than one instance draws instanced */
+        void draw(int mode = GL_TRIANGLES, int instances = 1);
     public:
         std::vector<glm::vec3> vertices, normals, indexedVertices, indexedNormals;
         std::vector<glm::vec2> uvs, indexedUVS;
         std::vector<unsigned int> indices;
         Material mtl;
+        int materialIndex = 0;        // in the model's material buffer
+        BoundingSphere sphereBounds;  // of the indexed vertices
         GLuint VAO, verticesVBO, uvsVBO, normalsVBO, elementVBO;
     private:
         void createContext();
     };
 
+    // texture units of the model's texture arrays
+    const GLuint MODEL_DIFFUSE_UNIT = 0;
+    const GLuint MODEL_SPECULAR_UNIT = 1;
+
+    /**
+    * Pack the materials of an .obj for a MaterialBuffer, then one of zeros
+    * for shapes without a material. Their diffuse and specular images are
+    * added to the texture arrays and the layers appended per material.
+    * Throws if the materials do not fit the buffer.
+    */
+    std::vector<PackedMaterial> packMaterials(
+        const std::vector<tinyobj::material_t>& materials,
+        TextureArrays& textureArrays,
+        std::vector<TextureLayer>& diffuseLayers,
+        std::vector<TextureLayer>& specularLayers);
+
+    /* State changes of Model::draw(program), summed over its calls */
+    struct MaterialDrawStats {
+        long draws = 0;
+        long arrayBinds = 0;        // of the texture arrays
+        long materialChanges = 0;   // of the material index between draws
+    };
+
+    /**
+    * The meshes of an .obj and their materials. draw() uploads each mesh's
+    * material through the upload function, which also needs a texture per
+    * image; draw(program) selects it from a uniform buffer of all the
+    * model's materials, whose images are in texture arrays by size and
+    * format.
+    */
     class Model {
     public:
         using MTLUploadFunction = void(const Material&);
         Model(std::string path, MTLUploadFunction* uploader = nullptr);
         ~Model();
         void draw();
+
+        /**
+        * Draw with a program compiled with USE_MATERIAL_BUFFER, in use and
+        * its MaterialBlock bound to the material buffer's binding. Meshes go
+        * in the order of their texture arrays and materials, so that each
+        * array is bound once and a mesh only changes its material index.
+        * More than one instance draws instanced, e.g. for the stereo eyes.
+        */
+        void draw(ShaderProgram& program, int instances = 1);
+
+        /**
+        * Queue the meshes instead of drawing them, the material of each is
+        * its Material, to upload with the submission
+        */
+        void enqueue(RenderQueue& queue, ShaderProgram* program, const glm::mat4* modelMatrix);
+
+        int meshCount() const { return static_cast<int>(meshes.size()); }
+    public:
+        MaterialBuffer materialBuffer;
+        TextureArrays textureArrays;
+        MaterialDrawStats drawStats;
+
     private:
         std::vector<Mesh> meshes;
         std::map<std::string, GLuint> textures;
         MTLUploadFunction* uploadFunction;
+        // per material of the buffer
+        std::vector<TextureLayer> diffuseLayers, specularLayers;
+        std::vector<int> drawOrder;  // of the meshes, by arrays then material
     private:
         void loadOBJWithTiny(const std::string& filename);
         void loadTexture(const std::string& filename);
@@ -0,0 +1,349 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <stdexcept>
+#include "motionmatching.h"
+#include "skeleton.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define MM_USE_SSE
+#endif
+
+using namespace glm;
+using namespace std;
+
+static const uint32_t FEATURES_MAGIC = 0x464D4D56;  // "VMMF"
+
+/* Squared distance of two padded vectors, n is a multiple of four */
+static inline float distanceSquared(const float* a, const float* b, int n) {
+#ifdef MM_USE_SSE
+    __m128 sum = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 4) {
+        __m128 d = _mm_sub_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i));
+        sum = _mm_add_ps(sum, _mm_mul_ps(d, d));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#else
+    // four partial sums, as the SSE path
+    float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    for (int i = 0; i < n; i += 4) {
+        for (int k = 0; k < 4; k++) {
+            float d = a[i + k] - b[i + k];
+            sum[k] += d * d;
+        }
+    }
+    return (sum[0] + sum[2]) + (sum[1] + sum[3]);
+#endif
+}
+
+/* Squared distance from a padded vector to a box, zero inside the box */
+static inline float boxDistanceSquared(const float* low, const float* high,
+                                       const float* q, int n) {
+#ifdef MM_USE_SSE
+    __m128 sum = _mm_setzero_ps();
+    __m128 zero = _mm_setzero_ps();
+    for (int i = 0; i < n; i += 4) {
+        __m128 x = _mm_loadu_ps(q + i);
+        __m128 d = _mm_add_ps(_mm_max_ps(_mm_sub_ps(_mm_loadu_ps(low + i), x), zero),
+                              _mm_max_ps(_mm_sub_ps(x, _mm_loadu_ps(high + i)), zero));
+        sum = _mm_add_ps(sum, _mm_mul_ps(d, d));
+    }
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+#else
+    float sum = 0.0f;
+    for (int i = 0; i < n; i++) {
+        float d = std::max(low[i] - q[i], 0.0f) + std::max(q[i] - high[i], 0.0f);
+        sum += d * d;
+    }
+    return sum;
+#endif
+}
+
+MotionDatabase::MotionDatabase(const MotionFeatureLayout& layout)
+    : layout(layout), frames(0) {
+    dimension = static_cast<int>(layout.joints.size()) * 6 +
+        static_cast<int>(layout.trajectoryFrames.size()) * 4;
+    stride = (dimension + 3) & ~3;
+}
+
+int MotionDatabase::addClip(Skeleton* skeleton, int clipFrames, const PoseFunction& pose) {
+    // world positions of the root and the matched joints, and the heading
+    // (root z axis on the ground) of every frame
+    int jointCount = static_cast<int>(layout.joints.size());
+    vector<vec3> rootPosition(clipFrames), heading(clipFrames);
+    vector<vec3> jointPosition(clipFrames * jointCount);
+    for (int f = 0; f < clipFrames; f++) {
+        skeleton->setPose(pose(f));
+        auto world = skeleton->getJointWorldTransformations();
+        const mat4& root = world[layout.rootJoint];
+        rootPosition[f] = vec3(root[3]);
+        vec3 forward(root[2].x, 0.0f, root[2].z);
+        float length = glm::length(forward);
+        heading[f] = length > 1e-6f ? forward / length : vec3(0, 0, 1);
+        for (int j = 0; j < jointCount; j++) {
+            jointPosition[f * jointCount + j] = vec3(world[layout.joints[j]][3]);
+        }
+    }
+
+    int first = frames;
+    features.resize((frames + clipFrames) * dimension);
+    for (int f = 0; f < clipFrames; f++) {
+        // character frame: root on the ground, z along the heading
+        vec3 origin(rootPosition[f].x, 0.0f, rootPosition[f].z);
+        vec3 zAxis = heading[f];
+        vec3 xAxis(zAxis.z, 0.0f, -zAxis.x);
+        auto toCharacter = [&](const vec3& p) {
+            vec3 d = p - origin;
+            return vec3(dot(d, xAxis), d.y, dot(d, zAxis));
+        };
+        auto toCharacterDirection = [&](const vec3& d) {
+            return vec3(dot(d, xAxis), d.y, dot(d, zAxis));
+        };
+
+        float* out = &features[(first + f) * dimension];
+        int previous = std::max(f - 1, 0);
+        for (int j = 0; j < jointCount; j++) {
+            vec3 p = toCharacter(jointPosition[f * jointCount + j]);
+            // velocity in units per frame
+            vec3 v = toCharacterDirection(jointPosition[f * jointCount + j] -
+                                          jointPosition[previous * jointCount + j]);
+            *out++ = p.x; *out++ = p.y; *out++ = p.z;
+            *out++ = v.x; *out++ = v.y; *out++ = v.z;
+        }
+        for (int offset : layout.trajectoryFrames) {
+            int future = std::min(f + offset, clipFrames - 1);
+            vec3 p = toCharacter(rootPosition[future]);
+            vec3 h = toCharacterDirection(heading[future]);
+            *out++ = p.x; *out++ = p.z;
+            *out++ = h.x; *out++ = h.z;
+        }
+    }
+    frames += clipFrames;
+    return first;
+}
+
+int MotionDatabase::addFeatures(const float* rows, int count) {
+    int first = frames;
+    features.insert(features.end(), rows, rows + count * dimension);
+    frames += count;
+    return first;
+}
+
+bool MotionDatabase::saveFeatures(const string& path) const {
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) return false;
+    uint32_t header[3] = {FEATURES_MAGIC, static_cast<uint32_t>(dimension),
+                          static_cast<uint32_t>(frames)};
+    fwrite(header, sizeof(header), 1, file);
+    if (!features.empty()) {
+        fwrite(&features[0], sizeof(float), features.size(), file);
+    }
+    return fclose(file) == 0;
+}
+
+bool MotionDatabase::loadFeatures(const string& path) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) return false;
+    uint32_t header[3] = {0, 0, 0};  // magic, dimension, frames
+    vector<float> rows;
+    bool read = fread(header, sizeof(header), 1, file) == 1 && header[0] == FEATURES_MAGIC &&
+        header[1] == static_cast<uint32_t>(dimension) && header[2] > 0;
+    if (read) {
+        rows.resize(static_cast<size_t>(header[1]) * header[2]);
+        read = fread(&rows[0], sizeof(float), rows.size(), file) == rows.size();
+    }
+    fclose(file);
+    if (!read) return false;
+    addFeatures(&rows[0], static_cast<int>(header[2]));
+    return true;
+}
+
+void MotionDatabase::build(int leafSize) {
+    if (frames == 0) {
+        throw runtime_error("Motion database is empty");
+    }
+
+    // per dimension normalization, constant dimensions are left unscaled
+    mean.assign(dimension, 0.0f);
+    invDeviation.assign(dimension, 0.0f);
+    for (int f = 0; f < frames; f++) {
+        for (int d = 0; d < dimension; d++) {
+            mean[d] += features[f * dimension + d];
+        }
+    }
+    for (int d = 0; d < dimension; d++) mean[d] /= frames;
+    for (int f = 0; f < frames; f++) {
+        for (int d = 0; d < dimension; d++) {
+            float x = features[f * dimension + d] - mean[d];
+            invDeviation[d] += x * x;
+        }
+    }
+    for (int d = 0; d < dimension; d++) {
+        float deviation = sqrt(invDeviation[d] / frames);
+        invDeviation[d] = deviation > 1e-6f ? 1.0f / deviation : 1.0f;
+    }
+
+    // rows are padded with zeros to a multiple of four floats
+    points.assign(frames * stride, 0.0f);
+    for (int f = 0; f < frames; f++) {
+        for (int d = 0; d < dimension; d++) {
+            points[f * stride + d] =
+                (features[f * dimension + d] - mean[d]) * invDeviation[d];
+        }
+    }
+
+    // build the tree over a permutation, then store the points in leaf order
+    order.resize(frames);
+    for (int f = 0; f < frames; f++) order[f] = f;
+    nodes.clear();
+    bounds.clear();
+    buildNode(0, frames, std::max(leafSize, 1));
+
+    vector<float> sorted(frames * stride);
+    for (int i = 0; i < frames; i++) {
+        copy(points.begin() + order[i] * stride,
+             points.begin() + (order[i] + 1) * stride,
+             sorted.begin() + i * stride);
+    }
+    points.swap(sorted);
+}
+
+int MotionDatabase::buildNode(int begin, int end, int leafSize) {
+    int index = static_cast<int>(nodes.size());
+    nodes.push_back(Node());
+    Node node;
+    node.begin = begin;
+    node.end = end;
+    node.splitDimension = -1;
+    node.split = 0.0f;
+    node.left = node.right = -1;
+
+    // bounding box of the points, padding dimensions stay zero
+    node.bounds = static_cast<int>(bounds.size());
+    bounds.resize(bounds.size() + 2 * stride, 0.0f);
+    float* low = &bounds[node.bounds];
+    float* high = low + stride;
+    int widest = 0;
+    for (int d = 0; d < dimension; d++) {
+        low[d] = numeric_limits<float>::max();
+        high[d] = -low[d];
+        for (int i = begin; i < end; i++) {
+            float x = points[order[i] * stride + d];
+            low[d] = std::min(low[d], x);
+            high[d] = std::max(high[d], x);
+        }
+        if (high[d] - low[d] > high[widest] - low[widest]) {
+            widest = d;
+        }
+    }
+
+    // split at the median of the widest dimension
+    if (end - begin > leafSize && high[widest] > low[widest]) {
+        int middle = (begin + end) / 2;
+        const float* p = &points[widest];
+        int n = stride;
+        nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end,
+                    [p, n](int a, int b) { return p[a * n] < p[b * n]; });
+        node.splitDimension = widest;
+        node.split = points[order[middle] * stride + widest];
+        node.left = buildNode(begin, middle, leafSize);
+        node.right = buildNode(middle, end, leafSize);
+    }
+    nodes[index] = node;
+    return index;
+}
+
+void MotionDatabase::normalize(const vector<float>& query, vector<float>& out) const {
+    if (static_cast<int>(query.size()) != dimension) {
+        throw runtime_error("Motion query has the wrong number of features");
+    }
+    out.assign(stride, 0.0f);
+    for (int d = 0; d < dimension; d++) {
+        out[d] = (query[d] - mean[d]) * invDeviation[d];
+    }
+}
+
+int MotionDatabase::search(const vector<float>& query, float* cost, int maxLeaves) const {
+    float best = numeric_limits<float>::max();
+    int bestPoint = -1;
+    if (cost) *cost = best;
+    if (nodes.empty()) {
+        return -1;
+    }
+    vector<float> q;
+    normalize(query, q);
+
+    // nodes by the distance to their box, nearest first; a NaN distance never
+    // compares less than best, so a NaN query matches nothing
+    typedef pair<float, int> Open;
+    vector<Open> open;
+    open.reserve(64);
+    open.push_back(Open(0.0f, 0));
+    int leaves = 0;
+    while (!open.empty()) {
+        pop_heap(open.begin(), open.end(), greater<Open>());
+        Open entry = open.back();
+        open.pop_back();
+        if (!(entry.first < best)) break;
+
+        const Node& node = nodes[entry.second];
+        if (node.splitDimension < 0) {
+            for (int i = node.begin; i < node.end; i++) {
+                float d = distanceSquared(&points[i * stride], &q[0], stride);
+                if (d < best) {
+                    best = d;
+                    bestPoint = i;
+                }
+            }
+            if (maxLeaves > 0 && ++leaves >= maxLeaves) break;
+            continue;
+        }
+        for (int child : {node.left, node.right}) {
+            const float* box = &bounds[nodes[child].bounds];
+            float distance = boxDistanceSquared(box, box + stride, &q[0], stride);
+            if (distance < best) {
+                open.push_back(Open(distance, child));
+                push_heap(open.begin(), open.end(), greater<Open>());
+            }
+        }
+    }
+    if (bestPoint < 0) {
+        return -1;
+    }
+    if (cost) *cost = best;
+    return order[bestPoint];
+}
+
+int MotionDatabase::searchBruteForce(const vector<float>& query, float* cost) const {
+    float best = numeric_limits<float>::max();
+    int bestPoint = -1;
+    if (cost) *cost = best;
+    if (nodes.empty()) {
+        return -1;
+    }
+    vector<float> q;
+    normalize(query, q);
+
+    for (int i = 0; i < static_cast<int>(order.size()); i++) {
+        float d = distanceSquared(&points[i * stride], &q[0], stride);
+        if (d < best) {
+            best = d;
+            bestPoint = i;
+        }
+    }
+    if (cost) *cost = best;
+    return bestPoint < 0 ? -1 : order[bestPoint];
+}
+
+vector<float> MotionDatabase::getFeatures(int frame) const {
+    return vector<float>(features.begin() + frame * dimension,
+                         features.begin() + (frame + 1) * dimension);
+}
@@ -0,0 +1,107 @@
+#ifndef MOTIONMATCHING_H
+#define MOTIONMATCHING_H
+
+#include <vector>
+#include <map>
+#include <string>
+#include <functional>
+#include <glm/glm.hpp>
+
+struct Skeleton;
+
+/**
+* What a motion matching feature vector holds. Everything is expressed in the
+* character frame of the frame, i.e. the root projected on the ground and
+* turned to its heading, so a motion matches regardless of where it happens.
+* A vector has, in order:
+*   - position and velocity (3 + 3) of every matched joint (e.g. the feet)
+*   - ground position and heading (2 + 2) of the root trajectoryFrames ahead
+*/
+struct MotionFeatureLayout {
+    int rootJoint;
+    std::vector<int> joints;
+    std::vector<int> trajectoryFrames;
+};
+
+/**
+* A database of motion capture frames searched by pose and trajectory. Clips
+* are added through Skeleton FK (or from a feature file saved earlier), then
+* build() normalizes every dimension to zero mean and unit deviation and
+* builds a KD-tree. The tree is flat, split at the median of the widest
+* dimension, keeps the bounding box of every node and stores the features of
+* every leaf contiguously. A search visits the leaves nearest box first and
+* stops at the first box farther than the best point; in a few tens of
+* dimensions that can still be most of the leaves, so a leaf budget bounds it
+* to an approximate search of fixed cost. A brute force scan over the same
+* buffer is kept for checking.
+*/
+class MotionDatabase {
+public:
+    typedef std::function<std::map<int, glm::mat4>(int frame)> PoseFunction;
+
+    MotionDatabase(const MotionFeatureLayout& layout);
+
+    /**
+    * Append every frame of a clip, pose(frame) gives the joint local
+    * transformations applied to the skeleton. Trajectory samples past the end
+    * of the clip are clamped. Returns the database index of the first frame.
+    */
+    int addClip(Skeleton* skeleton, int frames, const PoseFunction& pose);
+
+    /* Append raw feature vectors, dimensions() floats each */
+    int addFeatures(const float* rows, int count);
+
+    /**
+    * Save the raw features added so far, or append those of a saved file.
+    * Return false when the file can't be written, or is missing or of
+    * another layout.
+    */
+    bool saveFeatures(const std::string& path) const;
+    bool loadFeatures(const std::string& path);
+
+    /* Normalize the features and build the search tree */
+    void build(int leafSize = 32);
+
+    /**
+    * Nearest frame to a raw (not normalized) query, optionally its cost.
+    * With maxLeaves the search stops after that many leaves and the frame is
+    * only near. Returns -1 when nothing matches, i.e. the database is not
+    * built or the query has NaNs.
+    */
+    int search(const std::vector<float>& query, float* cost = NULL, int maxLeaves = 0) const;
+    int searchBruteForce(const std::vector<float>& query, float* cost = NULL) const;
+
+    /* Raw features of a frame, e.g. to start a query from the playing frame */
+    std::vector<float> getFeatures(int frame) const;
+
+    int dimensions() const { return dimension; }
+    int frameCount() const { return frames; }
+    /* Index of the first trajectory dimension */
+    int trajectoryOffset() const { return static_cast<int>(layout.joints.size()) * 6; }
+
+private:
+    struct Node {
+        int splitDimension;  // -1 for a leaf
+        float split;
+        int begin, end;      // range in points
+        int left, right;
+        int bounds;          // low then high corner in bounds
+    };
+
+    MotionFeatureLayout layout;
+    int dimension;
+    int stride;                         // dimension padded to a multiple of 4
+    int frames;
+    std::vector<float> features;        // raw, frame major
+    std::vector<float> mean, invDeviation;
+    std::vector<float> points;          // normalized and padded, in leaf order
+    std::vector<int> order;             // frame of every point
+    std::vector<Node> nodes;
+    std::vector<float> bounds;          // padded bounding boxes of the nodes
+
+private:
+    int buildNode(int begin, int end, int leafSize);
+    void normalize(const std::vector<float>& query, std::vector<float>& out) const;
+};
+
+#endif
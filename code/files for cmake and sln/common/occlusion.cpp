@@ -0,0 +1,212 @@
+#include <cmath>
+#include <algorithm>
+#include <limits>
+#include "occlusion.h"
+
+// NO_SSE builds the scalar fallback on SSE targets too, e.g. to test it
+#if !defined(NO_SSE) && \
+    (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#include <emmintrin.h>
+#define OCCLUSION_USE_SSE
+#endif
+
+using namespace glm;
+using namespace std;
+
+// pixels per side of a tile
+const int OCCLUSION_TILE = 8;
+// smallest w treated as in front of the eye
+const float OCCLUSION_MIN_W = 1e-4f;
+
+OcclusionCuller::OcclusionCuller(int width, int height, int viewCount)
+    : occluderTriangles(0) {
+    tilesX = std::max((width + OCCLUSION_TILE - 1) / OCCLUSION_TILE, 1);
+    tilesY = std::max((height + OCCLUSION_TILE - 1) / OCCLUSION_TILE, 1);
+    this->width = tilesX * OCCLUSION_TILE;
+    this->height = tilesY * OCCLUSION_TILE;
+    views.resize(std::max(viewCount, 1));
+    for (View& view : views) {
+        view.depth.resize(this->width * this->height);
+        view.tileDepth.resize(tilesX * tilesY);
+    }
+}
+
+void OcclusionCuller::begin(const mat4* viewProjections) {
+    for (size_t v = 0; v < views.size(); v++) {
+        views[v].viewProjection = viewProjections[v];
+        fill(views[v].depth.begin(), views[v].depth.end(), 1.0f);
+    }
+    occluderTriangles = 0;
+}
+
+void OcclusionCuller::addOccluder(const vector<vec3>& vertices,
+                                  const vector<unsigned int>& indices) {
+    for (View& view : views) {
+        clipVertices.resize(vertices.size());
+        for (size_t i = 0; i < vertices.size(); i++) {
+            clipVertices[i] = view.viewProjection * vec4(vertices[i], 1.0f);
+        }
+        for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+            rasterize(view, clipVertices[indices[i]], clipVertices[indices[i + 1]],
+                      clipVertices[indices[i + 2]]);
+        }
+    }
+    occluderTriangles += static_cast<long>(indices.size() / 3);
+}
+
+void OcclusionCuller::rasterize(View& view, const vec4& a, const vec4& b, const vec4& c) {
+    // triangles reaching in front of the near plane are left out, fewer
+    // occluders only cull less
+    const vec4* clip[3] = {&a, &b, &c};
+    vec3 p[3];
+    for (int i = 0; i < 3; i++) {
+        const vec4& v = *clip[i];
+        if (v.w < OCCLUSION_MIN_W || v.z < -v.w) return;
+        p[i] = vec3((v.x / v.w * 0.5f + 0.5f) * width, (v.y / v.w * 0.5f + 0.5f) * height,
+                    v.z / v.w);
+    }
+    float area = (p[1].x - p[0].x) * (p[2].y - p[0].y) - (p[1].y - p[0].y) * (p[2].x - p[0].x);
+    if (area == 0.0f) return;
+    if (area < 0.0f) {
+        // either winding occludes
+        swap(p[1], p[2]);
+        area = -area;
+    }
+
+    int x0 = std::max(static_cast<int>(floor(std::min(std::min(p[0].x, p[1].x), p[2].x))), 0);
+    int y0 = std::max(static_cast<int>(floor(std::min(std::min(p[0].y, p[1].y), p[2].y))), 0);
+    int x1 = std::min(static_cast<int>(ceil(std::max(std::max(p[0].x, p[1].x), p[2].x))), width);
+    int y1 = std::min(static_cast<int>(ceil(std::max(std::max(p[0].y, p[1].y), p[2].y))), height);
+    if (x0 >= x1 || y0 >= y1) return;
+    // rows are processed in aligned groups of four pixels
+    x0 &= ~3;
+
+    // edge functions A x + B y + C, not negative inside; edge i is opposite
+    // vertex i, so it divided by the area is that vertex's barycentric weight
+    float A[3], B[3], C[3];
+    for (int i = 0; i < 3; i++) {
+        const vec3& from = p[(i + 1) % 3];
+        const vec3& to = p[(i + 2) % 3];
+        A[i] = from.y - to.y;
+        B[i] = to.x - from.x;
+        C[i] = -A[i] * from.x - B[i] * from.y;
+    }
+    // the depth plane, NDC z is linear in screen space
+    float zA = (A[0] * p[0].z + A[1] * p[1].z + A[2] * p[2].z) / area;
+    float zB = (B[0] * p[0].z + B[1] * p[1].z + B[2] * p[2].z) / area;
+    float zC = (C[0] * p[0].z + C[1] * p[1].z + C[2] * p[2].z) / area;
+
+    for (int y = y0; y < y1; y++) {
+        float cy = y + 0.5f;
+        float* row = &view.depth[y * width];
+#ifdef OCCLUSION_USE_SSE
+        __m128 zero = _mm_setzero_ps();
+        __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        __m128 edgeA[3], edgeRow[3];
+        for (int i = 0; i < 3; i++) {
+            edgeA[i] = _mm_set1_ps(A[i]);
+            edgeRow[i] = _mm_set1_ps(B[i] * cy + C[i]);
+        }
+        __m128 depthA = _mm_set1_ps(zA), depthRow = _mm_set1_ps(zB * cy + zC);
+        for (int x = x0; x < x1; x += 4) {
+            __m128 cx = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), offsets);
+            __m128 inside = _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[0], cx), edgeRow[0]), zero);
+            inside = _mm_and_ps(inside,
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[1], cx), edgeRow[1]), zero));
+            inside = _mm_and_ps(inside,
+                _mm_cmpge_ps(_mm_add_ps(_mm_mul_ps(edgeA[2], cx), edgeRow[2]), zero));
+            __m128 z = _mm_add_ps(_mm_mul_ps(depthA, cx), depthRow);
+            __m128 stored = _mm_loadu_ps(row + x);
+            __m128 closer = _mm_and_ps(inside, _mm_cmplt_ps(z, stored));
+            _mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(closer, z),
+                                             _mm_andnot_ps(closer, stored)));
+        }
+#else
+        for (int x = x0; x < x1; x++) {
+            float cx = x + 0.5f;
+            if (A[0] * cx + B[0] * cy + C[0] < 0.0f || A[1] * cx + B[1] * cy + C[1] < 0.0f ||
+                A[2] * cx + B[2] * cy + C[2] < 0.0f) {
+                continue;
+            }
+            row[x] = std::min(row[x], zA * cx + zB * cy + zC);
+        }
+#endif
+    }
+}
+
+void OcclusionCuller::finish() {
+    for (View& view : views) {
+        for (int ty = 0; ty < tilesY; ty++) {
+            for (int tx = 0; tx < tilesX; tx++) {
+                float farthest = -1.0f;
+                for (int y = ty * OCCLUSION_TILE; y < (ty + 1) * OCCLUSION_TILE; y++) {
+                    const float* row = &view.depth[y * width + tx * OCCLUSION_TILE];
+                    for (int x = 0; x < OCCLUSION_TILE; x++) {
+                        farthest = std::max(farthest, row[x]);
+                    }
+                }
+                view.tileDepth[ty * tilesX + tx] = farthest;
+            }
+        }
+    }
+}
+
+bool OcclusionCuller::visible(const BoundingBox& box, CullingStats* stats) const {
+    bool anyVisible = false;
+    for (size_t v = 0; v < views.size() && !anyVisible; v++) {
+        anyVisible = visible(views[v], box);
+    }
+    if (stats) {
+        if (anyVisible) {
+            stats->visible++;
+        } else {
+            stats->culled++;
+        }
+    }
+    return anyVisible;
+}
+
+bool OcclusionCuller::visible(const View& view, const BoundingBox& box) const {
+    // the screen rectangle and nearest depth of the corners
+    vec2 lower(numeric_limits<float>::max()), upper(-numeric_limits<float>::max());
+    float nearest = numeric_limits<float>::max();
+    for (int i = 0; i < 8; i++) {
+        vec3 corner((i & 1) ? box.upper.x : box.lower.x, (i & 2) ? box.upper.y : box.lower.y,
+                    (i & 4) ? box.upper.z : box.lower.z);
+        vec4 clip = view.viewProjection * vec4(corner, 1.0f);
+        if (clip.w < OCCLUSION_MIN_W || clip.z < -clip.w) {
+            // reaches the eye, nothing can be in front of all of it
+            return true;
+        }
+        vec2 screen = (vec2(clip) / clip.w * 0.5f + 0.5f) * vec2(width, height);
+        lower = min(lower, screen);
+        upper = max(upper, screen);
+        nearest = std::min(nearest, clip.z / clip.w);
+    }
+    int x0 = std::max(static_cast<int>(floor(lower.x)), 0);
+    int y0 = std::max(static_cast<int>(floor(lower.y)), 0);
+    int x1 = std::min(static_cast<int>(floor(upper.x)), width - 1);
+    int y1 = std::min(static_cast<int>(floor(upper.y)), height - 1);
+    if (x0 > x1 || y0 > y1) {
+        return false;
+    }
+
+    // tiles whose farthest depth is nearer hide the box's part in them,
+    // the others are looked at per pixel
+    for (int ty = y0 / OCCLUSION_TILE; ty <= y1 / OCCLUSION_TILE; ty++) {
+        for (int tx = x0 / OCCLUSION_TILE; tx <= x1 / OCCLUSION_TILE; tx++) {
+            if (nearest > view.tileDepth[ty * tilesX + tx]) continue;
+            int ya = std::max(y0, ty * OCCLUSION_TILE);
+            int yb = std::min(y1, (ty + 1) * OCCLUSION_TILE - 1);
+            int xa = std::max(x0, tx * OCCLUSION_TILE);
+            int xb = std::min(x1, (tx + 1) * OCCLUSION_TILE - 1);
+            for (int y = ya; y <= yb; y++) {
+                const float* row = &view.depth[y * width];
+                for (int x = xa; x <= xb; x++) {
+                    if (nearest <= row[x]) return true;
+                }
+            }
+        }
+    }
+    return false;
+}
@@ -0,0 +1,60 @@
+#ifndef OCCLUSION_H
+#define OCCLUSION_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.h"
+
+/**
+* Occlusion culling on the CPU: a few large occluders are rasterized into a
+* small depth buffer per view (e.g. one per eye), and bounds are tested
+* against it before their draws are submitted. Each buffer keeps the
+* farthest depth of every 8x8 tile too, so that most tests read a tile or
+* two instead of every pixel. Rows are rasterized four pixels at a time
+* with SSE where available.
+*
+* Coverage is sampled at the pixel centers of the small buffer, as on the
+* GPU, so something peeking out from behind an occluder by less than one
+* such pixel may be culled.
+*/
+class OcclusionCuller {
+public:
+    /* width and height are rounded up to whole tiles */
+    OcclusionCuller(int width, int height, int viewCount = 1);
+
+    /* Clear the depth for a frame seen through the views' view projections */
+    void begin(const glm::mat4* viewProjections);
+
+    /* Rasterize world space triangles, three indices each, into every view */
+    void addOccluder(const std::vector<glm::vec3>& vertices,
+                     const std::vector<unsigned int>& indices);
+
+    /* Update the tiles after the occluders, before the tests */
+    void finish();
+
+    /**
+    * False if the box is behind the occluders, or off screen, in every
+    * view; counted in stats if given
+    */
+    bool visible(const BoundingBox& box, CullingStats* stats = NULL) const;
+
+public:
+    int width, height;
+    long occluderTriangles;   // rasterized since begin()
+
+private:
+    struct View {
+        glm::mat4 viewProjection;
+        std::vector<float> depth;       // NDC z per pixel, rows bottom to top
+        std::vector<float> tileDepth;   // farthest of each tile
+    };
+    std::vector<View> views;
+    int tilesX, tilesY;
+    std::vector<glm::vec4> clipVertices;  // of the occluder being added
+
+private:
+    void rasterize(View& view, const glm::vec4& a, const glm::vec4& b, const glm::vec4& c);
+    bool visible(const View& view, const BoundingBox& box) const;
+};
+
+#endif
@@ -0,0 +1,182 @@
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+#include "profiler.h"
+
+using namespace std;
+
+namespace {
+
+struct Event {
+    const char* name;
+    uint64_t begin, end;
+};
+
+// ring buffer of one thread (or of the GPU); when full the oldest events are
+// overwritten
+struct EventBuffer {
+    static const size_t CAPACITY = 1 << 16;
+
+    int id;
+    string name;
+    vector<Event> events;
+    atomic<uint64_t> written;
+
+    EventBuffer(int id, const string& name)
+        : id(id), name(name), events(CAPACITY), written(0) {}
+
+    void push(const char* eventName, uint64_t begin, uint64_t end) {
+        uint64_t index = written.load(memory_order_relaxed);
+        Event& event = events[index % CAPACITY];
+        event.name = eventName;
+        event.begin = begin;
+        event.end = end;
+        written.store(index + 1, memory_order_release);
+    }
+};
+
+// buffers live until exit so that events of finished threads are kept
+std::mutex registryMutex;
+vector<unique_ptr<EventBuffer> > registry;
+const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+
+EventBuffer* registerBuffer(const string& name) {
+    lock_guard<std::mutex> lock(registryMutex);
+    int id = static_cast<int>(registry.size()) + 1;
+    registry.push_back(unique_ptr<EventBuffer>(
+        new EventBuffer(id, name.empty() ? "thread " + to_string(id) : name)));
+    return registry.back().get();
+}
+
+// the buffer is only allocated by the first event, so that naming a thread
+// costs nothing while the profiler is disabled
+thread_local EventBuffer* threadBuffer = NULL;
+thread_local string threadName;
+
+EventBuffer* currentThreadBuffer() {
+    if (threadBuffer == NULL) {
+        threadBuffer = registerBuffer(threadName);
+    }
+    return threadBuffer;
+}
+
+// GPU scopes in issue order; a scope owns two timestamp queries
+struct GpuScope {
+    const char* name;
+    bool ended;
+};
+const int GPU_SCOPES = 256;
+vector<GLuint> gpuQueries;
+GpuScope gpuScopes[GPU_SCOPES];
+int gpuFirst = 0, gpuCount = 0;
+EventBuffer* gpuBuffer = NULL;
+
+}
+
+atomic<bool> Profiler::enabled(false);
+
+void Profiler::setEnabled(bool value) {
+    enabled.store(value, memory_order_relaxed);
+}
+
+uint64_t Profiler::now() {
+    return chrono::duration_cast<chrono::nanoseconds>(
+        chrono::steady_clock::now() - epoch).count() + 1;
+}
+
+void Profiler::setThreadName(const string& name) {
+    threadName = name;
+    if (threadBuffer != NULL) {
+        lock_guard<std::mutex> lock(registryMutex);
+        threadBuffer->name = name;
+    }
+}
+
+void Profiler::record(const char* name, uint64_t begin, uint64_t end) {
+    currentThreadBuffer()->push(name, begin, end);
+}
+
+int Profiler::beginGpu(const char* name) {
+    if (gpuQueries.empty()) {
+        gpuQueries.resize(2 * GPU_SCOPES);
+        glGenQueries(static_cast<GLsizei>(gpuQueries.size()), &gpuQueries[0]);
+        gpuBuffer = registerBuffer("GPU");
+    }
+    if (gpuCount == GPU_SCOPES) {
+        return -1;
+    }
+    int slot = (gpuFirst + gpuCount++) % GPU_SCOPES;
+    gpuScopes[slot].name = name;
+    gpuScopes[slot].ended = false;
+    glQueryCounter(gpuQueries[2 * slot], GL_TIMESTAMP);
+    return slot;
+}
+
+void Profiler::endGpu(int slot) {
+    glQueryCounter(gpuQueries[2 * slot + 1], GL_TIMESTAMP);
+    gpuScopes[slot].ended = true;
+}
+
+void Profiler::collectGpu() {
+    if (gpuCount == 0) return;
+
+    // GPU timestamps are moved onto the CPU clock with the current offset
+    GLint64 gpuNow = 0;
+    glGetInteger64v(GL_TIMESTAMP, &gpuNow);
+    int64_t offset = static_cast<int64_t>(now()) - gpuNow;
+
+    // scopes finish in issue order, stop at the first unfinished one
+    while (gpuCount > 0) {
+        GpuScope& scope = gpuScopes[gpuFirst];
+        if (!scope.ended) break;
+        GLint available = 0;
+        glGetQueryObjectiv(gpuQueries[2 * gpuFirst + 1], GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available) break;
+        GLuint64 begin = 0, end = 0;
+        glGetQueryObjectui64v(gpuQueries[2 * gpuFirst], GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(gpuQueries[2 * gpuFirst + 1], GL_QUERY_RESULT, &end);
+        gpuBuffer->push(scope.name, begin + offset, end + offset);
+        gpuFirst = (gpuFirst + 1) % GPU_SCOPES;
+        gpuCount--;
+    }
+}
+
+void Profiler::shutdownGpu() {
+    if (!gpuQueries.empty()) {
+        glDeleteQueries(static_cast<GLsizei>(gpuQueries.size()), &gpuQueries[0]);
+        gpuQueries.clear();
+        gpuFirst = gpuCount = 0;
+    }
+}
+
+void Profiler::writeChromeTrace(const string& path) {
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == NULL) {
+        throw runtime_error("Can't open the file: " + path);
+    }
+    fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+    bool first = true;
+    lock_guard<std::mutex> lock(registryMutex);
+    for (const auto& buffer : registry) {
+        fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, "
+                "\"tid\": %d, \"args\": {\"name\": \"%s\"}}",
+                first ? "" : ",\n", buffer->id, buffer->name.c_str());
+        first = false;
+
+        uint64_t written = buffer->written.load(memory_order_acquire);
+        uint64_t count = written < EventBuffer::CAPACITY ? written : EventBuffer::CAPACITY;
+        for (uint64_t i = written - count; i < written; i++) {
+            const Event& event = buffer->events[i % EventBuffer::CAPACITY];
+            // trace timestamps are in microseconds
+            fprintf(file, ",\n{\"name\": \"%s\", \"ph\": \"X\", \"pid\": 1, \"tid\": %d, "
+                    "\"ts\": %.3f, \"dur\": %.3f}",
+                    event.name, buffer->id, event.begin / 1000.0,
+                    (event.end - event.begin) / 1000.0);
+        }
+    }
+    fprintf(file, "\n]}\n");
+    fclose(file);
+}
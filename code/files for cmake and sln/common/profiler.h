@@ -0,0 +1,89 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <GL/glew.h>
+#include <atomic>
+#include <string>
+#include <cstdint>
+
+/**
+* Lightweight frame profiler. CPU scopes are appended to a ring buffer of the
+* calling thread, so recording takes no lock; GPU scopes are bracketed by
+* GL_TIMESTAMP queries from a pool (TIME_ELAPSED queries cannot nest) and are
+* read back by collectGpu() once their results are available, a few frames
+* later. Everything is exported as Chrome trace events (chrome://tracing,
+* Perfetto), where scopes of the same thread nest by time.
+*
+* The macros compile to nothing without ENABLE_PROFILER. With it, a disabled
+* profiler costs one relaxed atomic load per scope. Scope names must outlive
+* the export, i.e. be string literals.
+*/
+class Profiler {
+public:
+    static void setEnabled(bool enabled);
+    static bool isEnabled() { return enabled.load(std::memory_order_relaxed); }
+
+    /* Nanoseconds since the profiler started, never zero */
+    static uint64_t now();
+
+    /* Name shown for the calling thread in the trace */
+    static void setThreadName(const std::string& name);
+
+    static void record(const char* name, uint64_t begin, uint64_t end);
+
+    /* Returns the scope slot, or -1 if the query pool is exhausted */
+    static int beginGpu(const char* name);
+    static void endGpu(int slot);
+
+    /* Read back finished GPU scopes without waiting, call once per frame */
+    static void collectGpu();
+
+    /* Release the GPU queries, call while the GL context is current */
+    static void shutdownGpu();
+
+    /**
+    * Write the recorded events as Chrome trace JSON. Threads should be idle
+    * (e.g. between frames), events recorded meanwhile may be torn.
+    */
+    static void writeChromeTrace(const std::string& path);
+
+private:
+    static std::atomic<bool> enabled;
+};
+
+class ProfileScope {
+public:
+    ProfileScope(const char* name)
+        : name(name), begin(Profiler::isEnabled() ? Profiler::now() : 0) {}
+    ~ProfileScope() {
+        if (begin) Profiler::record(name, begin, Profiler::now());
+    }
+
+private:
+    const char* name;
+    uint64_t begin;
+};
+
+class GpuProfileScope {
+public:
+    GpuProfileScope(const char* name)
+        : slot(Profiler::isEnabled() ? Profiler::beginGpu(name) : -1) {}
+    ~GpuProfileScope() {
+        if (slot >= 0) Profiler::endGpu(slot);
+    }
+
+private:
+    int slot;
+};
+
+#ifdef ENABLE_PROFILER
+#define PROFILER_CONCAT_(a, b) a##b
+#define PROFILER_CONCAT(a, b) PROFILER_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILER_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_GPU_SCOPE(name) GpuProfileScope PROFILER_CONCAT(gpuProfileScope, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_GPU_SCOPE(name) ((void)0)
+#endif
+
+#endif
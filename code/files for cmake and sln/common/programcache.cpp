@@ -0,0 +1,218 @@
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <chrono>
+#include <thread>
+#include <iostream>
+#include "programcache.h"
+#include "shader.h"
+#include "profiler.h"
+
+using namespace std;
+
+// KHR_parallel_shader_compile is newer than the bundled GLEW
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
+
+namespace {
+
+const uint32_t BINARY_MAGIC = 0x42504c47;  // "GLPB"
+
+uint64_t fnv1a(const string& text, uint64_t hash = 14695981039346656037ull) {
+    for (unsigned char c : text) {
+        hash = (hash ^ c) * 1099511628211ull;
+    }
+    return hash;
+}
+
+bool hasExtension(const char* name) {
+    GLint count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+    for (GLint i = 0; i < count; i++) {
+        const char* extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+        if (extension && strcmp(extension, name) == 0) return true;
+    }
+    return false;
+}
+
+string glString(GLenum name) {
+    const GLubyte* value = glGetString(name);
+    return value ? reinterpret_cast<const char*>(value) : "";
+}
+
+bool loadBinary(const string& path, GLuint program) {
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) return false;
+    uint32_t header[3] = {0, 0, 0};  // magic, format, length
+    vector<char> binary;
+    bool read = fread(header, sizeof(header), 1, file) == 1 && header[0] == BINARY_MAGIC;
+    if (read) {
+        binary.resize(header[2]);
+        read = !binary.empty() && fread(&binary[0], binary.size(), 1, file) == 1;
+    }
+    fclose(file);
+    if (!read) return false;
+
+    // the driver may still reject it, e.g. after an update it does not report
+    glProgramBinary(program, header[1], &binary[0], static_cast<GLsizei>(binary.size()));
+    GLint linked = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+void saveBinary(const string& path, GLuint program) {
+    GLint length = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) return;
+    vector<char> binary(length);
+    GLenum format = 0;
+    glGetProgramBinary(program, length, NULL, &format, &binary[0]);
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+        cout << "Can't write the program binary: " << path << endl;
+        return;
+    }
+    uint32_t header[3] = {BINARY_MAGIC, format, static_cast<uint32_t>(length)};
+    fwrite(header, sizeof(header), 1, file);
+    fwrite(&binary[0], binary.size(), 1, file);
+    fclose(file);
+}
+
+void printLog(GLuint object, bool program) {
+    GLint length = 0;
+    if (program) {
+        glGetProgramiv(object, GL_INFO_LOG_LENGTH, &length);
+    } else {
+        glGetShaderiv(object, GL_INFO_LOG_LENGTH, &length);
+    }
+    if (length <= 1) return;
+    vector<char> message(length + 1);
+    if (program) {
+        glGetProgramInfoLog(object, length, NULL, &message[0]);
+    } else {
+        glGetShaderInfoLog(object, length, NULL, &message[0]);
+    }
+    cout << &message[0] << endl;
+}
+
+// a program whose compile and link were submitted but not yet checked
+struct PendingProgram {
+    GLuint program;
+    vector<GLuint> shaders;
+    vector<string> paths;
+    string binaryPath;
+};
+
+}
+
+ProgramCache::ProgramCache(const string& pathPrefix)
+    : hits(0), misses(0), pathPrefix(pathPrefix) {
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    binariesSupported = formats > 0;
+    parallelCompile = hasExtension("GL_KHR_parallel_shader_compile") ||
+        hasExtension("GL_ARB_parallel_shader_compile");
+    driverKey = glString(GL_RENDERER) + "\n" + glString(GL_VERSION) + "\n" +
+        glString(GL_VENDOR) + "\n";
+}
+
+vector<GLuint> ProgramCache::load(const vector<ProgramSource>& sources) {
+    PROFILE_SCOPE("ProgramCache::load");
+    auto start = chrono::steady_clock::now();
+    vector<GLuint> programs;
+    vector<PendingProgram> pending;
+    int programHits = 0;
+
+    for (const ProgramSource& source : sources) {
+        const GLenum types[] = {GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER};
+        const string* paths[] = {&source.vertexPath, &source.fragmentPath, &source.geometryPath};
+        vector<string> codes(3);
+        uint64_t key = fnv1a(driverKey);
+        for (int s = 0; s < 3; s++) {
+            if (paths[s]->empty()) continue;
+            codes[s] = insertDefines(readShaderSource(paths[s]->c_str()), source.defines);
+            // the stage is part of the key, as is where one source ends
+            key = fnv1a(to_string(s) + "\n" + codes[s] + "\n", key);
+        }
+        char keyText[17];
+        snprintf(keyText, sizeof(keyText), "%016llx", static_cast<unsigned long long>(key));
+
+        GLuint program = glCreateProgram();
+        programs.push_back(program);
+        PendingProgram entry;
+        entry.program = program;
+        entry.binaryPath = pathPrefix + keyText + ".bin";
+        if (binariesSupported && loadBinary(entry.binaryPath, program)) {
+            programHits++;
+            continue;
+        }
+
+        // submit without querying anything, the driver may compile in the
+        // background until the status is asked for
+        for (int s = 0; s < 3; s++) {
+            if (paths[s]->empty()) continue;
+            GLuint shader = glCreateShader(types[s]);
+            const char* code = codes[s].c_str();
+            glShaderSource(shader, 1, &code, NULL);
+            glCompileShader(shader);
+            glAttachShader(program, shader);
+            entry.shaders.push_back(shader);
+            entry.paths.push_back(*paths[s]);
+        }
+        if (binariesSupported) {
+            glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(program);
+        pending.push_back(entry);
+    }
+    hits += programHits;
+    misses += static_cast<int>(pending.size());
+    size_t compiled = pending.size();
+
+    // finalize programs as they complete; without the extension the first
+    // query waits for that program, by which time the rest are submitted
+    while (!pending.empty()) {
+        bool progress = false;
+        for (size_t p = 0; p < pending.size(); ) {
+            PendingProgram& entry = pending[p];
+            if (parallelCompile) {
+                GLint completed = GL_FALSE;
+                glGetProgramiv(entry.program, GL_COMPLETION_STATUS_KHR, &completed);
+                if (!completed) {
+                    p++;
+                    continue;
+                }
+            }
+            GLint linked = GL_FALSE;
+            glGetProgramiv(entry.program, GL_LINK_STATUS, &linked);
+            if (!linked) {
+                for (size_t s = 0; s < entry.shaders.size(); s++) {
+                    cout << "Compiling shader: " << entry.paths[s] << endl;
+                    printLog(entry.shaders[s], false);
+                }
+                printLog(entry.program, true);
+            }
+            for (GLuint shader : entry.shaders) {
+                glDetachShader(entry.program, shader);
+                glDeleteShader(shader);
+            }
+            if (linked && binariesSupported) {
+                saveBinary(entry.binaryPath, entry.program);
+            }
+            pending.erase(pending.begin() + p);
+            progress = true;
+        }
+        if (!progress) {
+            this_thread::sleep_for(chrono::microseconds(200));
+        }
+    }
+
+    cout << "Loaded " << sources.size() << " programs (" << programHits << " cached, "
+        << compiled << " compiled) in "
+        << chrono::duration<double, milli>(chrono::steady_clock::now() - start).count()
+        << " ms" << endl;
+    return programs;
+}
@@ -0,0 +1,45 @@
+#ifndef PROGRAMCACHE_H
+#define PROGRAMCACHE_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+/* Shader files of one program, the geometry shader is optional */
+struct ProgramSource {
+    std::string vertexPath;
+    std::string fragmentPath;
+    std::string geometryPath;
+    std::string defines;  // inserted after #version in every stage
+};
+
+/**
+* Loads programs from driver binaries saved by earlier runs
+* (ARB_get_program_binary), keyed by a hash of the GLSL sources and of the
+* renderer, version and vendor strings, so editing a shader or updating the
+* driver invalidates the entry. Programs that miss are compiled as a batch:
+* every compile and link is submitted before any status is queried, which lets
+* drivers with KHR_parallel_shader_compile work on all of them at once, and
+* each is finalized and saved as soon as it completes.
+*
+* Binaries are stored as <pathPrefix><key>.bin. Like loadShaders(), compile
+* and link errors are printed and the (unusable) program is still returned.
+*/
+class ProgramCache {
+public:
+    ProgramCache(const std::string& pathPrefix);
+
+    /* Program names in the order of the sources */
+    std::vector<GLuint> load(const std::vector<ProgramSource>& sources);
+
+public:
+    // statistics of the calls to load()
+    int hits, misses;
+    bool binariesSupported, parallelCompile;
+
+private:
+    std::string pathPrefix;
+    std::string driverKey;
+};
+
+#endif
@@ -0,0 +1,252 @@
+#include <cmath>
+#include <cstring>
+#include <stdexcept>
+#include "recording.h"
+
+using namespace std;
+
+static const uint32_t SESSION_MAGIC = 0x52535256;       // "VRSR"
+static const uint32_t SESSION_INDEX_MAGIC = 0x58535256; // "VRSX"
+static const uint32_t SESSION_VERSION = 1;
+
+// integers are stored in host order, i.e. little endian on x86 and ARM
+
+template<typename T>
+static void put(vector<uint8_t>& out, T value) {
+    uint8_t bytes[sizeof(T)];
+    memcpy(bytes, &value, sizeof(T));
+    out.insert(out.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+static T get(const char* data, size_t size, size_t& pos) {
+    if (pos > size || size - pos < sizeof(T)) {
+        throw runtime_error("Session file is truncated");
+    }
+    T value;
+    memcpy(&value, data + pos, sizeof(T));
+    pos += sizeof(T);
+    return value;
+}
+
+static void putVarint(vector<uint8_t>& out, int64_t value) {
+    // zigzag maps small negative and positive residuals to small codes
+    uint64_t code = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+    while (code >= 0x80) {
+        out.push_back(static_cast<uint8_t>(code | 0x80));
+        code >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(code));
+}
+
+static int64_t getVarint(const uint8_t*& p, const uint8_t* end) {
+    uint64_t code = 0;
+    int shift = 0;
+    while (true) {
+        if (p == end || shift > 63) {
+            throw runtime_error("Session file has a corrupted block");
+        }
+        uint8_t byte = *p++;
+        code |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) break;
+        shift += 7;
+    }
+    return static_cast<int64_t>(code >> 1) ^ -static_cast<int64_t>(code & 1);
+}
+
+/* Quantization steps must be positive, llround(value / step) is undefined otherwise */
+static void checkSteps(const vector<float>& steps) {
+    if (steps.empty()) {
+        throw runtime_error("Session recording needs at least one channel");
+    }
+    for (float step : steps) {
+        if (!(step > 0.0f) || std::isinf(step)) {
+            throw runtime_error("Session channel steps must be positive");
+        }
+    }
+}
+
+/* Linear prediction from the two previous frames of the block */
+static int64_t predict(int frameInBlock, int64_t previous, int64_t beforePrevious) {
+    if (frameInBlock == 0) return 0;
+    if (frameInBlock == 1) return previous;
+    return 2 * previous - beforePrevious;
+}
+
+SessionRecorder::SessionRecorder(const string& path, const vector<float>& steps,
+                                 int framesPerBlock)
+    : steps(steps), framesPerBlock(framesPerBlock), blockFrames(0),
+    previous(steps.size()), beforePrevious(steps.size()), totalFrames(0), offset(0) {
+    checkSteps(steps);
+    if (framesPerBlock <= 0) {
+        throw runtime_error("Session blocks must hold at least one frame");
+    }
+    file = fopen(path.c_str(), "wb");
+    if (file == NULL) {
+        throw runtime_error("Can't open the file: " + path);
+    }
+
+    vector<uint8_t> header;
+    put<uint32_t>(header, SESSION_MAGIC);
+    put<uint32_t>(header, SESSION_VERSION);
+    put<uint32_t>(header, static_cast<uint32_t>(steps.size()));
+    put<uint32_t>(header, static_cast<uint32_t>(framesPerBlock));
+    for (float step : steps) {
+        put<float>(header, step);
+    }
+    fwrite(&header[0], 1, header.size(), file);
+    offset = header.size();
+}
+
+SessionRecorder::~SessionRecorder() {
+    close();
+}
+
+void SessionRecorder::append(const vector<float>& values) {
+    if (file == NULL) {
+        throw runtime_error("Session recorder is closed");
+    }
+    if (values.size() != steps.size()) {
+        throw runtime_error("Session frame has the wrong number of channels");
+    }
+    for (size_t c = 0; c < steps.size(); c++) {
+        int64_t quantized = llround(values[c] / steps[c]);
+        putVarint(block, quantized - predict(blockFrames, previous[c], beforePrevious[c]));
+        beforePrevious[c] = previous[c];
+        previous[c] = quantized;
+    }
+    totalFrames++;
+    if (++blockFrames == framesPerBlock) {
+        flushBlock();
+    }
+}
+
+void SessionRecorder::flushBlock() {
+    if (blockFrames == 0) return;
+    vector<uint8_t> blockHeader;
+    put<uint32_t>(blockHeader, static_cast<uint32_t>(blockFrames));
+    put<uint32_t>(blockHeader, static_cast<uint32_t>(block.size()));
+    fwrite(&blockHeader[0], 1, blockHeader.size(), file);
+    fwrite(&block[0], 1, block.size(), file);
+
+    blockOffsets.push_back(offset);
+    offset += blockHeader.size() + block.size();
+    block.clear();
+    blockFrames = 0;
+}
+
+void SessionRecorder::close() {
+    if (file == NULL) return;
+    flushBlock();
+
+    vector<uint8_t> index;
+    for (uint64_t blockOffset : blockOffsets) {
+        put<uint64_t>(index, blockOffset);
+    }
+    put<uint64_t>(index, totalFrames);
+    put<uint32_t>(index, static_cast<uint32_t>(blockOffsets.size()));
+    put<uint32_t>(index, SESSION_INDEX_MAGIC);
+    fwrite(&index[0], 1, index.size(), file);
+    fclose(file);
+    file = NULL;
+}
+
+SessionReplayer::SessionReplayer(const string& path)
+    : file(path), blockSize(0), totalFrames(0), cachedBlock(-1) {
+    const char* data = file.data();
+    size_t size = file.size();
+    size_t pos = 0;
+    if (get<uint32_t>(data, size, pos) != SESSION_MAGIC ||
+        get<uint32_t>(data, size, pos) != SESSION_VERSION) {
+        throw runtime_error("Not a session recording: " + path);
+    }
+    uint32_t channels = get<uint32_t>(data, size, pos);
+    blockSize = static_cast<int>(get<uint32_t>(data, size, pos));
+    for (uint32_t c = 0; c < channels; c++) {
+        steps.push_back(get<float>(data, size, pos));
+    }
+    size_t headerSize = pos;
+    if (blockSize <= 0) {
+        throw runtime_error("Session file has no frames per block: " + path);
+    }
+    checkSteps(steps);
+
+    // read the index written by close()
+    size_t tailSize = sizeof(uint64_t) + 2 * sizeof(uint32_t);
+    if (size >= headerSize + tailSize) {
+        size_t tail = size - tailSize;
+        size_t p = size - sizeof(uint32_t);
+        if (get<uint32_t>(data, size, p) == SESSION_INDEX_MAGIC) {
+            p = tail;
+            totalFrames = get<uint64_t>(data, size, p);
+            uint32_t blocks = get<uint32_t>(data, size, p);
+            if (blocks > (tail - headerSize) / sizeof(uint64_t)) {
+                throw runtime_error("Session file has a corrupted index: " + path);
+            }
+            p = tail - blocks * sizeof(uint64_t);
+            for (uint32_t b = 0; b < blocks; b++) {
+                blockOffsets.push_back(get<uint64_t>(data, size, p));
+            }
+            return;
+        }
+    }
+
+    // no index, walk the complete blocks
+    pos = headerSize;
+    while (pos + 2 * sizeof(uint32_t) <= size) {
+        size_t blockStart = pos;
+        uint32_t frames = get<uint32_t>(data, size, pos);
+        uint32_t bytes = get<uint32_t>(data, size, pos);
+        if (frames == 0 || frames > static_cast<uint32_t>(blockSize) ||
+            bytes == 0 || pos + bytes > size) break;
+        blockOffsets.push_back(blockStart);
+        totalFrames += frames;
+        pos += bytes;
+    }
+}
+
+void SessionReplayer::decodeBlock(int blockIndex) {
+    const char* data = file.data();
+    size_t pos = blockOffsets[blockIndex];
+    uint32_t frames = get<uint32_t>(data, file.size(), pos);
+    uint32_t bytes = get<uint32_t>(data, file.size(), pos);
+    if (pos + bytes > file.size()) {
+        throw runtime_error("Session file is truncated");
+    }
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data + pos);
+    const uint8_t* end = p + bytes;
+
+    size_t channels = steps.size();
+    vector<int64_t> previous(channels), beforePrevious(channels);
+    cached.resize(frames * channels);
+    for (uint32_t f = 0; f < frames; f++) {
+        for (size_t c = 0; c < channels; c++) {
+            int64_t quantized = getVarint(p, end) +
+                predict(f, previous[c], beforePrevious[c]);
+            beforePrevious[c] = previous[c];
+            previous[c] = quantized;
+            cached[f * channels + c] = static_cast<float>(quantized * static_cast<double>(steps[c]));
+        }
+    }
+    cachedBlock = blockIndex;
+}
+
+void SessionReplayer::readFrame(int index, vector<float>& values) {
+    if (index < 0 || index >= frameCount()) {
+        throw out_of_range("Session frame index out of range");
+    }
+    // every block but the last holds blockSize frames
+    int blockIndex = index / blockSize;
+    if (blockIndex >= blockCount()) {
+        throw runtime_error("Session file has fewer blocks than frames");
+    }
+    if (blockIndex != cachedBlock) {
+        decodeBlock(blockIndex);
+    }
+    size_t channels = steps.size();
+    size_t first = (index % blockSize) * channels;
+    if (first + channels > cached.size()) {
+        throw runtime_error("Session file has a short block");
+    }
+    values.assign(cached.begin() + first, cached.begin() + first + channels);
+}
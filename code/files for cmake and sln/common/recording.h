@@ -0,0 +1,85 @@
+#ifndef RECORDING_H
+#define RECORDING_H
+
+#include <vector>
+#include <string>
+#include <cstdio>
+#include <cstdint>
+#include "util.h"
+
+/**
+* Records a session as frames of float channels (e.g. time, camera and the
+* generalized coordinates q). Every channel is quantized with its own step,
+* predicted linearly from the two previous frames of the same block and the
+* residual is stored as a zigzag varint, so smooth motion costs a byte or two
+* per channel. Frames are grouped in blocks of framesPerBlock that decode
+* independently, and an index of the block offsets is written on close().
+*
+* Layout (little endian):
+*   header: magic, version, channels, framesPerBlock, steps[channels]
+*   blocks: frames, payload bytes, payload
+*   index:  offsets[blocks], total frames, blocks, magic
+*/
+class SessionRecorder {
+public:
+    SessionRecorder(const std::string& path, const std::vector<float>& steps,
+                    int framesPerBlock = 256);
+    SessionRecorder(const SessionRecorder&) = delete;
+    SessionRecorder& operator=(const SessionRecorder&) = delete;
+    ~SessionRecorder();
+
+    /* Append a frame, values must have one entry per channel */
+    void append(const std::vector<float>& values);
+
+    /* Flush the last block and write the index */
+    void close();
+
+private:
+    FILE* file;
+    std::vector<float> steps;
+    int framesPerBlock;
+    std::vector<uint8_t> block;
+    int blockFrames;
+    std::vector<int64_t> previous, beforePrevious;
+    std::vector<uint64_t> blockOffsets;
+    uint64_t totalFrames;
+    uint64_t offset;
+
+private:
+    void flushBlock();
+};
+
+/**
+* Replays a recorded session. The file is memory mapped and a frame is read
+* by decoding only the block that contains it, so seeking is constant time.
+* The last decoded block is cached for sequential playback. Files whose
+* recorder did not close (e.g. after a crash) are indexed by walking the
+* blocks.
+*/
+class SessionReplayer {
+public:
+    SessionReplayer(const std::string& path);
+
+    void readFrame(int index, std::vector<float>& values);
+
+    int frameCount() const { return static_cast<int>(totalFrames); }
+    int channelCount() const { return static_cast<int>(steps.size()); }
+    int blockCount() const { return static_cast<int>(blockOffsets.size()); }
+    int framesPerBlock() const { return blockSize; }
+
+private:
+    MappedFile file;
+    std::vector<float> steps;
+    int blockSize;
+    std::vector<uint64_t> blockOffsets;
+    uint64_t totalFrames;
+
+    // decoded values of the cached block, frame major
+    int cachedBlock;
+    std::vector<float> cached;
+
+private:
+    void decodeBlock(int block);
+};
+
+#endif
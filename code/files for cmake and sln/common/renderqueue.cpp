@@ -0,0 +1,151 @@
+#include <algorithm>
+#include "renderqueue.h"
+#include "glstate.h"
+#include "shaderprogram.h"
+
+using namespace glm;
+using namespace std;
+
+// bits of the key per state, ids past them wrap and only sort less well
+const int RENDER_STATE_BITS = 12;
+const int RENDER_DEPTH_BITS = 64 - 3 * RENDER_STATE_BITS;
+const uint64_t RENDER_STATE_MASK = (1u << RENDER_STATE_BITS) - 1;
+const uint64_t RENDER_DEPTH_MAX = (uint64_t(1) << RENDER_DEPTH_BITS) - 1;
+
+RenderQueue::RenderQueue(float depthRange) : depthRange(depthRange), isSorted(false) {
+}
+
+void RenderQueue::begin(const mat4& viewMatrix) {
+    this->viewMatrix = viewMatrix;
+    packets.clear();
+    isSorted = false;
+}
+
+void RenderQueue::add(const DrawPacket& packet, const vec3& center) {
+    // the polygon mode in the low bits of the material's id
+    uint32_t mode = packet.polygonMode == GL_FILL ? 0 : packet.polygonMode == GL_LINE ? 1 : 2;
+    uint64_t program = stateId(programIds, packet.program);
+    uint64_t material = (stateId(materialIds, packet.material) << 2) | mode;
+    uint64_t vertexArray = stateId(vertexArrayIds,
+        reinterpret_cast<const void*>(static_cast<uintptr_t>(packet.vertexArray)));
+
+    float depth = -(viewMatrix * vec4(center, 1.0f)).z;
+    depth = std::min(std::max(depth / depthRange, 0.0f), 1.0f);
+
+    isSorted = false;
+    packets.push_back(packet);
+    packets.back().key = (program & RENDER_STATE_MASK) << (64 - RENDER_STATE_BITS) |
+        (material & RENDER_STATE_MASK) << (64 - 2 * RENDER_STATE_BITS) |
+        (vertexArray & RENDER_STATE_MASK) << RENDER_DEPTH_BITS |
+        static_cast<uint64_t>(static_cast<double>(depth) * RENDER_DEPTH_MAX);
+}
+
+void RenderQueue::submit(GLStateCache* stateCache, int instances,
+                         const function<void(const DrawPacket&, unsigned changes)>& setup) {
+    if (!isSorted) {
+        sort();
+    }
+
+    const DrawPacket* previous = NULL;
+    for (const SortEntry& entry : entries) {
+        const DrawPacket& packet = packets[entry.packet];
+        unsigned changed = changes(previous, packet);
+        setup(packet, changed);
+        if (stateCache) {
+            stateCache->polygonMode(packet.polygonMode);
+            stateCache->bindVertexArray(packet.vertexArray);
+        } else {
+            glPolygonMode(GL_FRONT_AND_BACK, packet.polygonMode);
+            glBindVertexArray(packet.vertexArray);
+        }
+        if (instances > 1) {
+            glDrawElementsInstanced(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT, NULL,
+                                    instances);
+        } else {
+            glDrawElements(GL_TRIANGLES, packet.indexCount, GL_UNSIGNED_INT, NULL);
+        }
+        previous = &packet;
+    }
+    packets.clear();
+    isSorted = false;
+}
+
+uint32_t RenderQueue::stateId(unordered_map<const void*, uint32_t>& ids, const void* state) {
+    auto found = ids.find(state);
+    if (found != ids.end()) {
+        return found->second;
+    }
+    uint32_t id = static_cast<uint32_t>(ids.size());
+    ids[state] = id;
+    return id;
+}
+
+void RenderQueue::sort() {
+    size_t n = packets.size();
+    for (size_t i = 0; i < n; i++) {
+        count(unsorted, changes(i > 0 ? &packets[i - 1] : NULL, packets[i]));
+    }
+
+    entries.resize(n);
+    scratch.resize(n);
+    for (size_t i = 0; i < n; i++) {
+        entries[i].key = packets[i].key;
+        entries[i].packet = static_cast<uint32_t>(i);
+    }
+
+    // the histograms of all bytes in one pass over the keys
+    fill(&counts[0][0], &counts[0][0] + 8 * 256, size_t(0));
+    for (const SortEntry& entry : entries) {
+        for (int byte = 0; byte < 8; byte++) {
+            counts[byte][(entry.key >> (8 * byte)) & 0xff]++;
+        }
+    }
+
+    // least significant byte first, each pass stable
+    for (int byte = 0; byte < 8; byte++) {
+        size_t* count = counts[byte];
+        if (n == 0 || count[(entries[0].key >> (8 * byte)) & 0xff] == n) {
+            continue;
+        }
+        size_t offsets[256];
+        size_t offset = 0;
+        for (int digit = 0; digit < 256; digit++) {
+            offsets[digit] = offset;
+            offset += count[digit];
+        }
+        for (const SortEntry& entry : entries) {
+            scratch[offsets[(entry.key >> (8 * byte)) & 0xff]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+
+    for (size_t i = 0; i < n; i++) {
+        count(submitted, changes(i > 0 ? &sorted(i - 1) : NULL, sorted(i)));
+    }
+    isSorted = true;
+}
+
+unsigned RenderQueue::changes(const DrawPacket* previous, const DrawPacket& packet) {
+    if (previous == NULL) {
+        return PROGRAM_CHANGED | MATERIAL_CHANGED | VERTEX_ARRAY_CHANGED;
+    }
+    unsigned changed = 0;
+    if (packet.program != previous->program) {
+        // the material's uniforms are the program's own, so uploaded again
+        changed |= PROGRAM_CHANGED | MATERIAL_CHANGED;
+    }
+    if (packet.material != previous->material || packet.polygonMode != previous->polygonMode) {
+        changed |= MATERIAL_CHANGED;
+    }
+    if (packet.vertexArray != previous->vertexArray) {
+        changed |= VERTEX_ARRAY_CHANGED;
+    }
+    return changed;
+}
+
+void RenderQueue::count(RenderQueueStats& stats, unsigned changes) {
+    stats.draws++;
+    if (changes & PROGRAM_CHANGED) stats.programChanges++;
+    if (changes & MATERIAL_CHANGED) stats.materialChanges++;
+    if (changes & VERTEX_ARRAY_CHANGED) stats.vertexArrayChanges++;
+}
@@ -0,0 +1,106 @@
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <glm/glm.hpp>
+
+class GLStateCache;
+class ShaderProgram;
+
+/* What a draw binds, a GL_TRIANGLES draw of unsigned int indices */
+struct DrawPacket {
+    uint64_t key;                   // set by RenderQueue::add()
+    ShaderProgram* program;
+    const void* material;           // compared by address, uploaded by the caller
+    GLenum polygonMode;             // sorted and counted with the material
+    GLuint vertexArray;
+    GLsizei indexCount;
+    const glm::mat4* modelMatrix;   // must outlive the submission
+    int item;                       // the caller's, e.g. a character
+};
+
+/* Draws submitted and the state changes between them */
+struct RenderQueueStats {
+    long draws = 0, programChanges = 0, materialChanges = 0, vertexArrayChanges = 0;
+};
+
+/**
+* What changed since the previous packet, passed to the submission; a new
+* program needs the material again
+*/
+enum DrawStateChange {
+    PROGRAM_CHANGED = 1,
+    MATERIAL_CHANGED = 2,
+    VERTEX_ARRAY_CHANGED = 4
+};
+
+/**
+* Collects the draws of a frame and submits them sorted by a 64-bit key, so
+* that each program, then material, then vertex array is bound once, and the
+* draws sharing all three go front to back for early depth rejection. From
+* the most significant bit the key holds the program, material and vertex
+* array, 12 bits each by the order they were first seen, and the view depth
+* quantized to 28 bits. Keys are sorted by a radix sort of 8 bits a pass,
+* which skips the bytes all keys share.
+*/
+class RenderQueue {
+public:
+    /* Depths from 0 to depthRange ahead of the eye are told apart */
+    explicit RenderQueue(float depthRange = 100.0f);
+
+    /* Empty the queue for draws seen through the view matrix */
+    void begin(const glm::mat4& viewMatrix);
+
+    /* Queue a draw centered at the world space position */
+    void add(const DrawPacket& packet, const glm::vec3& center);
+
+    /**
+    * Sort the draws and count the state changes of both orders. submit()
+    * sorts unless this was called since the last add(), so the order can be
+    * read without a GL context, through sorted().
+    */
+    void sort();
+
+    /* The i-th draw to submit, after sort() */
+    const DrawPacket& sorted(size_t i) const { return packets[entries[i].packet]; }
+
+    /**
+    * Sort the draws, then for each call setup with the packet and which of
+    * its state changed, and bind its vertex array through the state cache
+    * and draw it with instances instances. setup uses the program and
+    * uploads the material and the draw's uniforms.
+    */
+    void submit(GLStateCache* stateCache, int instances,
+                const std::function<void(const DrawPacket&, unsigned changes)>& setup);
+
+    size_t size() const { return packets.size(); }
+
+public:
+    RenderQueueStats submitted;   // in key order
+    RenderQueueStats unsorted;    // had the draws been submitted as added
+
+private:
+    struct SortEntry {
+        uint64_t key;
+        uint32_t packet;
+    };
+    float depthRange;
+    glm::mat4 viewMatrix;
+    std::vector<DrawPacket> packets;
+    std::vector<SortEntry> entries, scratch;
+    bool isSorted;            // entries hold the order of the packets
+    size_t counts[8][256];    // of each byte of the keys
+    // ids of the key, kept across frames so that equal draws sort alike
+    std::unordered_map<const void*, uint32_t> programIds, materialIds, vertexArrayIds;
+
+private:
+    uint32_t stateId(std::unordered_map<const void*, uint32_t>& ids, const void* state);
+    static unsigned changes(const DrawPacket* previous, const DrawPacket& packet);
+    static void count(RenderQueueStats& stats, unsigned changes);
+};
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef RENDERTARGET_H
+#define RENDERTARGET_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+/**
+* An offscreen framebuffer with an RGBA8 color texture and a 24 bit depth
+* texture, both of which can be sampled once rendering is done. Used for
+* headless runs and for passes that render at a resolution other than the
+* window's. A multisampled target keeps its buffers in renderbuffers instead,
+* which are resolved by blitting them to a single sampled framebuffer.
+*/
+class RenderTarget {
+public:
+    GLuint framebuffer, colorTexture, depthTexture;
+    GLuint colorRenderbuffer, depthRenderbuffer;  // multisampled only
+    int width, height, samples;
+
+    RenderTarget(int width, int height, int samples = 0);
+    RenderTarget(const RenderTarget&) = delete;
+    RenderTarget& operator=(const RenderTarget&) = delete;
+    ~RenderTarget();
+
+    /* Render into the target, the viewport covers all of it */
+    void bind();
+
+    /* Render into the bottom left viewportWidth x viewportHeight pixels */
+    void bind(int viewportWidth, int viewportHeight);
+
+    /**
+    * Copy the bottom left source rectangle of the color buffer onto the
+    * destination framebuffer (0 is the window's), scaled to the destination
+    * size. Resolving samples needs equal sizes, scaling a single sampled
+    * target; neither can write into a multisampled destination. The
+    * destination stays bound.
+    */
+    void blit(GLuint destination, int sourceWidth, int sourceHeight,
+              int destinationWidth, int destinationHeight, GLenum filter = GL_NEAREST);
+
+    /* The same between any rectangles, x and y of their bottom left pixels */
+    void blit(GLuint destination, int sourceX, int sourceY, int sourceWidth,
+              int sourceHeight, int destinationX, int destinationY, int destinationWidth,
+              int destinationHeight, GLenum filter = GL_NEAREST);
+
+    /* Render into the default framebuffer again */
+    static void unbind(int windowWidth, int windowHeight);
+
+    /* Read the color buffer back, rows bottom to top, 4 bytes per pixel;
+    * single sampled targets only */
+    void readColor(std::vector<unsigned char>& pixels);
+
+    /* Write the color buffer as a binary .ppm, e.g. for image regressions */
+    void saveColor(const std::string& path);
+
+private:
+    void createMultisampled();
+};
+
+/* Write pixels laid out like readColor() returns them as a binary .ppm */
+void savePPM(const std::string& path, const std::vector<unsigned char>& pixels,
+             int width, int height);
+
+#endif
@@ -0,0 +1,88 @@
+#include <cmath>
+#include <algorithm>
+#include "reprojection.h"
+#include "glstate.h"
+
+using namespace glm;
+using namespace std;
+
+FramePacer::FramePacer(double refreshInterval, double vsyncTime)
+    : refreshInterval(refreshInterval), renderEstimate(0), reprojectionEstimate(0),
+    margin(0.002), renderedFrames(0), reprojectedFrames(0), phase(vsyncTime),
+    lastPresented(vsyncTime - refreshInterval) {
+}
+
+double FramePacer::targetVsync(double now) const {
+    double after = std::max(now, lastPresented + 0.5 * refreshInterval);
+    return phase + (floor((after - phase) / refreshInterval) + 1) * refreshInterval;
+}
+
+FrameDecision FramePacer::decide(double now, bool frameReady) const {
+    double vsync = targetVsync(now);
+    bool renderFits = now + renderEstimate + margin <= vsync;
+    bool reprojectionFits = now + reprojectionEstimate + margin <= vsync;
+    if (frameReady) {
+        // a frame that is late anyway waits for the following vsync, after
+        // this one got a reprojection
+        return renderFits || !reprojectionFits ? FRAME_RENDER : FRAME_REPROJECT;
+    }
+    return renderFits || !reprojectionFits ? FRAME_WAIT : FRAME_REPROJECT;
+}
+
+double FramePacer::nextDecision(double now) const {
+    double vsync = targetVsync(now);
+    double renderDeadline = vsync - renderEstimate - margin;
+    double reprojectionDeadline = vsync - reprojectionEstimate - margin;
+    if (now < renderDeadline) return renderDeadline;
+    if (now < reprojectionDeadline) return reprojectionDeadline;
+    return vsync;
+}
+
+void FramePacer::presented(double vsync, bool reprojected) {
+    lastPresented = vsync;
+    if (reprojected) {
+        reprojectedFrames++;
+    } else {
+        renderedFrames++;
+    }
+}
+
+void FramePacer::synchronize(double vsyncTime) {
+    phase = vsyncTime;
+    lastPresented = vsyncTime;
+}
+
+void FramePacer::renderMeasured(double seconds) {
+    // follow increases at once and decreases slowly, a missed vsync costs
+    // more than an early decision
+    renderEstimate = seconds > renderEstimate ? seconds : mix(renderEstimate, seconds, 0.1);
+}
+
+void FramePacer::reprojectionMeasured(double seconds) {
+    reprojectionEstimate = seconds > reprojectionEstimate ?
+        seconds : mix(reprojectionEstimate, seconds, 0.1);
+}
+
+mat4 rotationReprojection(const mat4& renderedView, const mat4& currentView,
+                          const mat4& projection) {
+    mat4 renderedRotation = mat4(mat3(renderedView));
+    mat4 currentRotation = mat4(mat3(currentView));
+    return projection * renderedRotation * transpose(currentRotation) * inverse(projection);
+}
+
+ReprojectionPass::ReprojectionPass() {
+    glGenVertexArrays(1, &VAO);
+}
+
+ReprojectionPass::~ReprojectionPass() {
+    glDeleteVertexArrays(1, &VAO);
+}
+
+void ReprojectionPass::draw(GLStateCache* stateCache) {
+    if (stateCache) {
+        stateCache->bindVertexArray(VAO);
+    } else {
+        glBindVertexArray(VAO);
+    }
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+}
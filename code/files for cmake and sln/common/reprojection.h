@@ -0,0 +1,87 @@
+#ifndef REPROJECTION_H
+#define REPROJECTION_H
+
+#include <GL/glew.h>
+#include <glm/glm.hpp>
+
+class GLStateCache;
+
+/* What the render thread should do next, see FramePacer::decide() */
+enum FrameDecision {
+    FRAME_WAIT,       // the frame is not ready, but there is still time
+    FRAME_RENDER,     // draw the frame, it makes the target vsync
+    FRAME_REPROJECT   // too late for the target vsync, reproject the last frame
+};
+
+/**
+* Decides per vsync whether a new frame can still be drawn in time or the
+* last frame has to be reprojected to fill the vsync instead. It only does
+* arithmetic on the times it is given, in seconds on any clock, so that it
+* can be driven by a real or an emulated display.
+*/
+class FramePacer {
+public:
+    /* vsyncTime is any past or future vsync, later ones follow every interval */
+    FramePacer(double refreshInterval, double vsyncTime);
+
+    /* The first vsync after now that has not been presented to yet */
+    double targetVsync(double now) const;
+
+    /**
+    * frameReady tells whether everything but the draws of the new frame is
+    * done. Drawing and reprojecting are assumed to take their estimates plus
+    * the margin.
+    */
+    FrameDecision decide(double now, bool frameReady) const;
+
+    /* When decide() may change its mind while the frame is not ready */
+    double nextDecision(double now) const;
+
+    /* A frame or reprojection was presented at the vsync */
+    void presented(double vsync, bool reprojected);
+
+    /* Move the vsync phase to a vsync observed at the time */
+    void synchronize(double vsyncTime);
+
+    /* Measured durations, smoothed into the estimates */
+    void renderMeasured(double seconds);
+    void reprojectionMeasured(double seconds);
+
+public:
+    double refreshInterval;
+    double renderEstimate, reprojectionEstimate, margin;
+    int renderedFrames, reprojectedFrames;
+
+private:
+    double phase;            // a vsync time
+    double lastPresented;    // vsync of the last present
+};
+
+/**
+* Matrix from the clip space of the current view to that of the rendered
+* view, keeping only their rotation. Applied to directions (z = 1 in NDC) it
+* finds where the rendered frame saw what the current view sees, which is
+* right for distant content and head rotation, the main source of judder.
+*/
+glm::mat4 rotationReprojection(const glm::mat4& renderedView, const glm::mat4& currentView,
+                               const glm::mat4& projection);
+
+/**
+* Full screen pass of the Reprojection shaders that resamples the last
+* rendered eyes (side by side in one texture) for the current head rotation.
+*/
+class ReprojectionPass {
+public:
+    ReprojectionPass();
+    ReprojectionPass(const ReprojectionPass&) = delete;
+    ReprojectionPass& operator=(const ReprojectionPass&) = delete;
+    ~ReprojectionPass();
+
+    /* Set eyeTexture, eyeCount and reprojection of the program first */
+    void draw(GLStateCache* stateCache = NULL);
+
+private:
+    GLuint VAO;  // no attributes, the vertices come from gl_VertexID
+};
+
+#endif
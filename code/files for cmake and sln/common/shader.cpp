@@ -6,9 +6,9 @@
 using namespace std;
 
 #include "shader.h"
+#include "profiler.h"
 
-void compileShader(GLuint& shaderID, const char* file) {
-    // read shader code from the file
+std::string readShaderSource(const char* file) {
     std::string shaderCode;
     std::ifstream shaderStream(file, std::ios::in);
     if (shaderStream.is_open()) {
@@ -20,6 +20,22 @@ void compileShader(GLuint& shaderID, const char* file) {
     } else {
         throw runtime_error(string("Can't open shader file: ") + file);
     }
+    return shaderCode;
+}
+
+std::string insertDefines(const std::string& code, const std::string& defines) {
+    if (defines.empty()) return code;
+    // #version must stay the first directive
+    size_t version = code.find("#version");
+    if (version == std::string::npos) return defines + "\n" + code;
+    size_t lineEnd = code.find('\n', version);
+    if (lineEnd == std::string::npos) return code + "\n" + defines;
+    return code.substr(0, lineEnd + 1) + defines + "\n" + code.substr(lineEnd + 1);
+}
+
+void compileShader(GLuint& shaderID, const char* file) {
+    // read shader code from the file
+    std::string shaderCode = readShaderSource(file);
 
     GLint result = GL_FALSE;
     int infoLogLength;
@@ -44,6 +60,7 @@ void compileShader(GLuint& shaderID, const char* file) {
 GLuint loadShaders(const char* vertexFilePath,
                    const char* fragmentFilePath,
                    const char* geometryFilePath) {
+    PROFILE_SCOPE("loadShaders");
     // Create the shaders
     GLuint vertexShaderID = glCreateShader(GL_VERTEX_SHADER);
     compileShader(vertexShaderID, vertexFilePath);
@@ -1,6 +1,14 @@
 #ifndef SHADER_H
 #define SHADER_H
 
+#include <string>
+
+/* Read the GLSL code of a shader file, throws if it can't be opened */
+std::string readShaderSource(const char* file);
+
+/* Insert #define lines after the #version line of GLSL code */
+std::string insertDefines(const std::string& code, const std::string& defines);
+
 GLuint loadShaders(const char* vertexFilePath,
                    const char* fragmentFilePath,
                    const char* geometryFilePath = nullptr);
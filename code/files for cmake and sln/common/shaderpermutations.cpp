@@ -0,0 +1,92 @@
+#include <algorithm>
+#include "shaderpermutations.h"
+#include "shaderprogram.h"
+
+using namespace std;
+
+uint32_t shaderVariant(uint32_t features, int skinInfluences) {
+    if (!(features & SHADER_SKINNING)) {
+        skinInfluences = 1;
+    }
+    skinInfluences = std::min(std::max(skinInfluences, 1), MAX_SKIN_INFLUENCES);
+    return (features & 0xff) | (static_cast<uint32_t>(skinInfluences) << 8);
+}
+
+string shaderVariantDefines(uint32_t variant) {
+    string defines;
+    if (variant & SHADER_SKINNING) {
+        defines += "#define USE_SKINNING\n";
+        defines += "#define SKIN_INFLUENCES " + to_string(variant >> 8) + "\n";
+    }
+    if (variant & SHADER_TEXTURE) {
+        defines += "#define USE_TEXTURE\n";
+    }
+    if (variant & SHADER_SHADOWS) {
+        defines += "#define USE_SHADOWS\n";
+    }
+    if (variant & SHADER_STEREO) {
+        defines += "#define USE_STEREO\n";
+    }
+    if (variant & SHADER_MATERIAL_BUFFER) {
+        defines += "#define USE_MATERIAL_BUFFER\n";
+    }
+    if (variant & SHADER_DRAW_MATRICES) {
+        defines += "#define USE_DRAW_MATRICES\n";
+    }
+    return defines;
+}
+
+ShaderPermutations::ShaderPermutations(const ProgramSource& source, ProgramCache* cache,
+                                       GLStateCache* stateCache)
+    : source(source), cache(cache), stateCache(stateCache) {
+}
+
+ShaderPermutations::~ShaderPermutations() {
+    for (auto& program : programs) {
+        delete program.second;
+    }
+}
+
+void ShaderPermutations::precompile(const vector<uint32_t>& variants) {
+    vector<uint32_t> missing;
+    vector<ProgramSource> sources;
+    for (uint32_t variant : variants) {
+        if (programs.count(variant) ||
+            find(missing.begin(), missing.end(), variant) != missing.end()) {
+            continue;
+        }
+        ProgramSource variantSource = source;
+        variantSource.defines = source.defines + shaderVariantDefines(variant);
+        missing.push_back(variant);
+        sources.push_back(variantSource);
+    }
+    if (sources.empty()) return;
+
+    vector<GLuint> compiled = cache->load(sources);
+    for (size_t i = 0; i < missing.size(); i++) {
+        ShaderProgram* program = new ShaderProgram(compiled[i]);
+        program->stateCache = stateCache;
+        bindBlocks(program);
+        programs[missing[i]] = program;
+    }
+}
+
+ShaderProgram* ShaderPermutations::get(uint32_t variant) {
+    auto it = programs.find(variant);
+    if (it != programs.end()) return it->second;
+    precompile({variant});
+    return programs[variant];
+}
+
+void ShaderPermutations::bindBlock(uint32_t block, GLuint binding) {
+    blockBindings.push_back(make_pair(block, binding));
+    for (auto& program : programs) {
+        program.second->bindBlock(block, binding);
+    }
+}
+
+void ShaderPermutations::bindBlocks(ShaderProgram* program) {
+    for (auto& blockBinding : blockBindings) {
+        program->bindBlock(blockBinding.first, blockBinding.second);
+    }
+}
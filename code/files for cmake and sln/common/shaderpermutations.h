@@ -0,0 +1,71 @@
+#ifndef SHADERPERMUTATIONS_H
+#define SHADERPERMUTATIONS_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include "programcache.h"
+
+class ShaderProgram;
+class GLStateCache;
+
+/* Feature bits of a shader variant, each one is a #define in the shaders */
+enum ShaderFeature {
+    SHADER_SKINNING = 1 << 0,  // USE_SKINNING
+    SHADER_TEXTURE = 1 << 1,   // USE_TEXTURE
+    SHADER_SHADOWS = 1 << 2,   // USE_SHADOWS
+    SHADER_STEREO = 1 << 3,    // USE_STEREO, instanced stereo
+    SHADER_MATERIAL_BUFFER = 1 << 4,  // USE_MATERIAL_BUFFER, materials by index
+    SHADER_DRAW_MATRICES = 1 << 5     // USE_DRAW_MATRICES, model matrices by vertex
+};
+
+const int MAX_SKIN_INFLUENCES = 4;
+
+/**
+* Key of a variant: the feature bits in the low byte and, for skinning, the
+* bone influences per vertex (SKIN_INFLUENCES, 1 to MAX_SKIN_INFLUENCES) above.
+*/
+uint32_t shaderVariant(uint32_t features, int skinInfluences = 1);
+
+/* The #define lines of a variant */
+std::string shaderVariantDefines(uint32_t variant);
+
+/**
+* Variants of one program compiled from its sources with different feature
+* defines, so that each variant contains only the code paths it uses instead
+* of branching on uniforms. Variants are compiled on first use, or ahead of
+* time as one batch, through the program cache, and looked up by key.
+*/
+class ShaderPermutations {
+public:
+    /* The cache must outlive the permutations */
+    ShaderPermutations(const ProgramSource& source, ProgramCache* cache,
+                       GLStateCache* stateCache = NULL);
+
+    /* Deletes the variants */
+    ~ShaderPermutations();
+
+    /* Compile the variants that are not yet compiled, as one batch */
+    void precompile(const std::vector<uint32_t>& variants);
+
+    /* The variant, compiled now if it was not precompiled */
+    ShaderProgram* get(uint32_t variant);
+
+    int variantCount() const { return static_cast<int>(programs.size()); }
+
+    /* Bind a uniform block of every variant, including those compiled later */
+    void bindBlock(uint32_t block, GLuint binding);
+
+private:
+    void bindBlocks(ShaderProgram* program);
+
+    ProgramSource source;
+    ProgramCache* cache;
+    GLStateCache* stateCache;
+    std::vector<std::pair<uint32_t, GLuint> > blockBindings;
+    std::unordered_map<uint32_t, ShaderProgram*> programs;
+};
+
+#endif
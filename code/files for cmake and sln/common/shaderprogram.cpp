@@ -0,0 +1,165 @@
+#include <algorithm>
+#include <stdexcept>
+#include "shaderprogram.h"
+#include "shader.h"
+#include "glstate.h"
+
+using namespace glm;
+using namespace std;
+
+ShaderProgram::ShaderProgram(const char* vertexFilePath,
+                             const char* fragmentFilePath,
+                             const char* geometryFilePath)
+    : program(loadShaders(vertexFilePath, fragmentFilePath, geometryFilePath)),
+    stateCache(NULL) {
+    reflect();
+}
+
+ShaderProgram::ShaderProgram(GLuint program) : program(program), stateCache(NULL) {
+    reflect();
+}
+
+ShaderProgram::~ShaderProgram() {
+    glDeleteProgram(program);
+}
+
+template <typename T>
+static void sortByHash(vector<T>& table, const char* kind) {
+    sort(table.begin(), table.end(), [](const T& a, const T& b) {
+        return a.nameHash < b.nameHash;
+    });
+    for (size_t i = 1; i < table.size(); i++) {
+        if (table[i].nameHash == table[i - 1].nameHash) {
+            throw runtime_error(string("Hash collision between ") + kind + " " +
+                                table[i - 1].name + " and " + table[i].name);
+        }
+    }
+}
+
+void ShaderProgram::reflect() {
+    uniforms.clear();
+    blocks.clear();
+
+    GLint count = 0, maxLength = 0;
+    glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxLength);
+    vector<char> name(std::max<GLint>(maxLength, 1));
+    for (GLint i = 0; i < count; i++) {
+        UniformInfo info;
+        GLsizei length = 0;
+        glGetActiveUniform(program, i, static_cast<GLsizei>(name.size()), &length,
+                           &info.size, &info.type, &name[0]);
+        info.name.assign(&name[0], length);
+        // uniforms of blocks have no location, they are set through buffers
+        info.location = glGetUniformLocation(program, info.name.c_str());
+        if (info.location < 0) continue;
+        // arrays are reported as "name[0]", they are looked up by plain name
+        if (info.name.size() > 3 && info.name.compare(info.name.size() - 3, 3, "[0]") == 0) {
+            info.name.resize(info.name.size() - 3);
+        }
+        info.nameHash = uniformHash(info.name.c_str());
+        uniforms.push_back(info);
+    }
+    sortByHash(uniforms, "uniforms");
+
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+    glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCK_MAX_NAME_LENGTH, &maxLength);
+    name.resize(std::max<GLint>(maxLength, 1));
+    for (GLint i = 0; i < count; i++) {
+        UniformBlockInfo info;
+        GLsizei length = 0;
+        glGetActiveUniformBlockName(program, i, static_cast<GLsizei>(name.size()),
+                                    &length, &name[0]);
+        info.name.assign(&name[0], length);
+        info.index = i;
+        glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &info.dataSize);
+        info.nameHash = uniformHash(info.name.c_str());
+        blocks.push_back(info);
+    }
+    sortByHash(blocks, "uniform blocks");
+}
+
+const UniformInfo* ShaderProgram::find(uint32_t hash) const {
+    auto it = lower_bound(uniforms.begin(), uniforms.end(), hash,
+                          [](const UniformInfo& u, uint32_t h) { return u.nameHash < h; });
+    return it != uniforms.end() && it->nameHash == hash ? &*it : NULL;
+}
+
+GLint ShaderProgram::location(uint32_t hash) const {
+    const UniformInfo* info = find(hash);
+    return info ? info->location : -1;
+}
+
+GLuint ShaderProgram::blockIndex(uint32_t hash) const {
+    auto it = lower_bound(blocks.begin(), blocks.end(), hash,
+                          [](const UniformBlockInfo& b, uint32_t h) { return b.nameHash < h; });
+    return it != blocks.end() && it->nameHash == hash ? it->index : GL_INVALID_INDEX;
+}
+
+void ShaderProgram::bindBlock(uint32_t hash, GLuint binding) {
+    GLuint index = blockIndex(hash);
+    if (index != GL_INVALID_INDEX) {
+        glUniformBlockBinding(program, index, binding);
+    }
+}
+
+void ShaderProgram::use() {
+    if (stateCache) {
+        stateCache->useProgram(program);
+    } else {
+        glUseProgram(program);
+    }
+}
+
+void ShaderProgram::setInt(uint32_t hash, int value) {
+    GLint loc = location(hash);
+    if (stateCache) {
+        stateCache->uniform1i(loc, value);
+    } else if (loc >= 0) {
+        glUniform1i(loc, value);
+    }
+}
+
+void ShaderProgram::setFloat(uint32_t hash, float value) {
+    GLint loc = location(hash);
+    if (stateCache) {
+        stateCache->uniform1f(loc, value);
+    } else if (loc >= 0) {
+        glUniform1f(loc, value);
+    }
+}
+
+void ShaderProgram::setVec3(uint32_t hash, const vec3& value) {
+    GLint loc = location(hash);
+    if (stateCache) {
+        stateCache->uniform3f(loc, value);
+    } else if (loc >= 0) {
+        glUniform3fv(loc, 1, &value[0]);
+    }
+}
+
+void ShaderProgram::setVec4(uint32_t hash, const vec4& value) {
+    GLint loc = location(hash);
+    if (stateCache) {
+        stateCache->uniform4f(loc, value);
+    } else if (loc >= 0) {
+        glUniform4fv(loc, 1, &value[0]);
+    }
+}
+
+void ShaderProgram::setMat4(uint32_t hash, const mat4& value) {
+    setMat4Array(hash, 1, &value);
+}
+
+void ShaderProgram::setMat4Array(uint32_t hash, int count, const mat4* values) {
+    const UniformInfo* info = find(hash);
+    if (info == NULL) return;
+    // GL ignores values past the end of an array but rejects count > 1 for
+    // non-arrays, clamping also keeps the shadow copies in the cache exact
+    count = std::min(count, info->size);
+    if (stateCache) {
+        stateCache->uniformMatrix4fv(info->location, count, values);
+    } else {
+        glUniformMatrix4fv(info->location, count, GL_FALSE, &values[0][0][0]);
+    }
+}
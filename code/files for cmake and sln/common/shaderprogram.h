@@ -0,0 +1,91 @@
+#ifndef SHADERPROGRAM_H
+#define SHADERPROGRAM_H
+
+#include <GL/glew.h>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <type_traits>
+#include <glm/glm.hpp>
+
+class GLStateCache;
+
+/* 32-bit FNV-1a hash of a uniform name, evaluated at compile time for literals */
+constexpr uint32_t uniformHash(const char* name, uint32_t hash = 2166136261u) {
+    return *name ? uniformHash(name + 1, (hash ^ static_cast<uint8_t>(*name)) * 16777619u)
+        : hash;
+}
+
+/* Forces compile time evaluation, e.g. program->setMat4(UNIFORM("M"), model) */
+#define UNIFORM(name) std::integral_constant<uint32_t, uniformHash(name)>::value
+
+/* An active uniform of a linked program; arrays are named without "[0]" */
+struct UniformInfo {
+    uint32_t nameHash;
+    GLint location;
+    GLenum type;
+    GLint size;  // number of array elements
+    std::string name;
+};
+
+struct UniformBlockInfo {
+    uint32_t nameHash;
+    GLuint index;
+    GLint dataSize;  // bytes
+    std::string name;
+};
+
+/**
+* A linked program whose active uniforms and uniform blocks are reflected once
+* at link time into tables sorted by name hash. Lookups never call GL, and the
+* setters go through the state cache when one is set, so they only reach the
+* driver when a value changes. Setters expect the program to be in use and
+* ignore names that the compiler optimized out, like glUniform* with -1.
+*/
+class ShaderProgram {
+public:
+    ShaderProgram(const char* vertexFilePath,
+                  const char* fragmentFilePath,
+                  const char* geometryFilePath = nullptr);
+
+    /* Takes ownership of an already linked program */
+    explicit ShaderProgram(GLuint program);
+
+    ShaderProgram(const ShaderProgram&) = delete;
+    ShaderProgram& operator=(const ShaderProgram&) = delete;
+    ~ShaderProgram();
+
+    void use();
+
+    /* -1 if the uniform is not active */
+    GLint location(uint32_t hash) const;
+    GLint location(const std::string& name) const { return location(uniformHash(name.c_str())); }
+
+    /* GL_INVALID_INDEX if the block is not active */
+    GLuint blockIndex(uint32_t hash) const;
+    void bindBlock(uint32_t hash, GLuint binding);
+
+    void setInt(uint32_t hash, int value);
+    void setFloat(uint32_t hash, float value);
+    void setVec3(uint32_t hash, const glm::vec3& value);
+    void setVec4(uint32_t hash, const glm::vec4& value);
+    void setMat4(uint32_t hash, const glm::mat4& value);
+    void setMat4Array(uint32_t hash, int count, const glm::mat4* values);
+
+    const std::vector<UniformInfo>& getUniforms() const { return uniforms; }
+    const std::vector<UniformBlockInfo>& getUniformBlocks() const { return blocks; }
+
+public:
+    GLuint program;
+    GLStateCache* stateCache;  // NULL to call GL directly
+
+private:
+    std::vector<UniformInfo> uniforms;
+    std::vector<UniformBlockInfo> blocks;
+
+private:
+    void reflect();
+    const UniformInfo* find(uint32_t hash) const;
+};
+
+#endif
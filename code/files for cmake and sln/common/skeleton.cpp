@@ -1,5 +1,12 @@
+#include <algorithm>
 #include "skeleton.h"
 #include "model.h"
+#include "glstate.h"
+#include "shaderprogram.h"
+#include "profiler.h"
+#include "occlusion.h"
+#include "renderqueue.h"
+#include "skeletonbatch.h"
 #include <glm/gtc/matrix_transform.hpp>
 
 void Joint::updateWorldTransformation() {
@@ -22,17 +29,29 @@ void Body::draw(
     const GLuint& modelMatrixLocation,
     const GLuint& viewMatrixLocation,
     const GLuint& projectionMatrixLocation,
-    const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
+    const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix,
+    GLStateCache* stateCache, int instances, const unsigned char* visible) {
     joint->updateWorldTransformation();
-    glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE,
-                       &joint->jointWorldTransformation[0][0]);
-    glUniformMatrix4fv(viewMatrixLocation, 1, GL_FALSE, &viewMatrix[0][0]);
-    glUniformMatrix4fv(projectionMatrixLocation, 1, GL_FALSE,
-                       &projectionMatrix[0][0]);
+    if (visible && std::find(visible, visible + drawables.size(), 1) ==
+        visible + drawables.size()) {
+        return;
+    }
+    if (stateCache) {
+        stateCache->uniformMatrix4fv(modelMatrixLocation, joint->jointWorldTransformation);
+        stateCache->uniformMatrix4fv(viewMatrixLocation, viewMatrix);
+        stateCache->uniformMatrix4fv(projectionMatrixLocation, projectionMatrix);
+    } else {
+        glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE,
+                           &joint->jointWorldTransformation[0][0]);
+        glUniformMatrix4fv(viewMatrixLocation, 1, GL_FALSE, &viewMatrix[0][0]);
+        glUniformMatrix4fv(projectionMatrixLocation, 1, GL_FALSE,
+                           &projectionMatrix[0][0]);
+    }
 
-    for (Drawable* d : drawables) {
-        d->bind();
-        d->draw();
+    for (size_t i = 0; i < drawables.size(); i++) {
+        if (visible && !visible[i]) continue;
+        drawables[i]->bind(stateCache);
+        drawables[i]->draw(GL_TRIANGLES, instances);
     }
 }
 
@@ -42,10 +61,19 @@ Skeleton::Skeleton(
     GLuint projectionMatrixLocation) :
     modelMatrixLocation(modelMatrixLocation),
     viewMatrixLocation(viewMatrixLocation),
-    projectionMatrixLocation(projectionMatrixLocation) {
+    projectionMatrixLocation(projectionMatrixLocation),
+    stateCache(NULL), instanceCount(1), batch(NULL) {
+}
+
+Skeleton::Skeleton(const ShaderProgram& program) :
+    modelMatrixLocation(program.location(UNIFORM("M"))),
+    viewMatrixLocation(program.location(UNIFORM("V"))),
+    projectionMatrixLocation(program.location(UNIFORM("P"))),
+    stateCache(program.stateCache), instanceCount(1), batch(NULL) {
 }
 
 Skeleton::~Skeleton() {
+    delete batch;
     for (auto body : bodies) {
         delete body.second;
     }
@@ -61,11 +89,98 @@ void Skeleton::setPose(const std::map<int, glm::mat4>& jointTransformations) {
     }
 }
 
-void Skeleton::draw(const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix) {
+void Skeleton::draw(const glm::mat4 & viewMatrix, const glm::mat4 & projectionMatrix,
+                    const Frustum* frustum, const OcclusionCuller* occlusion) {
+    PROFILE_SCOPE("Skeleton::draw");
+    PROFILE_GPU_SCOPE("Skeleton::draw");
+    const unsigned char* visible = cull(frustum, occlusion);
+    if (batch) {
+        batch->draw(*this, visible, instanceCount, stateCache);
+        return;
+    }
     for (auto& body : bodies) {
         body.second->draw(modelMatrixLocation, viewMatrixLocation,
-                          projectionMatrixLocation, viewMatrix, projectionMatrix);
+                          projectionMatrixLocation, viewMatrix, projectionMatrix,
+                          stateCache, instanceCount, visible);
+        if (visible) {
+            visible += body.second->drawables.size();
+        }
+    }
+}
+
+void Skeleton::enqueue(RenderQueue& queue, ShaderProgram* program, const void* material,
+                       GLenum polygonMode, const Frustum* frustum,
+                       const OcclusionCuller* occlusion) {
+    const unsigned char* visible = cull(frustum, occlusion);
+    for (auto& body : bodies) {
+        const glm::mat4& model = body.second->joint->jointWorldTransformation;
+        for (Drawable* d : body.second->drawables) {
+            if (visible && !*visible++) continue;
+            DrawPacket packet = {0, program, material, polygonMode, d->VAO,
+                                 static_cast<GLsizei>(d->indices.size()), &model, -1};
+            queue.add(packet, glm::vec3(model * glm::vec4(d->sphereBounds.center, 1.0f)));
+        }
+    }
+}
+
+const unsigned char* Skeleton::cull(const Frustum* frustum, const OcclusionCuller* occlusion) {
+    if (frustum == NULL) {
+        // bodies come parent first, so their joints update in order
+        for (auto& body : bodies) {
+            body.second->joint->updateWorldTransformation();
+        }
+        return NULL;
+    }
+    // the spheres of all drawables are tested at once, the boxes of
+    // those that pass; bodies come in the same parent first order as
+    // when drawing, so the joints are up to date
+    drawableBounds.clear();
+    for (auto& body : bodies) {
+        body.second->joint->updateWorldTransformation();
+        for (Drawable* d : body.second->drawables) {
+            drawableBounds.push_back(transformBounds(
+                d->sphereBounds, body.second->joint->jointWorldTransformation));
+        }
+    }
+    drawableVisible.resize(drawableBounds.size());
+    if (!drawableBounds.empty()) {
+        frustum->intersects(&drawableBounds[0], static_cast<int>(drawableBounds.size()),
+                            &drawableVisible[0]);
+    }
+    size_t i = 0;
+    for (auto& body : bodies) {
+        for (Drawable* d : body.second->drawables) {
+            if (drawableVisible[i]) {
+                BoundingBox box = transformBounds(
+                    d->boxBounds, body.second->joint->jointWorldTransformation);
+                drawableVisible[i] = frustum->intersects(box) &&
+                    (occlusion == NULL || occlusion->visible(box));
+            }
+            if (drawableVisible[i++]) {
+                culling.visible++;
+            } else {
+                culling.culled++;
+            }
+        }
+    }
+    return drawableVisible.empty() ? NULL : &drawableVisible[0];
+}
+
+Skeleton* Skeleton::cloneJoints() const {
+    Skeleton* copy = new Skeleton(modelMatrixLocation, viewMatrixLocation,
+                                  projectionMatrixLocation);
+    std::map<const Joint*, Joint*> copies;
+    for (const auto& joint : joints) {
+        Joint* jointCopy = new Joint(*joint.second);
+        copies[joint.second] = jointCopy;
+        copy->joints[joint.first] = jointCopy;
+    }
+    for (auto& joint : copy->joints) {
+        if (joint.second->parent) {
+            joint.second->parent = copies[joint.second->parent];
+        }
     }
+    return copy;
 }
 
 std::map<int, glm::mat4> Skeleton::getJointWorldTransformations() {
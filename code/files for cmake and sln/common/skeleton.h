@@ -5,6 +5,14 @@
 #include <vector>
 #include <map>
 #include <glm/glm.hpp>
+#include "frustum.h"
+
+class OcclusionCuller;
+class RenderQueue;
+class SkeletonBatch;
+
+class GLStateCache;
+class ShaderProgram;
 
 class Drawable;
 
@@ -26,12 +34,17 @@ struct Body {
     /* Free all drawables (a body can have many drawables)*/
     ~Body();
 
-    /* Given the view and projection matrix draw every attached drawables */
+    /**
+    * Given the view and projection matrix draw every attached drawables, or
+    * those whose entry in visible (one per drawable) is set
+    */
     void draw(
         const GLuint& modelMatrixLocation,
         const GLuint& viewMatrixLocation,
         const GLuint& projectionMatrixLocation,
-        const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+        const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+        GLStateCache* stateCache = NULL, int instances = 1,
+        const unsigned char* visible = NULL);
 };
 
 struct Skeleton {
@@ -41,22 +54,66 @@ struct Skeleton {
     // shader locations to M, V, P
     GLuint modelMatrixLocation, viewMatrixLocation, projectionMatrixLocation;
 
+    // when set, draws skip the uniforms and bindings that did not change
+    GLStateCache* stateCache;
+
+    // instances of every draw, e.g. 2 for instanced stereo
+    int instanceCount;
+
+    // drawables drawn and culled by draw() with a frustum
+    CullingStats culling;
+
+    // when set, draw() submits the drawables through it, owned
+    SkeletonBatch* batch;
+
     Skeleton(
         GLuint modelMatrixLocation,
         GLuint viewMatrixLocation,
         GLuint projectionMatrixLocation);
 
+    /* Takes the locations of the "M", "V" and "P" uniforms of the program */
+    Skeleton(const ShaderProgram& program);
+
     /* Free all bodies and joints*/
     ~Skeleton();
 
     /* Update joint local coordinates */
     void setPose(const std::map<int, glm::mat4>& jointTransformations);
 
-    /* Given the view and projection matrix draw every attached drawables */
-    void draw(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix);
+    /**
+    * Given the view and projection matrix draw every attached drawables.
+    * With a frustum, drawables whose bounds moved by their joint are outside
+    * of it, or hidden behind the occluders if given, are skipped before any
+    * GL call.
+    */
+    void draw(const glm::mat4& viewMatrix, const glm::mat4& projectionMatrix,
+              const Frustum* frustum = NULL, const OcclusionCuller* occlusion = NULL);
+
+    /**
+    * Like draw(), but queues the drawables that pass the culling with the
+    * program, material and polygon mode instead of drawing them
+    */
+    void enqueue(RenderQueue& queue, ShaderProgram* program, const void* material,
+                 GLenum polygonMode, const Frustum* frustum = NULL,
+                 const OcclusionCuller* occlusion = NULL);
+
+    /**
+    * A skeleton with copies of the joints and no bodies, e.g. to compute
+    * poses on another thread than the one drawing this skeleton
+    */
+    Skeleton* cloneJoints() const;
 
     /* Get joint world transformations after setting the pose */
     std::map<int, glm::mat4> getJointWorldTransformations();
+
+private:
+    // per drawable in body order, reused by draw()
+    std::vector<BoundingSphere> drawableBounds;
+    std::vector<unsigned char> drawableVisible;
+
+private:
+    /* Updates the joints, the visibility per drawable or NULL for all */
+    const unsigned char* cull(const Frustum* frustum, const OcclusionCuller* occlusion);
 };
 
 #endif
\ No newline at end of file
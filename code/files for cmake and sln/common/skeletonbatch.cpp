@@ -0,0 +1,163 @@
+#include "skeletonbatch.h"
+#include "skeleton.h"
+#include "model.h"
+#include "glstate.h"
+#include "profiler.h"
+
+using namespace glm;
+using namespace std;
+
+// per indirect draw: count, instance count, first index, base vertex, base instance
+const int INDIRECT_COMMAND_SIZE = 5;
+
+SkeletonBatch::SkeletonBatch(const Skeleton& skeleton, GLuint textureUnit)
+    : textureUnit(textureUnit), drawCalls(0) {
+    indirect = GLEW_VERSION_4_3 || GLEW_ARB_multi_draw_indirect;
+
+    // indices are offset by the vertices before them, so that adjacent
+    // drawables are one range of the element buffer
+    vector<vec3> vertices, normals;
+    vector<vec2> uvs;
+    vector<float> matrixIndices;
+    vector<unsigned int> indices;
+    float body = 0.0f;
+    for (const auto& entry : skeleton.bodies) {
+        for (const Drawable* d : entry.second->drawables) {
+            unsigned int baseVertex = static_cast<unsigned int>(vertices.size());
+            Range range = {static_cast<GLuint>(indices.size()),
+                           static_cast<GLsizei>(d->indices.size())};
+            drawables.push_back(range);
+            for (unsigned int index : d->indices) {
+                indices.push_back(baseVertex + index);
+            }
+            vertices.insert(vertices.end(), d->indexedVertices.begin(), d->indexedVertices.end());
+            // drawables without normals or uvs get zeros, as unset attributes
+            normals.insert(normals.end(), d->indexedNormals.begin(), d->indexedNormals.end());
+            normals.resize(vertices.size());
+            uvs.insert(uvs.end(), d->indexedUVS.begin(), d->indexedUVS.end());
+            uvs.resize(vertices.size());
+            matrixIndices.resize(vertices.size(), body);
+        }
+        body += 1.0f;
+    }
+
+    auto arrayBuffer = [](GLuint& vbo, GLuint location, GLint size, GLsizeiptr bytes,
+                          const void* data) {
+        glGenBuffers(1, &vbo);
+        glBindBuffer(GL_ARRAY_BUFFER, vbo);
+        glBufferData(GL_ARRAY_BUFFER, bytes, data, GL_STATIC_DRAW);
+        glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, 0, NULL);
+        glEnableVertexAttribArray(location);
+    };
+    glGenVertexArrays(1, &vertexArray);
+    glBindVertexArray(vertexArray);
+    arrayBuffer(verticesVBO, 0, 3, vertices.size() * sizeof(vec3), vertices.data());
+    arrayBuffer(normalsVBO, 1, 3, normals.size() * sizeof(vec3), normals.data());
+    arrayBuffer(uvsVBO, 2, 2, uvs.size() * sizeof(vec2), uvs.data());
+    arrayBuffer(matrixIndicesVBO, 5, 1, matrixIndices.size() * sizeof(float),
+                matrixIndices.data());
+    glGenBuffers(1, &elementVBO);
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, elementVBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(unsigned int),
+                 indices.data(), GL_STATIC_DRAW);
+    glBindVertexArray(0);
+
+    // a buffer name is only an object once bound, which glTexBuffer needs
+    glGenBuffers(1, &matrixBuffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, matrixBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, skeleton.bodies.size() * sizeof(mat4), NULL, GL_STREAM_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    glGenTextures(1, &matrixTexture);
+    glBindTexture(GL_TEXTURE_BUFFER, matrixTexture);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, matrixBuffer);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
+    commandBuffer = 0;
+    if (indirect) {
+        glGenBuffers(1, &commandBuffer);
+    }
+}
+
+SkeletonBatch::~SkeletonBatch() {
+    glDeleteBuffers(1, &verticesVBO);
+    glDeleteBuffers(1, &normalsVBO);
+    glDeleteBuffers(1, &uvsVBO);
+    glDeleteBuffers(1, &matrixIndicesVBO);
+    glDeleteBuffers(1, &elementVBO);
+    glDeleteVertexArrays(1, &vertexArray);
+    glDeleteTextures(1, &matrixTexture);
+    glDeleteBuffers(1, &matrixBuffer);
+    glDeleteBuffers(1, &commandBuffer);
+}
+
+void SkeletonBatch::draw(const Skeleton& skeleton, const unsigned char* visible, int instances,
+                         GLStateCache* stateCache) {
+    PROFILE_SCOPE("SkeletonBatch::draw");
+    // the visible drawables as ranges of the element buffer
+    counts.clear();
+    offsets.clear();
+    for (size_t i = 0; i < drawables.size(); i++) {
+        if (visible && !visible[i]) continue;
+        const GLvoid* offset = reinterpret_cast<const GLvoid*>(
+            static_cast<uintptr_t>(drawables[i].firstIndex * sizeof(unsigned int)));
+        if (!counts.empty() && i > 0 && (visible == NULL || visible[i - 1])) {
+            counts.back() += drawables[i].indexCount;
+        } else {
+            counts.push_back(drawables[i].indexCount);
+            offsets.push_back(offset);
+        }
+    }
+    if (counts.empty()) return;
+
+    // the old storage is orphaned, frames in flight keep their matrices
+    matrices.clear();
+    for (const auto& entry : skeleton.bodies) {
+        matrices.push_back(entry.second->joint->jointWorldTransformation);
+    }
+    glBindBuffer(GL_TEXTURE_BUFFER, matrixBuffer);
+    glBufferData(GL_TEXTURE_BUFFER, matrices.size() * sizeof(mat4), NULL, GL_STREAM_DRAW);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, matrices.size() * sizeof(mat4), &matrices[0]);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+    if (stateCache) {
+        stateCache->bindTexture(textureUnit, GL_TEXTURE_BUFFER, matrixTexture);
+        stateCache->bindVertexArray(vertexArray);
+    } else {
+        glActiveTexture(GL_TEXTURE0 + textureUnit);
+        glBindTexture(GL_TEXTURE_BUFFER, matrixTexture);
+        glBindVertexArray(vertexArray);
+    }
+
+    GLsizei drawCount = static_cast<GLsizei>(counts.size());
+    if (drawCount == 1) {
+        if (instances > 1) {
+            glDrawElementsInstanced(GL_TRIANGLES, counts[0], GL_UNSIGNED_INT, offsets[0],
+                                    instances);
+        } else {
+            glDrawElements(GL_TRIANGLES, counts[0], GL_UNSIGNED_INT, offsets[0]);
+        }
+        drawCalls++;
+    } else if (indirect) {
+        commands.clear();
+        for (GLsizei i = 0; i < drawCount; i++) {
+            GLuint command[INDIRECT_COMMAND_SIZE] = {
+                static_cast<GLuint>(counts[i]), static_cast<GLuint>(instances),
+                static_cast<GLuint>(reinterpret_cast<uintptr_t>(offsets[i]) /
+                                    sizeof(unsigned int)), 0, 0};
+            commands.insert(commands.end(), command, command + INDIRECT_COMMAND_SIZE);
+        }
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, commandBuffer);
+        glBufferData(GL_DRAW_INDIRECT_BUFFER, commands.size() * sizeof(GLuint), &commands[0],
+                     GL_STREAM_DRAW);
+        glMultiDrawElementsIndirect(GL_TRIANGLES, GL_UNSIGNED_INT, NULL, drawCount, 0);
+        glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+        drawCalls++;
+    } else if (instances > 1) {
+        for (GLsizei i = 0; i < drawCount; i++) {
+            glDrawElementsInstanced(GL_TRIANGLES, counts[i], GL_UNSIGNED_INT, offsets[i],
+                                    instances);
+        }
+        drawCalls += drawCount;
+    } else {
+        glMultiDrawElements(GL_TRIANGLES, &counts[0], GL_UNSIGNED_INT, &offsets[0], drawCount);
+        drawCalls++;
+    }
+}
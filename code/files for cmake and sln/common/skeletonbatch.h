@@ -0,0 +1,59 @@
+#ifndef SKELETONBATCH_H
+#define SKELETONBATCH_H
+
+#include <GL/glew.h>
+#include <vector>
+#include <glm/glm.hpp>
+
+struct Skeleton;
+class GLStateCache;
+
+/**
+* The drawables of a skeleton's bodies merged into one vertex array, drawn
+* together with the programs compiled with USE_DRAW_MATRICES. Every vertex
+* holds the index of its body, whose model matrix the vertex shader reads
+* from a texture buffer written once per frame, so no uniform changes
+* between the drawables. The visible drawables that are adjacent in the
+* merged buffers are one draw, all of them a single draw; several go out
+* through glMultiDrawElementsIndirect where supported, else through
+* glMultiDrawElements (instanced draws one at a time, which it has no
+* instance count for).
+*/
+class SkeletonBatch {
+public:
+    /* The bodies and their drawables must not change afterwards */
+    SkeletonBatch(const Skeleton& skeleton, GLuint textureUnit = 2);
+    SkeletonBatch(const SkeletonBatch&) = delete;
+    SkeletonBatch& operator=(const SkeletonBatch&) = delete;
+    ~SkeletonBatch();
+
+    /**
+    * Draw the drawables whose entry in visible (one per drawable in body
+    * order) is set, or all without it, with the joints' world
+    * transformations. The program must be in use and its "modelMatrices"
+    * sampler set to the texture unit.
+    */
+    void draw(const Skeleton& skeleton, const unsigned char* visible, int instances,
+              GLStateCache* stateCache = NULL);
+
+public:
+    GLuint textureUnit;
+    bool indirect;      // glMultiDrawElementsIndirect is supported
+    long drawCalls;     // issued by draw(), counting a multi-draw once
+
+private:
+    struct Range {
+        GLuint firstIndex;
+        GLsizei indexCount;
+    };
+    GLuint vertexArray, verticesVBO, normalsVBO, uvsVBO, matrixIndicesVBO, elementVBO;
+    GLuint matrixBuffer, matrixTexture, commandBuffer;
+    std::vector<Range> drawables;   // in body order
+    // of the frame
+    std::vector<glm::mat4> matrices;
+    std::vector<GLsizei> counts;
+    std::vector<const GLvoid*> offsets;
+    std::vector<GLuint> commands;   // five per indirect draw
+};
+
+#endif
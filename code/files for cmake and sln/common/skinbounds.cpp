@@ -0,0 +1,51 @@
+#include <map>
+#include "skinbounds.h"
+
+using namespace glm;
+using namespace std;
+
+SkinBounds::SkinBounds(const vector<vec3>& vertices, const vector<float>& boneIndices) {
+    map<int, vector<vec3> > parts;
+    // vertices without a bone are not skinned, part -1
+    for (size_t i = 0; i < vertices.size(); i++) {
+        int bone = i < boneIndices.size() ? static_cast<int>(boneIndices[i]) : -1;
+        parts[bone].push_back(vertices[i]);
+    }
+    for (const auto& part : parts) {
+        bones.push_back(part.first);
+        spheres.push_back(boundingSphere(part.second));
+        boxes.push_back(boundingBox(part.second));
+    }
+}
+
+bool SkinBounds::visible(const Frustum& frustum, const vector<mat4>& palette,
+                         const mat4& modelMatrix, CullingStats* stats) {
+    int parts = static_cast<int>(bones.size());
+    posedSpheres.resize(parts);
+    partVisible.resize(parts);
+    for (int i = 0; i < parts; i++) {
+        posedSpheres[i] = transformBounds(spheres[i], partTransformation(i, palette, modelMatrix));
+    }
+    bool anyVisible = false;
+    if (parts > 0 && frustum.intersects(&posedSpheres[0], parts, &partVisible[0]) > 0) {
+        for (int i = 0; i < parts && !anyVisible; i++) {
+            if (!partVisible[i]) continue;
+            anyVisible = frustum.intersects(
+                transformBounds(boxes[i], partTransformation(i, palette, modelMatrix)));
+        }
+    }
+    if (stats) {
+        if (anyVisible) {
+            stats->visible++;
+        } else {
+            stats->culled++;
+        }
+    }
+    return anyVisible;
+}
+
+mat4 SkinBounds::partTransformation(int part, const vector<mat4>& palette,
+                                    const mat4& modelMatrix) const {
+    return bones[part] >= 0 && bones[part] < static_cast<int>(palette.size()) ?
+        modelMatrix * palette[bones[part]] : modelMatrix;
+}
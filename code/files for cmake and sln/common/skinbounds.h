@@ -0,0 +1,46 @@
+#ifndef SKINBOUNDS_H
+#define SKINBOUNDS_H
+
+#include <vector>
+#include <glm/glm.hpp>
+#include "frustum.h"
+
+/**
+* Bounds of the parts of a skin that follow one bone each, in the bind pose.
+* Moved by the skinning transformations of a pose they bound the posed skin
+* of single influence (rigid) skinning exactly, unlike one volume grown to
+* hold every pose, so that e.g. a close up view of one finger does not pay
+* for the whole hand being in view.
+*/
+class SkinBounds {
+public:
+    /**
+    * boneIndices holds the bone of each vertex, as the skinning attribute;
+    * vertices past its end are not skinned
+    */
+    SkinBounds(const std::vector<glm::vec3>& vertices, const std::vector<float>& boneIndices);
+
+    /**
+    * Whether any part is in the frustum with the skinning palette (indexed
+    * by bone, empty for the bind pose) and then the model transformation
+    * applied. The spheres are tested at once, the boxes of those that pass
+    * until one is visible. The decision is counted in stats if given.
+    */
+    bool visible(const Frustum& frustum, const std::vector<glm::mat4>& palette,
+                 const glm::mat4& modelMatrix, CullingStats* stats = NULL);
+
+    /* Moves the bind pose of the part as visible() does */
+    glm::mat4 partTransformation(int part, const std::vector<glm::mat4>& palette,
+                                 const glm::mat4& modelMatrix) const;
+
+public:
+    std::vector<int> bones;                // bone of each part
+    std::vector<BoundingSphere> spheres;   // per part, bind pose
+    std::vector<BoundingBox> boxes;
+
+private:
+    std::vector<BoundingSphere> posedSpheres;
+    std::vector<unsigned char> partVisible;
+};
+
+#endif
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <iostream>
 #include "texture.h"
+#include "profiler.h"
 using namespace std;
 
 GLuint loadBMP(const char* imagePath) {
@@ -214,6 +215,7 @@ GLuint loadDDS(const char* imagePath) {
 }
 
 GLuint loadSOIL(const char* imagePath) {
+    PROFILE_SCOPE("loadSOIL");
     cout << "Reading image: " << imagePath << endl;
 
     GLuint texture = 0;
@@ -0,0 +1,82 @@
+#include <SOIL.h>
+#include <stdexcept>
+#include "texturearray.h"
+#include "profiler.h"
+
+using namespace std;
+
+TextureArrays::~TextureArrays() {
+    // groups are made on the CPU, their textures only by create()
+    for (const Group& group : groups) {
+        if (group.texture) glDeleteTextures(1, &group.texture);
+    }
+}
+
+TextureLayer TextureArrays::add(const string& path) {
+    TextureLayer none = {-1, -1};
+    if (path.empty()) {
+        return none;
+    }
+    auto found = loaded.find(path);
+    if (found != loaded.end()) {
+        return found->second;
+    }
+
+    PROFILE_SCOPE("TextureArrays::add");
+    int width, height, channels;
+    unsigned char* pixels = SOIL_load_image(path.c_str(), &width, &height, &channels,
+                                            SOIL_LOAD_AUTO);
+    if (pixels == NULL) {
+        throw runtime_error("Failed to load texture: " + path + ", " + SOIL_last_result());
+    }
+    auto key = make_tuple(width, height, channels);
+    auto group = groupIndices.find(key);
+    if (group == groupIndices.end()) {
+        group = groupIndices.insert(make_pair(key, static_cast<int>(groups.size()))).first;
+        groups.push_back(Group());
+        groups.back().width = width;
+        groups.back().height = height;
+        groups.back().channels = channels;
+    }
+    vector<vector<unsigned char> >& layers = groups[group->second].layers;
+    layers.emplace_back(pixels, pixels + width * height * channels);
+    SOIL_free_image_data(pixels);
+
+    TextureLayer layer = {group->second, static_cast<int>(layers.size()) - 1};
+    loaded[path] = layer;
+    return layer;
+}
+
+void TextureArrays::create() {
+    // grey and grey alpha images are read as RGB by the shaders, like the
+    // RGB textures of loadSOIL()
+    static const GLenum formats[] = {GL_RED, GL_RG, GL_RGB, GL_RGBA};
+    static const GLenum internalFormats[] = {GL_R8, GL_RG8, GL_RGB8, GL_RGBA8};
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    for (Group& group : groups) {
+        if (group.texture) continue;
+        GLenum format = formats[group.channels - 1];
+        glGenTextures(1, &group.texture);
+        glBindTexture(GL_TEXTURE_2D_ARRAY, group.texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, internalFormats[group.channels - 1], group.width,
+                     group.height, static_cast<GLsizei>(group.layers.size()), 0, format,
+                     GL_UNSIGNED_BYTE, NULL);
+        for (size_t layer = 0; layer < group.layers.size(); layer++) {
+            glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, static_cast<GLint>(layer),
+                            group.width, group.height, 1, format, GL_UNSIGNED_BYTE,
+                            &group.layers[layer][0]);
+        }
+        if (group.channels <= 2) {
+            GLint swizzle[] = {GL_RED, GL_RED, GL_RED, group.channels == 2 ? GL_GREEN : GL_ONE};
+            glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, swizzle);
+        }
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+        vector<vector<unsigned char> >().swap(group.layers);
+    }
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, 0);
+}
@@ -0,0 +1,49 @@
+#ifndef TEXTUREARRAY_H
+#define TEXTUREARRAY_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <map>
+#include <tuple>
+
+/* Where a texture went: which array and its layer there, -1 for none */
+struct TextureLayer {
+    int array;
+    int layer;
+};
+
+/**
+* Images grouped by size and format into GL_TEXTURE_2D_ARRAYs, so that draws
+* of different textures of the same group only change a layer index instead
+* of a binding. Images are added first and kept on the CPU, create() makes
+* the arrays and frees them.
+*/
+class TextureArrays {
+public:
+    TextureArrays() {}
+    TextureArrays(const TextureArrays&) = delete;
+    TextureArrays& operator=(const TextureArrays&) = delete;
+    ~TextureArrays();
+
+    /* Load an image file, once per path; an empty path is no texture */
+    TextureLayer add(const std::string& path);
+
+    /* Upload every group as an array with mipmaps, repeating like loadSOIL() */
+    void create();
+
+    int arrayCount() const { return static_cast<int>(groups.size()); }
+    GLuint texture(int array) const { return groups[array].texture; }
+
+private:
+    struct Group {
+        int width, height, channels;
+        std::vector<std::vector<unsigned char> > layers;  // until create()
+        GLuint texture = 0;
+    };
+    std::vector<Group> groups;
+    std::map<std::tuple<int, int, int>, int> groupIndices;  // by size and channels
+    std::map<std::string, TextureLayer> loaded;
+};
+
+#endif
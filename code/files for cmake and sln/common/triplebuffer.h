@@ -0,0 +1,50 @@
+#ifndef TRIPLEBUFFER_H
+#define TRIPLEBUFFER_H
+
+#include <atomic>
+
+/**
+* Lock-free hand over of the latest value from one writer thread to one
+* reader thread. The writer fills writeBuffer() and publishes it, the reader
+* calls consume() and reads readBuffer(); neither ever waits for the other.
+* Values published while the reader is busy are overwritten, so the reader
+* always gets the newest one. The writer must fill every field of its buffer,
+* which holds a value published up to two updates earlier.
+*/
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : writeIndex(0), middle(1), readIndex(2) {}
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /* Writer side */
+    T& writeBuffer() { return slots[writeIndex]; }
+
+    void publish() {
+        // swap the written buffer with the middle one and flag it as new
+        int previous = middle.exchange(writeIndex | FRESH, std::memory_order_acq_rel);
+        writeIndex = previous & INDEX;
+    }
+
+    /* Reader side: take the newest published value, false if nothing new */
+    bool consume() {
+        if (!(middle.load(std::memory_order_relaxed) & FRESH)) return false;
+        int previous = middle.exchange(readIndex, std::memory_order_acq_rel);
+        readIndex = previous & INDEX;
+        return true;
+    }
+
+    const T& readBuffer() const { return slots[readIndex]; }
+
+private:
+    static const int INDEX = 3;
+    static const int FRESH = 4;
+
+    T slots[3];
+    int writeIndex;            // owned by the writer
+    std::atomic<int> middle;   // index of the middle buffer and the FRESH flag
+    int readIndex;             // owned by the reader
+};
+
+#endif
@@ -1,6 +1,15 @@
 #include <GL/glew.h>
 #include <iostream>
 #include <cmath>
+#include <stdexcept>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 using namespace std;
 #include "util.h"
 
@@ -71,4 +80,70 @@ bool fileExists(const std::string & abs_filename) {
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const std::string& path)
+    : begin(NULL), length(0), fileHandle(INVALID_HANDLE_VALUE), mappingHandle(NULL) {
+    fileHandle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+                             OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        throw runtime_error("Can't open the file: " + path);
+    }
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    length = static_cast<size_t>(fileSize.QuadPart);
+    if (length == 0) return;
+
+    mappingHandle = CreateFileMappingA(fileHandle, NULL, PAGE_READONLY, 0, 0, NULL);
+    if (mappingHandle != NULL) {
+        begin = static_cast<const char*>(
+            MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0));
+    }
+    if (begin == NULL) {
+        if (mappingHandle != NULL) CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw runtime_error("Can't map the file: " + path);
+    }
+}
+
+MappedFile::~MappedFile() {
+    if (begin != NULL) UnmapViewOfFile(begin);
+    if (mappingHandle != NULL) CloseHandle(mappingHandle);
+    if (fileHandle != INVALID_HANDLE_VALUE) CloseHandle(fileHandle);
+}
+
+#else
+
+MappedFile::MappedFile(const std::string& path) : begin(NULL), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw runtime_error("Can't open the file: " + path);
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        throw runtime_error("Can't stat the file: " + path);
+    }
+    length = static_cast<size_t>(st.st_size);
+    if (length == 0) {
+        close(fd);
+        return;
+    }
+
+    void* address = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    // the mapping keeps its own reference to the file
+    close(fd);
+    if (address == MAP_FAILED) {
+        throw runtime_error("Can't map the file: " + path);
+    }
+    madvise(address, length, MADV_SEQUENTIAL);
+    begin = static_cast<const char*>(address);
+}
+
+MappedFile::~MappedFile() {
+    if (begin != NULL) munmap(const_cast<char*>(begin), length);
+}
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <vector>
 #include <string>
+#include <cstddef>
 
 /* We can use a function like this to print some GL capabilities of our adapter
 to the log file. handy if we want to debug problems on other people's computers
@@ -41,4 +42,28 @@ std::string getBaseDir(const std::string& filepath);
 */
 bool fileExists(const std::string& abs_filename);
 
-#endif
\ No newline at end of file
+/**
+* Read-only memory mapping of a whole file. Pages are brought in by the OS on
+* first access, so opening a large file costs nothing until it is read. The
+* mapping is released when the object is destroyed.
+*/
+class MappedFile {
+public:
+    MappedFile(const std::string& path);
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+    ~MappedFile();
+
+    const char* data() const { return begin; }
+    size_t size() const { return length; }
+
+private:
+    const char* begin;
+    size_t length;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+};
+
+#endif
\ No newline at end of file
@@ -4,6 +4,10 @@
 #include <iostream>
 #include <string>
 #include <map>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <future>
 
 // Include GLEW
 #include <GL/glew.h>
@@ -21,6 +25,29 @@
 #include <common/camera.h>
 #include <common/model.h>
 #include <common/skeleton.h>
+#include <common/animation.h>
+#include <common/jobs.h>
+#include <common/ik.h>
+#include <common/lod.h>
+#include <common/recording.h>
+#include <common/rendertarget.h>
+#include <common/benchmark.h>
+#include <common/profiler.h>
+#include <common/glstate.h>
+#include <common/shaderprogram.h>
+#include <common/programcache.h>
+#include <common/shaderpermutations.h>
+#include <common/triplebuffer.h>
+#include <common/camerabuffer.h>
+#include <common/frustum.h>
+#include <common/skinbounds.h>
+#include <common/occlusion.h>
+#include <common/renderqueue.h>
+#include <common/skeletonbatch.h>
+#include <common/distortion.h>
+#include <common/reprojection.h>
+#include <common/dynamicresolution.h>
+#include <common/foveation.h>
 
 using namespace std;
 using namespace glm;
@@ -30,11 +57,28 @@ void initialize();
 void createContext();
 void mainLoop();
 void free();
+void parseOptions(int argc, char* argv[]);
+void openSession();
+void scriptedCamera(float time);
+void distortionPass(RenderTarget* eyes);
+void presentEyes(RenderTarget* eyes);
+void upscaleScene();
+void clearFoveaDepth();
+void compositeFoveation();
+void presentAt(double vsync);
+void awaitFrame(future<void>& poses);
+void reprojectLastFrame();
+struct PoseSnapshot; struct SimulationInput;
+void simulate(float time, bool solveIK, const SimulationInput& input, PoseSnapshot& snapshot);
+void simulationLoop();
+void stopSimulation();
+void occludeCharacters(const PoseSnapshot& snapshot);
 struct Light; struct Material;
 void uploadMaterial(const Material& mtl);
 void uploadLight(const Light& light);
 map<int, mat4> calculateModelPoseFromCoordinates(map<int, float> q);
 vector<mat4> calculateSkinningTransformations(map<int, float> q);
+vector<mat4> calculateSkinningTransformations(const map<int, mat4>& jointLocalTransformations);
 vector<float> calculateSkinningIndices();
 
 #define W_WIDTH 1024
@@ -42,20 +86,139 @@ vector<float> calculateSkinningIndices();
 #define TITLE "Lab 06"
 #define pi 3.1415926
 
+// bone indices per skin vertex, see calculateSkinningIndices()
+const int MESH_SKIN_INFLUENCES = 1;
+
+// distance between the eyes in stereo mode, in meters like the scenes
+const float EYE_SEPARATION = 0.064f;
+
+// depth buffer of the occlusion culling, split between the eyes in stereo
+const int OCCLUSION_WIDTH = 256;
+const int OCCLUSION_HEIGHT = 192;
+
 // global variables
 GLFWwindow* window;
+bool glReady;  // GLEW is initialized, so free() may call GL
 Camera* camera;
-GLuint shaderProgram;
-GLuint projectionMatrixLocation, viewMatrixLocation, modelMatrixLocation;
-// light properties
-GLuint LaLocation, LdLocation, LsLocation, lightPositionLocation, lightPowerLocation;
-// material properties
-GLuint KdLocation, KsLocation, KaLocation, NsLocation;
+ProgramCache* programCache;
+ShaderPermutations* standardShading;
+ShaderProgram* shader;  // the StandardShading variant in use
 
 GLuint surfaceVAO, surfaceVerticesVBO, surfacesBoneIndecesVBO, maleBoneIndicesVBO;
 Drawable* segment, * skeletonSkin, * sk;
-GLuint useSkinningLocation, boneTransformationsLocation;
+SkinBounds* skinBounds;     // per bone of the skin, moved by the skinning palettes
+CullingStats skinCulling;   // skins of characters drawn and culled
+vector<float> skinBoneIndices;  // per skin vertex
+OcclusionCuller* occlusionCuller;
+vector<unsigned char> characterUnoccluded;  // per character, of the frame
+CullingStats occlusionStats;  // skins of characters hidden by the occluders
+RenderQueue* renderQueue;     // sorts the draws of a frame when set
+ogl::Model* materialModel;    // drawn with its materials in a uniform buffer
+vector<mat4> skinModelMatrices;  // per character, of the skins queued
 Skeleton* skeleton;
+Skeleton* simulationSkeleton;  // joints only, posed by the simulation
+JobSystem* jobSystem;
+vector<AnimationGraph*> animationGraphs;
+vector<BlendNode*> gripBlends;
+vector<vec3> characterPositions;
+IKSolver* ikSolver;
+AnimationLODManager* animationLOD;
+map<int, float> ikCoordinates;
+SessionRecorder* sessionRecorder;
+SessionReplayer* sessionReplayer;
+int replayFrame;
+RenderTarget* renderTarget;
+FrameTimer* frameTimer;
+GLStateCache* glState;
+CameraUniformBuffer* cameraBuffer;
+LatencyTracker* latencyTracker;
+RenderTarget* eyeTarget;  // the eyes before the distortion pass
+DistortionMesh* distortionMesh;
+ShaderProgram* distortionProgram;
+RenderTarget* reprojectionTarget;  // the last frame turned to the current head
+ReprojectionPass* reprojectionPass;
+ShaderProgram* reprojectionProgram;
+FramePacer* framePacer;
+mat4 renderedView, renderedProjection;  // of the frame in eyeTarget
+RenderTarget* sceneTarget;    // the scene at the dynamic resolution, multisampled
+RenderTarget* resolveTarget;  // its samples resolved, before scaling up
+ResolutionController* resolutionController;
+FoveationLayout* foveationLayout;
+RenderTarget* insetTarget;      // the eyes' centers at full resolution
+RenderTarget* peripheryTarget;  // the whole eyes at reduced resolution
+
+/* Scenes to run: the skin, whether it is animated and where the camera orbits */
+struct Scene {
+    string name;
+    const char* skinPath;
+    bool animated;
+    vec3 center;           // orbit center of the scripted camera
+    float cameraDistance;
+    float spacing;         // distance between characters on the grid
+};
+const Scene scenes[] = {
+    {"hand", "models/hand.obj", true, vec3(0.0f, -0.3f, 0.0f), 1.0f, 0.4f},
+    {"human", "models/human.obj", false, vec3(0.0f, 3.0f, 0.0f), 8.0f, 6.0f}};
+const Scene* scene = &scenes[0];
+
+// command line options
+#ifdef LAB06_BENCH
+// the benchmark build always renders offscreen and writes its timings
+bool headless = true;
+string timingsPath = "lab06_bench.csv";
+#else
+bool headless = false;
+string timingsPath;
+#endif
+int headlessFrames = 600;
+int warmupFrames = 10;     // untimed frames first, e.g. for lazy driver work
+int characterCount = 1;
+string capturePath, recordPath, replayPath, tracePath, latencyPath;
+bool stereo = false;
+bool distortion = false;
+int distortionResolution = 32;  // quads along each side of an eye
+string distortionReferencePath;
+bool reprojection = false;
+int spikeInterval = 0;     // every spikeInterval-th simulation step stalls
+double refreshRate = 60.0;
+double targetFrameMilliseconds = 0;  // dynamic resolution when above 0
+float insetFraction = 0;   // foveated rendering when above 0
+float peripheryScale = 0.5f;
+bool occlusionCulling = false;
+bool sortDraws = false;
+bool batchSkeleton = false;
+string modelPath;          // .obj drawn through the material buffer when set
+// -1: simulation thread unless the run must be repeatable (headless, sessions)
+int simulationThreadOption = -1;
+
+/* Result of one simulation step, everything the render thread draws */
+struct PoseSnapshot {
+    float time;
+    Pose skeletonPose;                       // joint local pose of the first character
+    vector<vector<mat4> > skinningPalettes;  // per character
+    vector<int> skinInfluences;              // per character, from its level of detail
+};
+
+/* What the simulation needs from the render thread */
+struct SimulationInput {
+    mat4 viewMatrix, projectionMatrix;
+};
+
+// the simulation thread steps at a fixed rate and hands its snapshots over
+// without locks, the render thread interpolates between the two latest
+const float SIMULATION_RATE = 60.0f;
+thread simulationThread;
+atomic<bool> simulationRunning(false);
+chrono::steady_clock::time_point simulationStart;
+TripleBuffer<PoseSnapshot> poseSnapshots;
+TripleBuffer<SimulationInput> simulationInputs;
+
+// with reprojection the frames are paced to vsyncs at the refresh rate,
+// which headless runs emulate
+chrono::steady_clock::time_point pacerStart;
+double pacerClock() {
+    return chrono::duration<double>(chrono::steady_clock::now() - pacerStart).count();
+}
 
 struct Light {
     glm::vec4 La;
@@ -115,19 +278,18 @@ static const map<int, float> bindingPose = {
 };
 
 void uploadMaterial(const Material& mtl) {
-    glUniform4f(KaLocation, mtl.Ka.r, mtl.Ka.g, mtl.Ka.b, mtl.Ka.a);
-    glUniform4f(KdLocation, mtl.Kd.r, mtl.Kd.g, mtl.Kd.b, mtl.Kd.a);
-    glUniform4f(KsLocation, mtl.Ks.r, mtl.Ks.g, mtl.Ks.b, mtl.Ks.a);
-    glUniform1f(NsLocation, mtl.Ns);
+    shader->setVec4(UNIFORM("mtl.Ka"), mtl.Ka);
+    shader->setVec4(UNIFORM("mtl.Kd"), mtl.Kd);
+    shader->setVec4(UNIFORM("mtl.Ks"), mtl.Ks);
+    shader->setFloat(UNIFORM("mtl.Ns"), mtl.Ns);
 }
 
 void uploadLight(const Light& light) {
-    glUniform4f(LaLocation, light.La.r, light.La.g, light.La.b, light.La.a);
-    glUniform4f(LdLocation, light.Ld.r, light.Ld.g, light.Ld.b, light.Ld.a);
-    glUniform4f(LsLocation, light.Ls.r, light.Ls.g, light.Ls.b, light.Ls.a);
-    glUniform3f(lightPositionLocation, light.lightPosition_worldspace.x,
-        light.lightPosition_worldspace.y, light.lightPosition_worldspace.z);
-    glUniform1f(lightPowerLocation, light.power);
+    shader->setVec4(UNIFORM("light.La"), light.La);
+    shader->setVec4(UNIFORM("light.Ld"), light.Ld);
+    shader->setVec4(UNIFORM("light.Ls"), light.Ls);
+    shader->setVec3(UNIFORM("light.lightPosition_worldspace"), light.lightPosition_worldspace);
+    shader->setFloat(UNIFORM("light.power"), light.power);
 }
 
 map<int, mat4> calculateModelPoseFromCoordinates(map<int, float> q) {
@@ -195,13 +357,17 @@ map<int, mat4> calculateModelPoseFromCoordinates(map<int, float> q) {
 }
 
 vector<mat4> calculateSkinningTransformations(map<int, float> q) {
+    return calculateSkinningTransformations(calculateModelPoseFromCoordinates(q));
+}
+
+vector<mat4> calculateSkinningTransformations(const map<int, mat4>& jointLocalTransformations) {
+    PROFILE_SCOPE("calculateSkinningTransformations");
     auto jointLocalTransformationsBinding = calculateModelPoseFromCoordinates(bindingPose);
-    skeleton->setPose(jointLocalTransformationsBinding);
-    auto bindingWorldTransformations = skeleton->getJointWorldTransformations();
+    simulationSkeleton->setPose(jointLocalTransformationsBinding);
+    auto bindingWorldTransformations = simulationSkeleton->getJointWorldTransformations();
 
-    auto jointLocalTransformationsCurrent = calculateModelPoseFromCoordinates(q);
-    skeleton->setPose(jointLocalTransformationsCurrent);
-    auto currentWorldTransformations = skeleton->getJointWorldTransformations();
+    simulationSkeleton->setPose(jointLocalTransformations);
+    auto currentWorldTransformations = simulationSkeleton->getJointWorldTransformations();
 
     vector<mat4> skinningTransformations(JointName::JOINTS);
     for (auto joint : bindingWorldTransformations) {
@@ -212,6 +378,34 @@ vector<mat4> calculateSkinningTransformations(map<int, float> q) {
     return skinningTransformations;
 }
 
+// clips of the animation graph, as generalized coordinates over time
+map<int, float> relaxedCoordinates(float /*time*/) {
+    map<int, float> q;
+    for (int i = 0; i < CoordinateName::DOFS; i++) {
+        q[i] = 0;
+    }
+    return q;
+}
+
+map<int, float> gripCoordinates(float /*time*/) {
+    // solved by the fingertip IK before the graph is evaluated
+    return ikCoordinates;
+}
+
+map<int, float> thumbCoordinates(float time) {
+    map<int, float> q = relaxedCoordinates(time);
+    q[CoordinateName::H11_X] = 20 * sin(2 * time);
+    q[CoordinateName::H12_X] = 30 * sin(2 * time);
+    return q;
+}
+
+ClipNode::Sampler coordinateSampler(map<int, float>(*coordinates)(float)) {
+    return [coordinates](float time, Pose& pose) {
+        fromJointLocalTransformations(
+            calculateModelPoseFromCoordinates(coordinates(time)), pose);
+    };
+}
+
 vector<float> calculateSkinningIndices() {
     // Task 4.3: assign a body index for each vertex in the model (skin) based
     // on its proximity to a body part (e.g. tight)
@@ -266,25 +460,70 @@ vector<float> calculateSkinningIndices() {
 
 void createContext() {
     // shader
-    shaderProgram = loadShaders(
-        "StandardShading.vertexshader",
-        "StandardShading.fragmentshader");
-
-    // get pointers to uniforms
-    modelMatrixLocation = glGetUniformLocation(shaderProgram, "M");
-    viewMatrixLocation = glGetUniformLocation(shaderProgram, "V");
-    projectionMatrixLocation = glGetUniformLocation(shaderProgram, "P");
-    KaLocation = glGetUniformLocation(shaderProgram, "mtl.Ka");
-    KdLocation = glGetUniformLocation(shaderProgram, "mtl.Kd");
-    KsLocation = glGetUniformLocation(shaderProgram, "mtl.Ks");
-    NsLocation = glGetUniformLocation(shaderProgram, "mtl.Ns");
-    LaLocation = glGetUniformLocation(shaderProgram, "light.La");
-    LdLocation = glGetUniformLocation(shaderProgram, "light.Ld");
-    LsLocation = glGetUniformLocation(shaderProgram, "light.Ls");
-    lightPositionLocation = glGetUniformLocation(shaderProgram, "light.lightPosition_worldspace");
-    lightPowerLocation = glGetUniformLocation(shaderProgram, "light.power");
-    useSkinningLocation = glGetUniformLocation(shaderProgram, "useSkinning");
-    boneTransformationsLocation = glGetUniformLocation(shaderProgram, "boneTransformations");
+    // programs are loaded from the binaries of the last run when possible,
+    // the uniforms are reflected at link time; the static and the skinned
+    // variants are compiled together, others on first use
+    programCache = new ProgramCache("shadercache-");
+    standardShading = new ShaderPermutations(
+        {"StandardShading.vertexshader", "StandardShading.fragmentshader", "", ""},
+        programCache, glState);
+    standardShading->bindBlock(UNIFORM("CameraBlock"), cameraBuffer->binding);
+    uint32_t viewFeatures = stereo ? SHADER_STEREO : 0;
+    standardShading->precompile({
+        shaderVariant(viewFeatures),
+        shaderVariant(SHADER_SKINNING | viewFeatures, MESH_SKIN_INFLUENCES)});
+    shader = standardShading->get(shaderVariant(viewFeatures));
+
+    // the eyes render into a target that the distortion pass warps onto the
+    // window (or the headless target) and that reprojection resamples
+    int eyes = stereo ? CAMERA_EYES : 1;
+    if (distortion || reprojection) {
+        eyeTarget = new RenderTarget(W_WIDTH, W_HEIGHT);
+    }
+    if (distortion) {
+        distortionMesh = new DistortionMesh(defaultLensProfile(), eyes,
+            static_cast<float>(W_WIDTH / eyes) / W_HEIGHT, distortionResolution);
+        distortionProgram = new ShaderProgram(programCache->load({
+            {"Distortion.vertexshader", "Distortion.fragmentshader", "", ""}})[0]);
+        distortionProgram->stateCache = glState;
+    }
+    // the scene renders into part of a multisampled target, as large as the
+    // GPU frame time allows, and is scaled up to the full size
+    if (targetFrameMilliseconds > 0) {
+        sceneTarget = new RenderTarget(W_WIDTH, W_HEIGHT, 4);
+        resolveTarget = new RenderTarget(W_WIDTH, W_HEIGHT);
+        resolutionController = new ResolutionController(targetFrameMilliseconds);
+    }
+    if (occlusionCulling) {
+        occlusionCuller = new OcclusionCuller(OCCLUSION_WIDTH / eyes, OCCLUSION_HEIGHT, eyes);
+    }
+    if (sortDraws) {
+        renderQueue = new RenderQueue();
+    }
+    // a model of many materials, each mesh selecting its own from a uniform
+    // buffer by index instead of uploading it
+    if (!modelPath.empty()) {
+        materialModel = new ogl::Model(modelPath);
+        standardShading->bindBlock(UNIFORM("MaterialBlock"),
+                                   materialModel->materialBuffer.binding);
+    }
+    // foveation renders each eye's center at full resolution and the rest at
+    // a lower one, into targets composited like the scene target
+    if (insetFraction > 0) {
+        foveationLayout = new FoveationLayout(W_WIDTH, W_HEIGHT, eyes, insetFraction,
+                                              peripheryScale);
+        insetTarget = new RenderTarget(eyes * foveationLayout->insetWidth,
+                                       foveationLayout->insetHeight);
+        peripheryTarget = new RenderTarget(foveationLayout->peripheryWidth,
+                                           foveationLayout->peripheryHeight);
+    }
+    if (reprojection) {
+        reprojectionTarget = new RenderTarget(W_WIDTH, W_HEIGHT);
+        reprojectionPass = new ReprojectionPass();
+        reprojectionProgram = new ShaderProgram(programCache->load({
+            {"Reprojection.vertexshader", "Reprojection.fragmentshader", "", ""}})[0]);
+        reprojectionProgram->stateCache = glState;
+    }
 
     float xx = -0.3f;
 
@@ -302,7 +541,8 @@ void createContext() {
     // of each other (conceptually). Furthermore, each body can  have many
     // drawables (geometries) attached. The joints are related to each other
     // and form a parent child relations. A joint is attached on a body.
-    skeleton = new Skeleton(modelMatrixLocation, viewMatrixLocation, projectionMatrixLocation);
+    skeleton = new Skeleton(*shader);
+    skeleton->instanceCount = stereo ? CAMERA_EYES : 1;
 
     // h11
     Joint* h11Joint = new Joint(); // creates a joint
@@ -361,140 +601,931 @@ void createContext() {
     h53Joint->parent = h52Joint;
     skeleton->joints[JointName::H53] = h53Joint;
 
+    // the bodies' drawables in one vertex array, their model matrices in a
+    // buffer, drawn with as few calls as the culling leaves ranges
+    if (batchSkeleton) {
+        skeleton->batch = new SkeletonBatch(*skeleton);
+    }
+
+    // the simulation poses its own joints while the render thread draws
+    simulationSkeleton = skeleton->cloneJoints();
+
     // skin
-    skeletonSkin = new Drawable("models/h2.obj");
+    skeletonSkin = new Drawable(scene->skinPath);
     //sk = new Drawable("models/h1.obj");
     auto maleBoneIndices = calculateSkinningIndices();
+    skinBounds = new SkinBounds(skeletonSkin->indexedVertices, maleBoneIndices);
+    skinBoneIndices = maleBoneIndices;
     glGenBuffers(1, &maleBoneIndicesVBO);
     glBindBuffer(GL_ARRAY_BUFFER, maleBoneIndicesVBO);
     glBufferData(GL_ARRAY_BUFFER, maleBoneIndices.size() * sizeof(float),
         &maleBoneIndices[0], GL_STATIC_DRAW);
     glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 0, NULL);
     glEnableVertexAttribArray(3);
+
+    // characters on a square grid, the first one at the origin
+    int columns = static_cast<int>(ceil(sqrt(static_cast<float>(characterCount))));
+    for (int c = 0; c < characterCount; c++) {
+        characterPositions.push_back(
+            vec3(c % columns, 0.0f, -(c / columns)) * scene->spacing);
+    }
+
+    // animation graph of every character: the relaxed hand blends into a grip
+    // and a thumb only layer is added on top; the branches are evaluated on
+    // the job system
+    jobSystem = new JobSystem();
+    Pose bindPose(JointName::JOINTS);
+    fromJointLocalTransformations(calculateModelPoseFromCoordinates(bindingPose), bindPose);
+    for (int c = 0; scene->animated && c < characterCount; c++) {
+        AnimationGraph* animationGraph = new AnimationGraph(JointName::JOINTS);
+        ClipNode* relaxed = animationGraph->addClip(coordinateSampler(relaxedCoordinates));
+        ClipNode* grip = animationGraph->addClip(coordinateSampler(gripCoordinates));
+        BlendNode* gripBlend = animationGraph->addBlend(relaxed, grip);
+        ClipNode* thumb = animationGraph->addClip(coordinateSampler(thumbCoordinates));
+        thumb->timeOffset = 0.5f * c;
+        AdditiveNode* thumbLayer = animationGraph->addAdditive(gripBlend, thumb, bindPose);
+        thumbLayer->mask = createJointMask(JointName::JOINTS, {JointName::H11, JointName::H12});
+        animationGraphs.push_back(animationGraph);
+        gripBlends.push_back(gripBlend);
+    }
+
+    // fingertip IK chains; the finger DOFs rotate about X so the chains live
+    // in the (y, z) plane, hinge positions are estimated from the skinning
+    // regions of calculateSkinningIndices()
+    ikSolver = new IKSolver();
+    ikSolver->addChain({
+        {vec2(-0.10f, 0), vec2(-0.23f, 0), vec2(-0.30f, 0)},
+        {CoordinateName::H11_X, CoordinateName::H12_X},
+        {vec2(-30, 60), vec2(0, 90)}});
+    ikSolver->addChain({
+        {vec2(-0.24f, 0), vec2(-0.345f, 0), vec2(-0.385f, 0), vec2(-0.43f, 0)},
+        {CoordinateName::H21_X, CoordinateName::H22_X, CoordinateName::H23_X},
+        {vec2(-10, 90), vec2(0, 100), vec2(0, 90)}});
+    ikSolver->addChain({
+        {vec2(-0.24f, 0), vec2(-0.35f, 0), vec2(-0.395f, 0), vec2(-0.44f, 0)},
+        {CoordinateName::H31_X, CoordinateName::H32_X, CoordinateName::H33_X},
+        {vec2(-10, 90), vec2(0, 100), vec2(0, 90)}});
+    ikSolver->addChain({
+        {vec2(-0.24f, 0), vec2(-0.34f, 0), vec2(-0.38f, 0), vec2(-0.42f, 0)},
+        {CoordinateName::H41_X, CoordinateName::H42_X, CoordinateName::H43_X},
+        {vec2(-10, 90), vec2(0, 100), vec2(0, 90)}});
+    ikSolver->addChain({
+        {vec2(-0.24f, 0), vec2(-0.30f, 0), vec2(-0.33f, 0), vec2(-0.36f, 0)},
+        {CoordinateName::H51_X, CoordinateName::H52_X, CoordinateName::H53_X},
+        {vec2(-10, 90), vec2(0, 100), vec2(0, 90)}});
+    ikCoordinates = relaxedCoordinates(0);
+
+    // animation level of detail by projected size: full rate close up, every
+    // other frame further away, and every fourth frame with frozen finger
+    // tips and single influence skinning in the distance
+    animationLOD = new AnimationLODManager({
+        {400.0f, 1, false, 4},
+        {150.0f, 2, false, 4},
+        {0.0f, 4, true, 1}});
+    for (AnimationGraph* animationGraph : animationGraphs) {
+        animationLOD->addCharacter(animationGraph, 0.3f, {
+            JointName::H12, JointName::H23, JointName::H33, JointName::H43, JointName::H53});
+    }
 }
 
 void free() {
+    stopSimulation();
     delete segment;
     // the skeleton owns the bodies and joints so memory is freed when skeleton
     // is deleted
     delete skeleton;
+    delete simulationSkeleton;
     delete skeletonSkin;
+    delete skinBounds;
+    delete occlusionCuller;
+    delete renderQueue;
+    delete materialModel;
     //delete sk;
+    delete animationLOD;
+    for (AnimationGraph* animationGraph : animationGraphs) {
+        delete animationGraph;
+    }
+    delete frameTimer;
+    delete latencyTracker;
+    delete cameraBuffer;
+    delete glState;
+    Profiler::shutdownGpu();
+    delete jobSystem;
+    delete ikSolver;
+    delete sessionRecorder;
+    delete sessionReplayer;
+    delete renderTarget;
+    delete eyeTarget;
+    delete distortionMesh;
+    delete distortionProgram;
+    delete reprojectionTarget;
+    delete reprojectionPass;
+    delete reprojectionProgram;
+    delete framePacer;
+    delete sceneTarget;
+    delete resolveTarget;
+    delete resolutionController;
+    delete foveationLayout;
+    delete insetTarget;
+    delete peripheryTarget;
+
+    delete standardShading;
+    delete programCache;
+
+    // e.g. a bad option throws before there is a context, and initialize()
+    // terminates GLFW itself when it fails
+    if (glReady) {
+        glDeleteBuffers(1, &surfaceVAO);
+        glDeleteVertexArrays(1, &surfaceVerticesVBO);
+        glDeleteVertexArrays(1, &surfacesBoneIndecesVBO);
+
+        glDeleteVertexArrays(1, &maleBoneIndicesVBO);
+        glfwTerminate();
+    }
+}
 
-    glDeleteBuffers(1, &surfaceVAO);
-    glDeleteVertexArrays(1, &surfaceVerticesVBO);
-    glDeleteVertexArrays(1, &surfacesBoneIndecesVBO);
+/* Blend two snapshots, w = 0 gives a and w = 1 gives b */
+void interpolateSnapshots(const PoseSnapshot& a, const PoseSnapshot& b, float w,
+                          PoseSnapshot& result) {
+    result.time = mix(a.time, b.time, w);
+    result.skinInfluences = b.skinInfluences;
+    result.skeletonPose.resize(b.skeletonPose.size());
+    for (size_t j = 0; j < b.skeletonPose.size(); j++) {
+        result.skeletonPose[j] = j < a.skeletonPose.size() ?
+            interpolate(a.skeletonPose[j], b.skeletonPose[j], w, LERP) : b.skeletonPose[j];
+    }
+    result.skinningPalettes.resize(b.skinningPalettes.size());
+    for (size_t c = 0; c < b.skinningPalettes.size(); c++) {
+        const vector<mat4>& to = b.skinningPalettes[c];
+        vector<mat4>& palette = result.skinningPalettes[c];
+        palette.resize(to.size());
+        bool blend = c < a.skinningPalettes.size() && a.skinningPalettes[c].size() == to.size();
+        for (size_t j = 0; j < to.size(); j++) {
+            // the skinning transformations are rigid
+            palette[j] = blend ? interpolateRigid(a.skinningPalettes[c][j], to[j], w) : to[j];
+        }
+    }
+}
 
-    glDeleteVertexArrays(1, &maleBoneIndicesVBO);
+void simulate(float time, bool solveIK, const SimulationInput& input, PoseSnapshot& snapshot) {
+    PROFILE_SCOPE("simulate");
+    // a stand-in for a hitch in pose evaluation or loading, long enough to
+    // miss a few vsyncs
+    static int steps = 0;
+    if (spikeInterval > 0 && ++steps % spikeInterval == 0) {
+        this_thread::sleep_for(chrono::duration<double>(3.0 / refreshRate));
+    }
+    if (solveIK) {
+        // the fingertips grasp at a point moving in front of the palm, the
+        // previous solution is the initial guess
+        vec2 graspTarget(-0.30f, -0.08f + 0.04f * sin(time));
+        for (int c = 0; c < ikSolver->chainCount(); c++) {
+            ikSolver->setTarget(c, graspTarget);
+        }
+        ikSolver->solve(ikCoordinates);
+    }
 
-    glDeleteProgram(shaderProgram);
-    glfwTerminate();
+    vector<vec3> lodPositions;
+    for (int c = 0; c < static_cast<int>(gripBlends.size()); c++) {
+        gripBlends[c]->weight = 0.5f + 0.5f * sin(time + c);
+        lodPositions.push_back(characterPositions[c] + scene->center);
+    }
+    animationLOD->selectLevels(lodPositions, input.viewMatrix, input.projectionMatrix, W_HEIGHT);
+    animationLOD->update(time, jobSystem);
+
+    // the pose of the bones and the skinning palettes
+    snapshot.time = time;
+    snapshot.skeletonPose.clear();
+    snapshot.skinningPalettes.resize(characterCount);
+    snapshot.skinInfluences.assign(characterCount, 1);
+    if (!scene->animated) return;
+    snapshot.skeletonPose = animationLOD->getPose(0);
+    for (int c = 0; c < characterCount; c++) {
+        // Task 4.2: calculate the bone transformations
+        snapshot.skinningPalettes[c] = calculateSkinningTransformations(
+            toJointLocalTransformations(animationLOD->getPose(c)));
+        snapshot.skinInfluences[c] = animationLOD->getLevelSettings(c).maxSkinInfluences;
+    }
+}
+
+/* Steps the simulation at SIMULATION_RATE until stopSimulation() */
+void simulationLoop() {
+    Profiler::setThreadName("simulation");
+    const chrono::duration<double> step(1.0 / SIMULATION_RATE);
+    long long steps = 0;
+    while (simulationRunning.load()) {
+        this_thread::sleep_until(simulationStart +
+            chrono::duration_cast<chrono::steady_clock::duration>(step * steps));
+        simulationInputs.consume();
+        simulate(steps / SIMULATION_RATE, true, simulationInputs.readBuffer(),
+                 poseSnapshots.writeBuffer());
+        poseSnapshots.publish();
+        // after a spike the missed steps are skipped instead of caught up
+        long long due = static_cast<long long>(
+            (chrono::steady_clock::now() - simulationStart) / step);
+        steps = std::max(steps + 1, due);
+    }
+}
+
+void stopSimulation() {
+    if (simulationThread.joinable()) {
+        simulationRunning.store(false);
+        simulationThread.join();
+    }
+}
+
+/**
+* Rasterize the posed skins of the characters as occluders, then find the
+* characters that are hidden behind them; runs on the job system
+*/
+void occludeCharacters(const PoseSnapshot& snapshot) {
+    PROFILE_SCOPE("occlusion");
+    const vector<mat4> bindPose;
+    const vector<vec3>& vertices = skeletonSkin->indexedVertices;
+    vector<vec3> posed(vertices.size());
+    for (int c = 0; c < characterCount; c++) {
+        const vector<mat4>& palette = scene->animated ? snapshot.skinningPalettes[c] : bindPose;
+        mat4 modelMatrix = translate(mat4(), characterPositions[c]);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            int bone = i < skinBoneIndices.size() ? static_cast<int>(skinBoneIndices[i]) : -1;
+            mat4 skinning = bone >= 0 && bone < static_cast<int>(palette.size()) ?
+                modelMatrix * palette[bone] : modelMatrix;
+            posed[i] = vec3(skinning * vec4(vertices[i], 1.0f));
+        }
+        occlusionCuller->addOccluder(posed, skeletonSkin->indices);
+    }
+    occlusionCuller->finish();
+
+    // a skin is hidden when all of its parts are
+    characterUnoccluded.assign(characterCount, 0);
+    for (int c = 0; c < characterCount; c++) {
+        const vector<mat4>& palette = scene->animated ? snapshot.skinningPalettes[c] : bindPose;
+        mat4 modelMatrix = translate(mat4(), characterPositions[c]);
+        for (size_t part = 0; part < skinBounds->bones.size(); part++) {
+            BoundingBox box = transformBounds(skinBounds->boxes[part],
+                skinBounds->partTransformation(static_cast<int>(part), palette, modelMatrix));
+            if (occlusionCuller->visible(box)) {
+                characterUnoccluded[c] = 1;
+                break;
+            }
+        }
+        if (characterUnoccluded[c]) {
+            occlusionStats.visible++;
+        } else {
+            occlusionStats.culled++;
+        }
+    }
 }
 
 void mainLoop() {
     camera->position = vec3(0, -0.3, 1);
+    bool threaded = simulationThreadOption == 1 || (simulationThreadOption == -1 &&
+        !headless && !sessionRecorder && !sessionReplayer);
+    if (threaded && (sessionRecorder || sessionReplayer)) {
+        throw runtime_error("Sessions are recorded and replayed with the inline simulation");
+    }
+
+    // with the simulation thread frames draw an interpolation of the two latest
+    // snapshots, otherwise the snapshot simulated for the frame
+    PoseSnapshot previousSnapshot, latestSnapshot, frameSnapshot;
+    if (threaded) {
+        simulationInputs.writeBuffer() = {camera->viewMatrix, camera->projectionMatrix};
+        simulationInputs.publish();
+        simulationStart = chrono::steady_clock::now();
+        simulationRunning.store(true);
+        simulationThread = thread(simulationLoop);
+        while (!poseSnapshots.consume()) {
+            this_thread::yield();
+        }
+        latestSnapshot = previousSnapshot = poseSnapshots.readBuffer();
+    }
+
+    // the first vsync sets the phase, windows present on vsync from then on
+    if (reprojection) {
+        if (!headless) {
+            glfwSwapInterval(1);
+            glfwSwapBuffers(window);
+        }
+        pacerStart = chrono::steady_clock::now();
+        framePacer = new FramePacer(1.0 / refreshRate, 0.0);
+    }
+
+    size_t resolutionSamples = 0;  // GPU times fed to the resolution controller
+    int frame = 0;
     do {
-        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        PROFILE_SCOPE("frame");
+        bool timed = frameTimer && frame >= warmupFrames;
+        if (timed) {
+            frameTimer->beginFrame();
+        }
+        // headless runs advance a fixed clock so that they are repeatable; the
+        // simulation thread's clock runs one step behind, between two snapshots
+        float time = headless ? frame / 60.0f : glfwGetTime();
+        if (threaded) {
+            time = chrono::duration<float>(chrono::steady_clock::now() - simulationStart).count() -
+                1.0f / SIMULATION_RATE;
+        }
 
-        glUseProgram(shaderProgram);
+        // session frame: time, camera position, angles and FoV, then the
+        // solved coordinates in CoordinateName order
+        vector<float> sessionFrame;
+        if (sessionReplayer) {
+            // replay loops over the recording
+            sessionReplayer->readFrame(replayFrame, sessionFrame);
+            replayFrame = (replayFrame + 1) % sessionReplayer->frameCount();
+            time = sessionFrame[0];
+            camera->position = vec3(sessionFrame[1], sessionFrame[2], sessionFrame[3]);
+            camera->horizontalAngle = sessionFrame[4];
+            camera->verticalAngle = sessionFrame[5];
+            camera->FoV = sessionFrame[6];
+            camera->updateMatrices();
+            int c = 7;
+            for (auto& coordinate : ikCoordinates) {
+                coordinate.second = sessionFrame[c++];
+            }
+        } else if (headless) {
+            scriptedCamera(time);
+        }
 
-        // camera
-        camera->update();
+        // interactive input is sampled after the simulation, which gets the
+        // camera of the previous frame; that camera is the one recorded, so
+        // that a replay simulates with the same one
+        SimulationInput simulationInput = {camera->viewMatrix, camera->projectionMatrix};
+        if (sessionRecorder) {
+            sessionFrame = {time, camera->position.x, camera->position.y,
+                camera->position.z, camera->horizontalAngle, camera->verticalAngle,
+                camera->FoV};
+        }
+        if (threaded) {
+            simulationInputs.writeBuffer() = simulationInput;
+            simulationInputs.publish();
+            if (poseSnapshots.consume()) {
+                swap(previousSnapshot, latestSnapshot);
+                latestSnapshot = poseSnapshots.readBuffer();
+            }
+            float span = latestSnapshot.time - previousSnapshot.time;
+            float w = span > 0.0f ? clamp((time - previousSnapshot.time) / span, 0.0f, 1.0f) : 1.0f;
+            interpolateSnapshots(previousSnapshot, latestSnapshot, w, frameSnapshot);
+        } else if (reprojection) {
+            // the poses are evaluated on another thread, so that vsyncs they
+            // are too late for can be filled with the last frame meanwhile
+            future<void> poses = async(launch::async, [&]() {
+                simulate(time, !sessionReplayer, simulationInput, frameSnapshot);
+            });
+            awaitFrame(poses);
+        } else {
+            simulate(time, !sessionReplayer, simulationInput, frameSnapshot);
+        }
+        future<void> noPoses;
+        if (threaded && reprojection) {
+            awaitFrame(noPoses);
+        }
+        double frameVsync = 0, drawStart = 0;
+        if (reprojection) {
+            drawStart = pacerClock();
+            frameVsync = framePacer->targetVsync(drawStart);
+        }
+
+        // late latch: read the camera input right before the draws and
+        // extrapolate it by the measured input to completion latency; the
+        // matrices are written once to the buffer all programs share
+        if (!headless && !sessionReplayer) {
+            camera->update();
+        }
+        latencyTracker->inputSampled();
+        float prediction = headless || sessionRecorder || sessionReplayer ?
+            0.0f : static_cast<float>(latencyTracker->averageLatency());
         mat4 projectionMatrix = camera->projectionMatrix;
-        mat4 viewMatrix = camera->viewMatrix;
-
-        // light
-        uploadLight(light);
-
-        glUniform1i(useSkinningLocation, 0);
-        glUniformMatrix4fv(viewMatrixLocation, 1, GL_FALSE, &viewMatrix[0][0]);
-        glUniformMatrix4fv(projectionMatrixLocation, 1, GL_FALSE, &projectionMatrix[0][0]);
-
-
-
-
-
-        // Task 3.2: assign values to the generalized coordinates and correct
-        // the transformations in calculateModelPoseFromCoordinates()
-        // Homework 2: add 3 rotational DoFs for the pelvis and the necessary
-        // DoFs for left leg.
-        // Task 3.3: make the skeleton walk (approximately)
-        // Homework 3: model Michael Jackson's Moonwalk .
-        //*/
-        float time = glfwGetTime();
-        int w = 6.25;
-
-        map<int, float> q;
-        q[CoordinateName::H11_X] = 0;
-        q[CoordinateName::H12_X] = 0;
-        q[CoordinateName::H21_X] = 0;
-        q[CoordinateName::H22_X] = 0;
-        q[CoordinateName::H23_X] = 0;
-        q[CoordinateName::H31_X] = 0;
-        q[CoordinateName::H32_X] = 0;
-        q[CoordinateName::H33_X] = 0;
-        q[CoordinateName::H41_X] = 0;
-        q[CoordinateName::H42_X] = 0;
-        q[CoordinateName::H43_X] = 0;
-        q[CoordinateName::H51_X] = 0;
-        q[CoordinateName::H52_X] = 0;
-        q[CoordinateName::H53_X] = 0;
-
-
-        auto jointLocalTransformations = calculateModelPoseFromCoordinates(q);
-        skeleton->setPose(jointLocalTransformations);
-
-        glUniform1i(useSkinningLocation, 0);
-        uploadMaterial(boneMaterial);
-        skeleton->draw(viewMatrix, projectionMatrix);
-        //*/
-
-        /*/--
-        sk->bind();
-        mat4 maleModelMatrix2 = mat4(1);
-        glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, &maleModelMatrix2[0][0]);
-        glUniformMatrix4fv(viewMatrixLocation, 1, GL_FALSE, &viewMatrix[0][0]);
-        glUniformMatrix4fv(projectionMatrixLocation, 1, GL_FALSE, &projectionMatrix[0][0]);
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        sk->draw();
-        //*/
-        // Task 4.1: draw the skin using wireframe mode
-        //*/
-        skeletonSkin->bind();
-
-        mat4 maleModelMatrix = glm::translate(mat4(), vec3(0.0f, 0.0f, 0.0f));;
-        //mat4 maleModelMatrix = glm::rotate(mat4(), -3.14f / 2.0f, vec3(0.0f, 1.0f, 0.0f));
-        glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, &maleModelMatrix[0][0]);
-        glUniformMatrix4fv(viewMatrixLocation, 1, GL_FALSE, &viewMatrix[0][0]);
-        glUniformMatrix4fv(projectionMatrixLocation, 1, GL_FALSE, &projectionMatrix[0][0]);
+        mat4 viewMatrix = prediction > 0.0f ?
+            camera->predictViewMatrix(prediction) : camera->viewMatrix;
+
+        // stereo renders both eyes in one pass, every draw is instanced once
+        // per eye; the eyes look parallel, each into its half of the target,
+        // and are culled together with a frustum containing both
+        mat4 eyeProjection = projectionMatrix;
+        mat4 eyeViews[CAMERA_EYES];
+        if (stereo) {
+            eyeProjection = perspective(radians(camera->FoV),
+                0.5f * W_WIDTH / W_HEIGHT, 0.1f, 1000.0f);
+            for (int eye = 0; eye < CAMERA_EYES; eye++) {
+                float offset = (eye == 0 ? 0.5f : -0.5f) * EYE_SEPARATION;
+                eyeViews[eye] = translate(mat4(), vec3(offset, 0.0f, 0.0f)) * viewMatrix;
+            }
+        }
+        // writes the eyes' matrices with the projection, returns their frustum
+        auto setEyeProjection = [&](const mat4& projection) {
+            if (!stereo) {
+                cameraBuffer->update(viewMatrix, projection);
+                return Frustum(projection * viewMatrix);
+            }
+            mat4 eyeProjections[CAMERA_EYES] = {projection, projection};
+            cameraBuffer->update(eyeViews, eyeProjections);
+            return Frustum::stereo(Frustum(projection * eyeViews[0]),
+                                   Frustum(projection * eyeViews[1]));
+        };
+        Frustum cullingFrustum = setEyeProjection(eyeProjection);
+        int eyes = stereo ? CAMERA_EYES : 1;
+
+        // the occluders are rasterized and the characters tested on the job
+        // system while this thread sets the frame up, the simulation thread
+        // animates the next step meanwhile
+        JobCounter occlusionJob;
+        if (occlusionCuller) {
+            mat4 occlusionViews[CAMERA_EYES];
+            for (int eye = 0; eye < eyes; eye++) {
+                occlusionViews[eye] = eyeProjection * (stereo ? eyeViews[eye] : viewMatrix);
+            }
+            occlusionCuller->begin(occlusionViews);
+            jobSystem->run(occlusionJob, [&]() { occludeCharacters(frameSnapshot); });
+        }
 
-        // Task 4.2: calculate the bone transformations
-        auto T = calculateSkinningTransformations(q);
-        glUniformMatrix4fv(boneTransformationsLocation, T.size(),
-            GL_FALSE, &T[0][0][0]);
+        if (sessionRecorder) {
+            for (auto& coordinate : ikCoordinates) {
+                sessionFrame.push_back(coordinate.second);
+            }
+            sessionRecorder->append(sessionFrame);
+        }
 
-        glUniform1i(useSkinningLocation, 1);
+        // every variant is a separate program with its own uniforms, those
+        // that did not change since its last use are skipped by the cache
+        auto variantProgram = [&](uint32_t variant) {
+            return standardShading->get(stereo ? variant | SHADER_STEREO : variant);
+        };
+        auto useVariant = [&](uint32_t variant) {
+            shader = variantProgram(variant);
+            shader->use();
+            uploadLight(light);
+        };
+        // everything in the frustum into the bound target, the matrices
+        // of the camera buffer; with a render queue the skeleton and the
+        // skins are queued and submitted by state, then front to back
+        auto drawScene = [&](const Frustum& cullingFrustum) {
+            useVariant(shaderVariant(0));
+            if (renderQueue) {
+                renderQueue->begin(viewMatrix);
+            }
+
+            if (scene->animated) {
+                auto jointLocalTransformations = toJointLocalTransformations(
+                    frameSnapshot.skeletonPose);
+                skeleton->setPose(jointLocalTransformations);
+
+                jobSystem->wait(occlusionJob);
+                if (renderQueue) {
+                    skeleton->enqueue(*renderQueue, variantProgram(shaderVariant(0)),
+                                      &boneMaterial, GL_FILL, &cullingFrustum, occlusionCuller);
+                } else {
+                    if (skeleton->batch) {
+                        useVariant(shaderVariant(SHADER_DRAW_MATRICES));
+                        shader->setInt(UNIFORM("modelMatrices"), skeleton->batch->textureUnit);
+                    }
+                    uploadMaterial(boneMaterial);
+                    skeleton->draw(viewMatrix, projectionMatrix, &cullingFrustum,
+                                   occlusionCuller);
+                }
+            }
+            //*/
+
+            /*/--
+            sk->bind();
+            mat4 maleModelMatrix2 = mat4(1);
+            shader->setMat4(UNIFORM("M"), maleModelMatrix2);
+            shader->setMat4(UNIFORM("V"), viewMatrix);
+            shader->setMat4(UNIFORM("P"), projectionMatrix);
+            glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+            sk->draw();
+            //*/
+            // Task 4.1: draw the skin using wireframe mode
+            //*/
+            skeletonSkin->bind(glState);
+
+            // a wireframe hides nothing, the skins are solid when they occlude
+            GLenum skinMode = occlusionCuller ? GL_FILL : GL_LINE;
+            glState->polygonMode(skinMode);
+
+            {
+                PROFILE_SCOPE("skin");
+                PROFILE_GPU_SCOPE("skin");
+                const vector<mat4> bindPose;
+                jobSystem->wait(occlusionJob);
+                skinModelMatrices.resize(characterCount);
+                for (int c = 0; c < characterCount; c++) {
+                    if (occlusionCuller && !characterUnoccluded[c]) {
+                        continue;
+                    }
+                    // every part of the skin where its bone puts it, a skin
+                    // that is not animated is drawn as loaded
+                    const vector<mat4>& palette = scene->animated ?
+                        frameSnapshot.skinningPalettes[c] : bindPose;
+                    if (!skinBounds->visible(cullingFrustum, palette,
+                            translate(mat4(), characterPositions[c]), &skinCulling)) {
+                        continue;
+                    }
+
+                    // the level of detail caps the bone influences, the mesh has
+                    // MESH_SKIN_INFLUENCES per vertex
+                    uint32_t variant = shaderVariant(0);
+                    if (scene->animated) {
+                        variant = shaderVariant(SHADER_SKINNING, std::min(MESH_SKIN_INFLUENCES,
+                            frameSnapshot.skinInfluences[c]));
+                    }
+                    if (renderQueue) {
+                        skinModelMatrices[c] = translate(mat4(), characterPositions[c]);
+                        DrawPacket packet = {0, variantProgram(variant), &boneMaterial, skinMode,
+                            skeletonSkin->VAO, static_cast<GLsizei>(skeletonSkin->indices.size()),
+                            &skinModelMatrices[c], c};
+                        renderQueue->add(packet, vec3(skinModelMatrices[c] *
+                            vec4(skeletonSkin->sphereBounds.center, 1.0f)));
+                        continue;
+                    }
+                    useVariant(variant);
+                    uploadMaterial(boneMaterial);
+
+                    mat4 maleModelMatrix = glm::translate(mat4(), characterPositions[c]);
+                    //mat4 maleModelMatrix = glm::rotate(mat4(), -3.14f / 2.0f, vec3(0.0f, 1.0f, 0.0f));
+                    shader->setMat4(UNIFORM("M"), maleModelMatrix);
+
+                    // the bone transformations of the snapshot
+                    if (scene->animated) {
+                        const vector<mat4>& T = frameSnapshot.skinningPalettes[c];
+                        shader->setMat4Array(UNIFORM("boneTransformations"), T.size(), &T[0]);
+                    }
+
+                    skeletonSkin->draw(GL_TRIANGLES, eyes);
+                }
+            }
+            if (renderQueue) {
+                PROFILE_SCOPE("render queue");
+                PROFILE_GPU_SCOPE("render queue");
+                renderQueue->submit(glState, eyes, [&](const DrawPacket& packet,
+                                                       unsigned changes) {
+                    if (changes & PROGRAM_CHANGED) {
+                        shader = packet.program;
+                        shader->use();
+                        uploadLight(light);
+                    }
+                    if (changes & MATERIAL_CHANGED) {
+                        uploadMaterial(*static_cast<const Material*>(packet.material));
+                    }
+                    shader->setMat4(UNIFORM("M"), *packet.modelMatrix);
+                    // skins carry their character, the skeleton's drawables -1
+                    if (packet.item >= 0 && scene->animated) {
+                        const vector<mat4>& T = frameSnapshot.skinningPalettes[packet.item];
+                        shader->setMat4Array(UNIFORM("boneTransformations"), T.size(), &T[0]);
+                    }
+                });
+            }
+
+            //----------------------------------------------------------------------------------------
+            // first segment
+            useVariant(shaderVariant(0));
+            segment->bind(glState);
+            mat4 bone1 = mat4(1);
+            shader->setMat4(UNIFORM("M"), bone1);
+            // draw segment
+            //segment->draw(GL_LINES);
+            //segment->draw(GL_POINTS);
+            //----------------------------------------------------------------------------------------------
+
+            glState->polygonMode(GL_FILL);
+            //*/
+
+            // the model left of the characters, a size of the grid's cells
+            if (materialModel) {
+                useVariant(shaderVariant(SHADER_MATERIAL_BUFFER));
+                mat4 modelMatrix = translate(mat4(), scene->center - vec3(scene->spacing, 0, 0));
+                shader->setMat4(UNIFORM("M"), scale(modelMatrix, vec3(0.25f * scene->spacing)));
+                materialModel->draw(*shader, eyes);
+            }
+        };
+
+        if (foveationLayout) {
+            // the periphery skips what the insets cover, they are zoomed in
+            // projections of the eyes' centers
+            peripheryTarget->bind();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            clearFoveaDepth();
+            drawScene(cullingFrustum);
+            insetTarget->bind();
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawScene(setEyeProjection(foveationLayout->insetProjection(eyeProjection)));
+            compositeFoveation();
+        } else {
+            if (sceneTarget) {
+                sceneTarget->bind(resolutionController->scaled(W_WIDTH),
+                                  resolutionController->scaled(W_HEIGHT));
+            } else if (eyeTarget) {
+                eyeTarget->bind();
+            }
+            glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+            drawScene(cullingFrustum);
+            if (sceneTarget) {
+                upscaleScene();
+            }
+        }
+        if (eyeTarget) {
+            presentEyes(eyeTarget);
+            renderedView = viewMatrix;
+            renderedProjection = eyeProjection;
+        }
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-        skeletonSkin->draw();
+        if (timed) {
+            frameTimer->endFrame();
+        }
+        if (resolutionController) {
+            const vector<double>& gpuMilliseconds = frameTimer->gpuMilliseconds();
+            for (; resolutionSamples < gpuMilliseconds.size(); resolutionSamples++) {
+                resolutionController->update(gpuMilliseconds[resolutionSamples]);
+            }
+        }
+        if (reprojection) {
+            framePacer->renderMeasured(pacerClock() - drawStart);
+            presentAt(frameVsync);
+            framePacer->presented(frameVsync, false);
+        } else if (!headless) {
+            PROFILE_SCOPE("glfwSwapBuffers");
+            glfwSwapBuffers(window);
+        }
+        latencyTracker->frameSubmitted(prediction);
+        glfwPollEvents();
+        Profiler::collectGpu();
+        frame++;
+    } while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
+        glfwWindowShouldClose(window) == 0 &&
+        !(headless && frame >= headlessFrames));
+    stopSimulation();
 
-        //----------------------------------------------------------------------------------------
-        // first segment
-        segment->bind();
-        mat4 bone1 = mat4(1);
-        glUniformMatrix4fv(modelMatrixLocation, 1, GL_FALSE, &bone1[0][0]);
-        // draw segment
-        //segment->draw(GL_LINES);
-        //segment->draw(GL_POINTS);
-        //----------------------------------------------------------------------------------------------
+    if (headless && !capturePath.empty()) {
+        renderTarget->saveColor(capturePath);
+    }
+    if (resolutionController) {
+        cout << "Dynamic resolution: scale " << resolutionController->scale() << " after "
+            << resolutionController->changes << " changes" << endl;
+    }
+    cout << "Frustum culling: " << skinCulling.visible << " skins drawn, "
+        << skinCulling.culled << " culled; " << skeleton->culling.visible
+        << " skeleton drawables drawn, " << skeleton->culling.culled << " culled" << endl;
+    if (occlusionCuller) {
+        cout << "Occlusion culling: " << occlusionStats.culled << " of "
+            << occlusionStats.visible + occlusionStats.culled << " skins hidden, "
+            << occlusionCuller->occluderTriangles << " occluder triangles a frame" << endl;
+    }
+    if (skeleton->batch) {
+        cout << "Skeleton batch: " << skeleton->batch->drawCalls << " draw calls through "
+            << (skeleton->batch->indirect ? "glMultiDrawElementsIndirect" : "glMultiDrawElements")
+            << endl;
+    }
+    if (renderQueue) {
+        const RenderQueueStats& sorted = renderQueue->submitted;
+        const RenderQueueStats& unsorted = renderQueue->unsorted;
+        cout << "Draw sorting: " << sorted.draws << " draws, program/material/vertex array "
+            << "changes " << sorted.programChanges << "/" << sorted.materialChanges << "/"
+            << sorted.vertexArrayChanges << " sorted, " << unsorted.programChanges << "/"
+            << unsorted.materialChanges << "/" << unsorted.vertexArrayChanges << " as queued"
+            << endl;
+    }
+    if (materialModel) {
+        // uploadMaterial() sets four uniforms a mesh
+        const ogl::MaterialDrawStats& drawn = materialModel->drawStats;
+        cout << "Material buffer: " << drawn.draws << " draws of "
+            << materialModel->meshCount() << " meshes, " << drawn.arrayBinds
+            << " texture array binds, " << drawn.materialChanges
+            << " material index changes, instead of " << 4 * drawn.draws
+            << " material uniforms uploaded" << endl;
+    }
+    if (foveationLayout) {
+        long shaded = foveationLayout->insetPixels() + foveationLayout->peripheryPixels();
+        cout << "Foveation: " << foveationLayout->eyes << " x " << foveationLayout->insetWidth << "x"
+            << foveationLayout->insetHeight << " inset (" << foveationLayout->insetPixels()
+            << " pixels), " << foveationLayout->peripheryWidth << "x"
+            << foveationLayout->peripheryHeight << " periphery ("
+            << foveationLayout->peripheryPixels() << " pixels), " << shaded << " of "
+            << foveationLayout->outputPixels() << " output pixels shaded ("
+            << 100.0 * shaded / foveationLayout->outputPixels() << "%)" << endl;
+    }
+    if (framePacer) {
+        cout << "Reprojection: " << framePacer->renderedFrames << " frames rendered, "
+            << framePacer->reprojectedFrames << " vsyncs filled by reprojection" << endl;
+    }
+    if (headless && eyeTarget && !distortionReferencePath.empty()) {
+        // warp the last frame on the CPU too, the difference is what the mesh
+        // interpolation and the GPU filtering lose
+        vector<unsigned char> eyePixels, reference, warped;
+        eyeTarget->readColor(eyePixels);
+        distortionReference(distortionMesh->lens, distortionMesh->eyes, eyePixels,
+                            W_WIDTH, W_HEIGHT, reference);
+        savePPM(distortionReferencePath, reference, W_WIDTH, W_HEIGHT);
+        renderTarget->readColor(warped);
+        double total = 0;
+        int largest = 0;
+        for (size_t i = 0; i < warped.size(); i++) {
+            if (i % 4 == 3) continue;
+            int difference = abs(warped[i] - reference[i]);
+            total += difference;
+            largest = std::max(largest, difference);
+        }
+        cout << "Distortion mesh of " << distortionMesh->triangleCount()
+            << " triangles against the reference: mean difference "
+            << total / (warped.size() / 4 * 3) << ", largest " << largest << endl;
+    }
+    if (!tracePath.empty()) {
+        // let the last GPU scopes finish
+        glFinish();
+        Profiler::collectGpu();
+        Profiler::writeChromeTrace(tracePath);
+    }
+    latencyTracker->finish();
+    if (!latencyTracker->frames().empty()) {
+        double total = 0;
+        for (const FrameLatency& latency : latencyTracker->frames()) {
+            total += latency.completed;
+        }
+        cout << "Input to completion latency: "
+            << total / latencyTracker->frames().size() << " ms mean" << endl;
+    }
+    if (!latencyPath.empty()) {
+        writeLatencies(latencyPath, latencyTracker->frames());
+    }
+    const GLStateStats& stateStats = glState->stats();
+    cout << "GL state cache: " << stateStats.issued << " calls issued, "
+        << stateStats.skipped << " skipped" << endl;
+    if (frameTimer && !timingsPath.empty()) {
+        frameTimer->finish();
+        writeTimings(timingsPath, {
+            {"scene", scene->name},
+            {"gl calls issued", to_string(stateStats.issued)},
+            {"gl calls skipped", to_string(stateStats.skipped)},
+            {"characters", to_string(characterCount)},
+            {"frames", to_string(frameTimer->cpuMilliseconds().size())},
+            {"resolution", to_string(W_WIDTH) + "x" + to_string(W_HEIGHT)},
+            {"renderer", reinterpret_cast<const char*>(glGetString(GL_RENDERER))},
+            {"version", reinterpret_cast<const char*>(glGetString(GL_VERSION))}},
+            frameTimer->cpuMilliseconds(), frameTimer->gpuMilliseconds());
+    }
+}
+
+/* Warp the eyes through the distortion mesh onto the output */
+void distortionPass(RenderTarget* eyes) {
+    PROFILE_SCOPE("distortion");
+    PROFILE_GPU_SCOPE("distortion");
+    if (headless) {
+        renderTarget->bind();
+    } else {
+        RenderTarget::unbind(W_WIDTH, W_HEIGHT);
+    }
+    // the mesh covers the whole output, no clear or depth needed
+    glDisable(GL_DEPTH_TEST);
+    if (stereo) {
+        glDisable(GL_CLIP_DISTANCE0);
+    }
+    distortionProgram->use();
+    glState->bindTexture(0, GL_TEXTURE_2D, eyes->colorTexture);
+    distortionProgram->setInt(UNIFORM("eyeTexture"), 0);
+    distortionProgram->setFloat(UNIFORM("eyeCount"), static_cast<float>(distortionMesh->eyes));
+    distortionMesh->draw(glState);
+    glEnable(GL_DEPTH_TEST);
+    if (stereo) {
+        glEnable(GL_CLIP_DISTANCE0);
+    }
+}
+
+/* Put rendered eyes on the output, through the distortion pass if enabled */
+void presentEyes(RenderTarget* eyes) {
+    if (distortion) {
+        distortionPass(eyes);
+        return;
+    }
+    eyes->blit(headless ? renderTarget->framebuffer : 0, eyes->width, eyes->height,
+               W_WIDTH, W_HEIGHT);
+}
+
+/* Resolve the samples of the scene and scale it up to the eyes or the output */
+void upscaleScene() {
+    PROFILE_SCOPE("upscale");
+    PROFILE_GPU_SCOPE("upscale");
+    int width = resolutionController->scaled(W_WIDTH);
+    int height = resolutionController->scaled(W_HEIGHT);
+    sceneTarget->blit(resolveTarget->framebuffer, width, height, width, height);
+    GLuint output = eyeTarget ? eyeTarget->framebuffer :
+        headless ? renderTarget->framebuffer : 0;
+    resolveTarget->blit(output, width, height, W_WIDTH, W_HEIGHT, GL_LINEAR);
+}
+
+/**
+* Fill the depth of the periphery under the insets with the near plane, so
+* that the depth test rejects the periphery's fragments there before shading
+*/
+void clearFoveaDepth() {
+    glEnable(GL_SCISSOR_TEST);
+    glClearDepth(0.0);
+    for (int eye = 0; eye < foveationLayout->eyes; eye++) {
+        PixelRect hole = foveationLayout->peripheryHole(eye);
+        if (hole.pixels() > 0) {
+            glScissor(hole.x, hole.y, hole.width, hole.height);
+            glClear(GL_DEPTH_BUFFER_BIT);
+        }
+    }
+    glClearDepth(1.0);
+    glDisable(GL_SCISSOR_TEST);
+}
 
-        glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-        //*/
+/* Scale the periphery up to the eyes or the output and put the insets over it */
+void compositeFoveation() {
+    PROFILE_SCOPE("composite");
+    PROFILE_GPU_SCOPE("composite");
+    GLuint output = eyeTarget ? eyeTarget->framebuffer :
+        headless ? renderTarget->framebuffer : 0;
+    peripheryTarget->blit(output, foveationLayout->peripheryWidth,
+        foveationLayout->peripheryHeight, W_WIDTH, W_HEIGHT, GL_LINEAR);
+    for (int eye = 0; eye < foveationLayout->eyes; eye++) {
+        PixelRect source = foveationLayout->insetSource(eye);
+        PixelRect destination = foveationLayout->inset(eye);
+        insetTarget->blit(output, source.x, source.y, source.width, source.height,
+            destination.x, destination.y, destination.width, destination.height);
+    }
+}
 
+/* Show the output at the vsync, headless runs wait for an emulated one */
+void presentAt(double vsync) {
+    PROFILE_SCOPE("present");
+    if (headless) {
+        this_thread::sleep_until(pacerStart +
+            chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(vsync)));
+    } else {
         glfwSwapBuffers(window);
-        glfwPollEvents();
-    } while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS &&
-        glfwWindowShouldClose(window) == 0);
+    }
+}
+
+/**
+* Wait for the frame's poses (none: already there). Every vsync the frame
+* cannot be drawn for in time gets the last frame reprojected instead.
+*/
+void awaitFrame(future<void>& poses) {
+    PROFILE_SCOPE("awaitFrame");
+    while (true) {
+        bool ready = !poses.valid() ||
+            poses.wait_for(chrono::seconds(0)) == future_status::ready;
+        double now = pacerClock();
+        FrameDecision decision = framePacer->decide(now, ready);
+        if (decision == FRAME_RENDER) {
+            break;
+        } else if (decision == FRAME_REPROJECT) {
+            reprojectLastFrame();
+        } else {
+            poses.wait_for(chrono::duration<double>(framePacer->nextDecision(now) - now));
+        }
+    }
+    if (poses.valid()) {
+        poses.get();
+    }
+}
+
+/* Resample the last frame for the latest head rotation and present it */
+void reprojectLastFrame() {
+    PROFILE_SCOPE("reproject");
+    PROFILE_GPU_SCOPE("reproject");
+    double start = pacerClock();
+    double vsync = framePacer->targetVsync(start);
+    if (!headless && !sessionReplayer) {
+        camera->update();
+    }
+
+    reprojectionTarget->bind();
+    glDisable(GL_DEPTH_TEST);
+    if (stereo) {
+        glDisable(GL_CLIP_DISTANCE0);
+    }
+    reprojectionProgram->use();
+    glState->bindTexture(0, GL_TEXTURE_2D, eyeTarget->colorTexture);
+    reprojectionProgram->setInt(UNIFORM("eyeTexture"), 0);
+    reprojectionProgram->setFloat(UNIFORM("eyeCount"), stereo ? CAMERA_EYES : 1.0f);
+    reprojectionProgram->setMat4(UNIFORM("reprojection"),
+        rotationReprojection(renderedView, camera->viewMatrix, renderedProjection));
+    reprojectionPass->draw(glState);
+    glEnable(GL_DEPTH_TEST);
+    if (stereo) {
+        glEnable(GL_CLIP_DISTANCE0);
+    }
+    presentEyes(reprojectionTarget);
+
+    framePacer->reprojectionMeasured(pacerClock() - start);
+    presentAt(vsync);
+    framePacer->presented(vsync, true);
+}
+
+/* Camera orbiting the scene back and forth, for runs without input */
+void scriptedCamera(float time) {
+    // back off so that the whole character grid stays in view
+    int columns = static_cast<int>(ceil(sqrt(static_cast<float>(characterCount))));
+    vec3 gridCenter = scene->center +
+        vec3(columns - 1, 0.0f, -(columns - 1)) * (0.5f * scene->spacing);
+    float distance = scene->cameraDistance + (columns - 1) * scene->spacing;
+    float angle = 0.5f * sin(0.25f * time);
+    camera->position = gridCenter + distance * vec3(sin(angle), 0.0f, cos(angle));
+    camera->horizontalAngle = angle + 3.14f;
+    camera->verticalAngle = 0.0f;
+    camera->FoV = 45.0f;
+    camera->updateMatrices();
 }
 
 void initialize() {
@@ -503,11 +1534,20 @@ void initialize() {
         throw runtime_error("Failed to initialize GLFW\n");
     }
 
-    glfwWindowHint(GLFW_SAMPLES, 4);
+    // a window that offscreen passes are blitted to can not be multisampled,
+    // the scene target is instead
+    bool offscreen = distortion || reprojection || targetFrameMilliseconds > 0 ||
+        insetFraction > 0;
+    glfwWindowHint(GLFW_SAMPLES, offscreen && !headless ? 0 : 4);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
     glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
     glfwWindowHint(GLFW_OPENGL_FORWARD_COMPAT, GL_TRUE); // To make MacOS happy
     glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
+    // headless runs render into an FBO of a hidden window, this works on
+    // software rasterizers (e.g. Mesa llvmpipe under Xvfb) as well
+    if (headless) {
+        glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    }
 
     // Open a window and create its OpenGL context
     window = glfwCreateWindow(W_WIDTH, W_HEIGHT, TITLE, NULL, NULL);
@@ -527,16 +1567,22 @@ void initialize() {
         glfwTerminate();
         throw runtime_error("Failed to initialize GLEW\n");
     }
+    glReady = true;
 
     // Ensure we can capture the escape key being pressed below
     glfwSetInputMode(window, GLFW_STICKY_KEYS, GL_TRUE);
 
-    // Hide the mouse and enable unlimited movement
-    glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
+    if (headless) {
+        renderTarget = new RenderTarget(W_WIDTH, W_HEIGHT);
+        renderTarget->bind();
+    } else {
+        // Hide the mouse and enable unlimited movement
+        glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED);
 
-    // Set the mouse at the center of the screen
-    glfwPollEvents();
-    glfwSetCursorPos(window, W_WIDTH / 2, W_HEIGHT / 2);
+        // Set the mouse at the center of the screen
+        glfwPollEvents();
+        glfwSetCursorPos(window, W_WIDTH / 2, W_HEIGHT / 2);
+    }
 
     // Gray background color
     glClearColor(0.5f, 0.5f, 0.5f, 0.0f);
@@ -552,23 +1598,173 @@ void initialize() {
     // enable point size when drawing points
     glEnable(GL_PROGRAM_POINT_SIZE);
 
+    // stereo clips each eye at the middle of the target
+    if (stereo) {
+        glEnable(GL_CLIP_DISTANCE0);
+    }
+
     // Log
     logGLParameters();
 
     // Create camera
     camera = new Camera(window);
+    camera->captureCursor = !headless;
+
+    glState = new GLStateCache();
+    cameraBuffer = new CameraUniformBuffer();
+    latencyTracker = new LatencyTracker();
+
+    // dynamic resolution follows the GPU times of the frame timer
+    if (!timingsPath.empty() || targetFrameMilliseconds > 0) {
+        frameTimer = new FrameTimer();
+    }
+}
+
+/**
+* --record <file>     save the session
+* --replay <file>     play a recorded session back
+* --headless          render offscreen with a fixed clock and scripted camera
+* --frames <n>        frames to render in headless mode
+* --capture <file>    save the last headless frame as .ppm
+* --scene <name>      hand or human
+* --characters <n>    characters drawn on a grid
+* --timings <file>    write per frame CPU and GPU times, .json or .csv
+* --warmup <n>        frames run before timing starts
+* --trace <file>      record profiling scopes, written as Chrome trace JSON
+* --simulation-thread simulate on a thread at a fixed rate, the default
+*                     unless headless or recording or replaying a session
+* --inline-simulation simulate every frame on the render thread
+* --latency <file>    write per frame input to completion latencies as .csv
+* --stereo            render both eyes side by side in one instanced pass
+* --distortion        warp the output through a lens distortion mesh
+* --distortion-mesh <n>  quads along each side of an eye's mesh
+* --distortion-reference <file>  save the CPU reference warp of the last
+*                     headless frame as .ppm and compare it to the GPU's
+* --reprojection      pace frames to vsync and fill the vsyncs a frame misses
+*                     with the last frame reprojected for the head rotation
+* --refresh-rate <hz> vsyncs per second for reprojection, e.g. of an
+*                     emulated headless display
+* --spike-every <n>   stall every n-th simulation step, to provoke misses
+* --dynamic-resolution <ms>  scale the render resolution to hold the GPU
+*                     frame time, e.g. 11.1 for 90 Hz
+* --foveation <f>     render the center f of each side of an eye at full
+*                     resolution and the rest at the periphery scale
+* --periphery-scale <s>  resolution of the foveated periphery, 0.5 default
+* --occlusion-culling skip characters hidden behind the others' skins,
+*                     rasterized on the CPU; draws the skins solid
+* --sort-draws        queue the skeleton and skin draws and submit them sorted
+*                     by program, material and vertex array, then depth
+* --batch-skeleton    draw the skeleton's bodies with multi-draw calls, their
+*                     model matrices in a buffer
+* --model <file>      draw an .obj next to the characters, its materials in a
+*                     uniform buffer and its images in texture arrays
+*/
+void parseOptions(int argc, char* argv[]) {
+    for (int i = 1; i < argc; i++) {
+        string option = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (option == "--headless") {
+            headless = true;
+        } else if (option == "--frames" && hasValue) {
+            headlessFrames = stoi(argv[++i]);
+        } else if (option == "--capture" && hasValue) {
+            capturePath = argv[++i];
+        } else if (option == "--record" && hasValue) {
+            recordPath = argv[++i];
+        } else if (option == "--replay" && hasValue) {
+            replayPath = argv[++i];
+        } else if (option == "--scene" && hasValue) {
+            string name = argv[++i];
+            scene = NULL;
+            for (const Scene& s : scenes) {
+                if (s.name == name) scene = &s;
+            }
+            if (scene == NULL) {
+                throw runtime_error("Unknown scene: " + name);
+            }
+        } else if (option == "--characters" && hasValue) {
+            characterCount = std::max(stoi(argv[++i]), 1);
+        } else if (option == "--timings" && hasValue) {
+            timingsPath = argv[++i];
+        } else if (option == "--warmup" && hasValue) {
+            warmupFrames = stoi(argv[++i]);
+        } else if (option == "--simulation-thread") {
+            simulationThreadOption = 1;
+        } else if (option == "--inline-simulation") {
+            simulationThreadOption = 0;
+        } else if (option == "--stereo") {
+            stereo = true;
+        } else if (option == "--reprojection") {
+            reprojection = true;
+        } else if (option == "--spike-every" && hasValue) {
+            spikeInterval = stoi(argv[++i]);
+        } else if (option == "--dynamic-resolution" && hasValue) {
+            targetFrameMilliseconds = stod(argv[++i]);
+        } else if (option == "--occlusion-culling") {
+            occlusionCulling = true;
+        } else if (option == "--sort-draws") {
+            sortDraws = true;
+        } else if (option == "--batch-skeleton") {
+            batchSkeleton = true;
+        } else if (option == "--model" && hasValue) {
+            modelPath = argv[++i];
+        } else if (option == "--foveation" && hasValue) {
+            insetFraction = stof(argv[++i]);
+        } else if (option == "--periphery-scale" && hasValue) {
+            peripheryScale = stof(argv[++i]);
+        } else if (option == "--refresh-rate" && hasValue) {
+            refreshRate = std::max(stod(argv[++i]), 1.0);
+        } else if (option == "--distortion") {
+            distortion = true;
+        } else if (option == "--distortion-mesh" && hasValue) {
+            distortionResolution = std::max(stoi(argv[++i]), 1);
+        } else if (option == "--distortion-reference" && hasValue) {
+            distortionReferencePath = argv[++i];
+        } else if (option == "--latency" && hasValue) {
+            latencyPath = argv[++i];
+        } else if (option == "--trace" && hasValue) {
+            tracePath = argv[++i];
+            Profiler::setEnabled(true);
+            Profiler::setThreadName("main");
+        } else {
+            throw runtime_error("Unknown option: " + option);
+        }
+    }
+    if (insetFraction > 0 && targetFrameMilliseconds > 0) {
+        throw runtime_error("Foveation and dynamic resolution can't be combined");
+    }
+}
+
+void openSession() {
+    if (!recordPath.empty()) {
+        // quantization steps: 0.1 ms, 0.1 mm, 1e-5 rad, 0.001 degrees
+        vector<float> steps = {1e-4f, 1e-4f, 1e-4f, 1e-4f, 1e-5f, 1e-5f, 1e-3f};
+        steps.resize(steps.size() + ikCoordinates.size(), 1e-3f);
+        sessionRecorder = new SessionRecorder(recordPath, steps);
+    }
+    if (!replayPath.empty()) {
+        sessionReplayer = new SessionReplayer(replayPath);
+        if (sessionReplayer->channelCount() != 7 + static_cast<int>(ikCoordinates.size()) ||
+            sessionReplayer->frameCount() == 0) {
+            throw runtime_error("The recording does not match this scene");
+        }
+    }
 }
 
-int main(void) {
+int main(int argc, char* argv[]) {
     try {
+        parseOptions(argc, argv);
         initialize();
         createContext();
+        openSession();
         mainLoop();
         free();
     }
     catch (exception& ex) {
         cout << ex.what() << endl;
-        getchar();
+        if (!headless) {
+            getchar();
+        }
         free();
         return -1;
     }
@@ -0,0 +1,129 @@
+#include <cmath>
+#include <cstdio>
+#include <string>
+#include "common/bvh.h"
+#include "tests/check.h"
+
+using namespace std;
+
+static const char* PATH = "bvh_test.bvh";
+
+static const char* HIERARCHY =
+    "HIERARCHY\n"
+    "ROOT Hips\n"
+    "{\n"
+    "  OFFSET 0.0 0.0 0.0\n"
+    "  CHANNELS 6 Xposition Yposition Zposition Zrotation Xrotation Yrotation\n"
+    "  JOINT Chest\n"
+    "  {\n"
+    "    OFFSET 0.0 10.0 -1.5\n"
+    "    CHANNELS 3 Zrotation Xrotation Yrotation\n"
+    "    End Site\n"
+    "    {\n"
+    "      OFFSET 0.0 5.0 0.0\n"
+    "    }\n"
+    "  }\n"
+    "}\n";
+
+static const int FRAMES = 150, CHANNELS = 9;
+
+/* Frame values that name their frame and channel, the Chest's Yrotation
+ * jumping across +-180 degrees every frame */
+static float channelValue(int f, int c) {
+    if (c == 8) return f % 2 == 0 ? 170.0f : -170.0f;
+    return f * 10.0f + c;
+}
+
+static void writeFile(const string& text) {
+    FILE* file = fopen(PATH, "wb");
+    fwrite(text.data(), 1, text.size(), file);
+    fclose(file);
+}
+
+static void writeClip() {
+    string text = string(HIERARCHY) + "MOTION\nFrames: " + to_string(FRAMES) +
+        "\nFrame Time: 0.1\n";
+    char value[32];
+    for (int f = 0; f < FRAMES; f++) {
+        for (int c = 0; c < CHANNELS; c++) {
+            snprintf(value, sizeof(value), c ? " %g" : "%g", channelValue(f, c));
+            text += value;
+        }
+        text += "\r\n";
+    }
+    writeFile(text);
+}
+
+static void testHierarchy() {
+    BVHClip clip(PATH);
+    CHECK(clip.joints.size() == 3);
+    CHECK(clip.channelCount == CHANNELS);
+    CHECK(clip.frameCount == FRAMES);
+    CHECK(fabs(clip.frameTime - 0.1f) < 1e-6f);
+    CHECK(clip.joints[0].name == "Hips" && clip.joints[0].parent == -1);
+    CHECK(clip.joints[1].name == "Chest" && clip.joints[1].parent == 0);
+    CHECK(clip.joints[2].name == "Chest_end" && clip.joints[2].parent == 1);
+    CHECK(clip.joints[2].endSite && clip.joints[2].channels.empty());
+    CHECK(clip.joints[0].firstChannel == 0 && clip.joints[1].firstChannel == 6);
+    CHECK(clip.joints[1].channels[0] == ZROTATION && clip.joints[1].channels[2] == YROTATION);
+    CHECK(clip.joints[1].offset == glm::vec3(0.0f, 10.0f, -1.5f));
+    CHECK(clip.findJoint("Chest") == 1 && clip.findJoint("Neck") == -1);
+}
+
+/* A small window makes reads far ahead and behind seek through checkpoints */
+static void testFrames() {
+    BVHClip clip(PATH, 4);
+    for (int f : {0, 1, 2, 3, 4, 5, 100, 10, 149, 63, 64, 65, 0, 128, 127, 130}) {
+        const float* values = clip.frame(f);
+        bool equal = true;
+        for (int c = 0; c < CHANNELS; c++) {
+            equal &= values[c] == channelValue(f, c);
+        }
+        CHECK(equal);
+    }
+    CHECK_THROWS(clip.frame(-1));
+    CHECK_THROWS(clip.frame(FRAMES));
+}
+
+static void testSample() {
+    BVHClip clip(PATH, 4);
+    const vector<BVHChannelMapping> mapping = {
+        {"Hips", XPOSITION, 0, 0.5f},
+        {"Chest", YROTATION, 1, 1.0f},
+        {"Chest", XROTATION, 2, -1.0f}
+    };
+    map<int, float> q;
+    // halfway between frames 0 and 1, and the same time a loop later
+    for (float time : {0.05f, FRAMES * 0.1f + 0.05f}) {
+        clip.sampleCoordinates(time, mapping, q);
+        CHECK(fabs(q[0] - 2.5f) < 1e-3f);
+        // 170 to -170 goes through 180, not through 0
+        CHECK(fabs(fabs(q[1]) - 180.0f) < 1e-3f);
+        CHECK(fabs(q[2] + 12.0f) < 1e-3f);
+    }
+    // the last frame interpolates towards the first
+    clip.sampleCoordinates((FRAMES - 0.5f) * 0.1f, mapping, q);
+    CHECK(fabs(q[0] - 0.5f * 0.5f * channelValue(FRAMES - 1, 0)) < 1e-2f);
+    CHECK_THROWS(clip.sampleCoordinates(0.0f, {{"Neck", XROTATION, 0, 1.0f}}, q));
+}
+
+static void testInvalid() {
+    const string motion = "MOTION\nFrames: 1\nFrame Time: 0.1\n0\n";
+    writeFile("HIERARCHY\nROOT Hips\n{\n  OFFSET 0 0 0\n  CHANNELS 1 Xposition\n}\n"
+              "End Site\n{\n  OFFSET 0 1 0\n}\n" + motion);
+    CHECK_THROWS(BVHClip clip(PATH));
+    writeFile("HIERARCHY\nROOT Hips\n{\n  OFFSET 0 0 0\n  CHANNELS 0\n}\n" + motion);
+    CHECK_THROWS(BVHClip clip(PATH));
+    writeFile("HIERARCHY\nROOT Hips\n{\n  OFFSET 0 0 0\n  CHANNELS 1 Xposition\n" + motion);
+    CHECK_THROWS(BVHClip clip(PATH));
+}
+
+int main() {
+    writeClip();
+    testHierarchy();
+    testFrames();
+    testSample();
+    testInvalid();
+    remove(PATH);
+    return CHECK_RESULT();
+}
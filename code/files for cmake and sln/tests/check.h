@@ -0,0 +1,36 @@
+#ifndef CHECK_H
+#define CHECK_H
+
+#include <iostream>
+#include <exception>
+
+/**
+* Minimal assertions for the tests: a failed CHECK prints the expression and
+* its line and counts as a failure, main() returns CHECK_RESULT() so that
+* ctest sees the failures through the exit code.
+*/
+static int checkFailures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": failed " << #condition \
+                      << std::endl; \
+            checkFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_THROWS(statement) \
+    do { \
+        bool thrown = false; \
+        try { statement; } catch (const std::exception&) { thrown = true; } \
+        if (!thrown) { \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": did not throw " << #statement \
+                      << std::endl; \
+            checkFailures++; \
+        } \
+    } while (0)
+
+#define CHECK_RESULT() (checkFailures == 0 ? 0 : 1)
+
+#endif
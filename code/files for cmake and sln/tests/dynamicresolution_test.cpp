@@ -0,0 +1,92 @@
+#include <cmath>
+#include "common/dynamicresolution.h"
+#include "tests/check.h"
+
+using namespace std;
+
+static bool near(float a, float b) {
+    return fabs(a - b) < 1e-5f;
+}
+
+/* Feed the same time for a number of frames, returns the last scale */
+static float feed(ResolutionController& controller, double milliseconds, int frames) {
+    float scale = controller.scale();
+    for (int i = 0; i < frames; i++) {
+        scale = controller.update(milliseconds);
+    }
+    return scale;
+}
+
+/* Frames over budget drop the scale after dropFrames, aiming below the target */
+static void testDrop() {
+    ResolutionController controller(10.0);
+    CHECK(controller.scale() == 1.0f);
+    CHECK(feed(controller, 20.0, controller.dropFrames - 1) == 1.0f);
+    float expected = static_cast<float>(sqrt(10.0 * (1.0 - 0.5 * controller.headroom) / 20.0));
+    CHECK(near(controller.update(20.0), expected));
+    CHECK(controller.changes == 1);
+
+    // the times of the frames in flight are ignored, whatever they are
+    CHECK(near(feed(controller, 100.0, controller.settleFrames), expected));
+    CHECK(controller.changes == 1);
+}
+
+/* Times within the headroom around the target change nothing */
+static void testHeadroom() {
+    ResolutionController controller(10.0);
+    controller.update(20.0);
+    float scale = controller.update(20.0);
+    feed(controller, 10.0, controller.settleFrames);
+    for (int i = 0; i < 200; i++) {
+        controller.update(i % 2 ? 10.9 : 9.1);
+    }
+    CHECK(controller.scale() == scale);
+    CHECK(controller.changes == 1);
+}
+
+/* Frames under budget raise the scale after raiseFrames, by maxRaise at most */
+static void testRaise() {
+    ResolutionController controller(10.0);
+    feed(controller, 20.0, controller.dropFrames);
+    float scale = feed(controller, 10.0, controller.settleFrames);
+    CHECK(feed(controller, 2.0, controller.raiseFrames - 1) == scale);
+    CHECK(near(controller.update(2.0), scale + controller.maxRaise));
+    CHECK(controller.changes == 2);
+}
+
+/* The scale stays within its bounds, a raise at the top changes nothing */
+static void testClamp() {
+    ResolutionController controller(10.0, 0.5f, 1.0f);
+    CHECK(feed(controller, 2.0, controller.raiseFrames) == 1.0f);
+    CHECK(controller.changes == 0);
+    CHECK(feed(controller, 1000.0, controller.dropFrames) == 0.5f);
+    CHECK(controller.changes == 1);
+    CHECK(controller.scaled(1024) == 512 && controller.scaled(1) == 1);
+    feed(controller, 1000.0, controller.settleFrames);
+    CHECK(feed(controller, 1000.0, 10 * controller.dropFrames) == 0.5f);
+    CHECK(controller.changes == 1);
+}
+
+/* Missing times, e.g. a timer query without a result, are ignored */
+static void testZeroTime() {
+    ResolutionController controller(10.0);
+    feed(controller, 20.0, controller.dropFrames);
+    float scale = feed(controller, 10.0, controller.settleFrames);
+    CHECK(feed(controller, 0.0, 10 * controller.raiseFrames) == scale);
+    CHECK(controller.update(-1.0) == scale && controller.update(NAN) == scale);
+    CHECK(controller.changes == 1);
+
+    // nor do they break up a run of frames under budget
+    feed(controller, 2.0, controller.raiseFrames - 1);
+    controller.update(0.0);
+    CHECK(near(controller.update(2.0), scale + controller.maxRaise));
+}
+
+int main() {
+    testDrop();
+    testHeadroom();
+    testRaise();
+    testClamp();
+    testZeroTime();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,120 @@
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+#include "common/frustum.h"
+#include "common/skinbounds.h"
+#include "tests/check.h"
+
+using namespace glm;
+using namespace std;
+
+static mt19937 generator(1);
+static uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+
+static vec3 randomVector() {
+    return vec3(uniform(generator), uniform(generator), uniform(generator));
+}
+
+static mat4 viewProjection() {
+    return perspective(radians(45.0f), 1.3f, 0.1f, 100.0f) *
+        lookAt(vec3(0.0f, 0.0f, 5.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+}
+
+/* A rigid bone transformation with some scale, as in a skinning palette */
+static mat4 randomBone() {
+    return translate(mat4(), randomVector() * 6.0f) *
+        rotate(mat4(), 3.0f * uniform(generator), normalize(randomVector() + vec3(0.01f))) *
+        scale(mat4(), vec3(1.5f));
+}
+
+/* The batch test agrees with the test of one sphere, also past a multiple of four */
+static void testSphereBatch() {
+    Frustum frustum(viewProjection());
+    vector<BoundingSphere> spheres(1003);
+    for (BoundingSphere& sphere : spheres) {
+        sphere.center = randomVector() * 8.0f;
+        sphere.radius = 0.5f * (uniform(generator) + 1.0f);
+    }
+    // a point on the near plane, a sphere behind it and one reaching through
+    spheres[0] = {vec3(0.0f, 0.0f, 4.9f), 0.0f};
+    spheres[1] = {vec3(0.0f, 0.0f, 5.5f), 0.4f};
+    spheres[2] = {vec3(0.0f, 0.0f, 5.5f), 0.7f};
+
+    vector<unsigned char> visible(spheres.size(), 2);
+    int visibleCount = frustum.intersects(&spheres[0], static_cast<int>(spheres.size()),
+                                          &visible[0]);
+    int expectedCount = 0;
+    for (size_t i = 0; i < spheres.size(); i++) {
+        bool expected = frustum.intersects(spheres[i]);
+        CHECK(visible[i] == (expected ? 1 : 0));
+        expectedCount += expected;
+    }
+    CHECK(visibleCount == expectedCount);
+    CHECK(visibleCount > 0 && visibleCount < static_cast<int>(spheres.size()));
+    CHECK(!visible[1] && visible[2]);
+}
+
+/* Bounds moved by a bone hold the points moved by it */
+static void testMovedBounds() {
+    for (int t = 0; t < 1000; t++) {
+        vector<vec3> points(20);
+        for (vec3& p : points) p = randomVector();
+        BoundingSphere sphere = boundingSphere(points);
+        BoundingBox box = boundingBox(points);
+        mat4 bone = randomBone();
+        BoundingSphere movedSphere = transformBounds(sphere, bone);
+        BoundingBox movedBox = transformBounds(box, bone);
+        for (const vec3& p : points) {
+            vec3 q = vec3(bone * vec4(p, 1.0f));
+            CHECK(distance(q, movedSphere.center) <= movedSphere.radius + 1e-4f);
+            CHECK(all(greaterThanEqual(q, movedBox.lower - vec3(1e-4f))));
+            CHECK(all(lessThanEqual(q, movedBox.upper + vec3(1e-4f))));
+        }
+    }
+}
+
+/* A skin with a vertex in view is never culled, and skins out of view are */
+static void testSkinBounds() {
+    mat4 vp = viewProjection();
+    Frustum frustum(vp);
+    CullingStats stats;
+    int culled = 0;
+    const int skins = 2000, vertices = 20, bones = 3;
+    for (int t = 0; t < skins; t++) {
+        vector<vec3> points(vertices);
+        vector<float> boneIndices(vertices);
+        for (int i = 0; i < vertices; i++) {
+            points[i] = randomVector();
+            boneIndices[i] = static_cast<float>(i % bones);
+        }
+        vector<mat4> palette(bones);
+        for (mat4& bone : palette) bone = randomBone();
+        mat4 modelMatrix = translate(mat4(), vec3(0.0f, 0.0f, uniform(generator)));
+
+        SkinBounds skinBounds(points, boneIndices);
+        bool visible = skinBounds.visible(frustum, palette, modelMatrix, &stats);
+        bool vertexInView = false;
+        for (int i = 0; i < vertices; i++) {
+            vec4 clip = vp * modelMatrix * palette[i % bones] * vec4(points[i], 1.0f);
+            vertexInView |= abs(clip.x) <= clip.w && abs(clip.y) <= clip.w &&
+                abs(clip.z) <= clip.w;
+        }
+        CHECK(visible || !vertexInView);
+        culled += !visible;
+    }
+    CHECK(culled > 0);
+    CHECK(stats.culled == culled && stats.visible == skins - culled);
+
+    // the bind pose, without a palette
+    vector<vec3> points = {vec3(-0.1f), vec3(0.1f)};
+    SkinBounds bindPose(points, vector<float>(2, 0.0f));
+    CHECK(bindPose.visible(frustum, vector<mat4>(), mat4()));
+    mat4 behindEye = translate(mat4(), vec3(0.0f, 0.0f, 10.0f));
+    CHECK(!bindPose.visible(frustum, vector<mat4>(), behindEye));
+}
+
+int main() {
+    testSphereBatch();
+    testMovedBounds();
+    testSkinBounds();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,168 @@
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <glm/gtc/constants.hpp>
+#include "common/ik.h"
+#include "tests/check.h"
+
+using namespace glm;
+using namespace std;
+
+static mt19937 generator(3);
+static uniform_real_distribution<float> uniform(0.0f, 1.0f);
+
+/* A finger like chain of hinges bending one way, its first coordinate first */
+static IKChain fingerChain(int firstCoordinate, int hinges) {
+    IKChain chain;
+    const float lengths[] = {1.0f, 0.8f, 0.6f, 0.4f};
+    vec2 joint(0.0f);
+    chain.joints.push_back(joint);
+    for (int k = 0; k < hinges; k++) {
+        joint.x += lengths[k];
+        chain.joints.push_back(joint);
+        chain.coordinates.push_back(firstCoordinate + k);
+        chain.limits.push_back(vec2(-20.0f, 110.0f));
+    }
+    return chain;
+}
+
+/* End effector of the chain at the angles (degrees), in double precision */
+static dvec2 endEffector(const IKChain& chain, const vector<double>& angles) {
+    dvec2 p(chain.joints[0]);
+    double accumulated = 0.0;
+    for (size_t k = 0; k < angles.size(); k++) {
+        accumulated += angles[k] * pi<double>() / 180.0;
+        dvec2 segment(chain.joints[k + 1] - chain.joints[k]);
+        p += dvec2(cos(accumulated) * segment.x - sin(accumulated) * segment.y,
+                   sin(accumulated) * segment.x + cos(accumulated) * segment.y);
+    }
+    return p;
+}
+
+static vector<double> angles(const IKChain& chain, map<int, float>& q) {
+    vector<double> result;
+    for (int c : chain.coordinates) result.push_back(q[c]);
+    return result;
+}
+
+/**
+* The solver's algorithm in double precision: CCD sweeps from the tip over
+* batches of four chains, a chain freezing once within tolerance and a batch
+* stopping when all its chains are
+*/
+static void referenceSolve(const vector<IKChain>& chains, const vector<vec2>& targets,
+                           map<int, float>& q, float tolerance, int maxIterations) {
+    for (size_t first = 0; first < chains.size(); first += 4) {
+        size_t last = std::min(first + 4, chains.size());
+        vector<vector<double> > a;
+        for (size_t i = first; i < last; i++) {
+            a.push_back(angles(chains[i], q));
+            for (size_t k = 0; k < a.back().size(); k++) {
+                a.back()[k] = std::min(std::max(a.back()[k], double(chains[i].limits[k].x)),
+                                       double(chains[i].limits[k].y));
+            }
+        }
+        for (int iteration = 0; iteration < maxIterations; iteration++) {
+            bool allDone = true;
+            for (size_t i = first; i < last; i++) {
+                const IKChain& chain = chains[i];
+                vector<double>& angle = a[i - first];
+                dvec2 target(targets[i]);
+                if (length(endEffector(chain, angle) - target) < tolerance) continue;
+                allDone = false;
+                for (int k = static_cast<int>(angle.size()) - 1; k >= 0; k--) {
+                    vector<double> base(angle.begin(), angle.begin() + k);
+                    IKChain head = chain;
+                    head.joints.resize(k + 1);
+                    dvec2 pivot = endEffector(head, base);
+                    dvec2 u = endEffector(chain, angle) - pivot, v = target - pivot;
+                    double delta = atan2(u.x * v.y - u.y * v.x, dot(u, v)) * 180.0 / pi<double>();
+                    angle[k] = std::min(std::max(angle[k] + delta, double(chain.limits[k].x)),
+                                        double(chain.limits[k].y));
+                }
+            }
+            if (allDone) break;
+        }
+        for (size_t i = first; i < last; i++) {
+            for (size_t k = 0; k < a[i - first].size(); k++) {
+                q[chains[i].coordinates[k]] = static_cast<float>(a[i - first][k]);
+            }
+        }
+    }
+}
+
+/**
+* Reachable targets, placed by curling the fingers evenly, converge for chains
+* of every length and past a batch of four, and the angles match the
+* reference, so the SSE and scalar builds agree. CCD converges slowly near
+* the target, hence the loose tolerance and the extra sweeps.
+*/
+static void testReachable() {
+    const float tolerance = 1e-2f;
+    const int maxIterations = 64;
+    IKSolver solver;
+    vector<IKChain> chains;
+    vector<vec2> targets;
+    for (int i = 0; i < 11; i++) {
+        IKChain chain = fingerChain(i * IKSolver::MAX_CHAIN_JOINTS, 2 + i % 3);
+        vector<double> pose(chain.coordinates.size(), 10.0f + 50.0f * uniform(generator));
+        targets.push_back(vec2(endEffector(chain, pose)));
+        CHECK(solver.addChain(chain) == i);
+        solver.setTarget(i, targets.back());
+        chains.push_back(chain);
+    }
+    CHECK(solver.chainCount() == 11);
+
+    map<int, float> q, expected;
+    IKStats stats = solver.solve(q, 1e6f, tolerance, maxIterations);
+    referenceSolve(chains, targets, expected, tolerance, maxIterations);
+    CHECK(stats.converged == 11);
+    CHECK(stats.maxError < tolerance);
+    for (size_t i = 0; i < chains.size(); i++) {
+        dvec2 reached = endEffector(chains[i], angles(chains[i], q));
+        CHECK(length(reached - dvec2(targets[i])) < 2.0 * tolerance);
+        for (int c : chains[i].coordinates) {
+            CHECK(fabs(q[c] - expected[c]) < 0.5f);
+        }
+    }
+}
+
+/* Targets out of the hinges' range leave every angle at its limits */
+static void testLimits() {
+    IKSolver solver;
+    IKChain chain = fingerChain(0, 3);
+    chain.limits.assign(3, vec2(0.0f, 30.0f));
+    solver.addChain(chain);
+    solver.setTarget(0, vec2(0.5f, -1.5f));  // needs bending the other way
+    map<int, float> q = {{0, 80.0f}, {1, -45.0f}, {2, 10.0f}};
+    IKStats stats = solver.solve(q, 1e6f);
+    CHECK(stats.converged == 0 && stats.maxError > 0.1f);
+    for (int c = 0; c < 3; c++) {
+        CHECK(q[c] >= -1e-3f && q[c] <= 30.0f + 1e-3f);
+    }
+    CHECK_THROWS(solver.addChain(IKChain()));
+}
+
+/* A spent budget stops after the first sweep, and the timing is reported */
+static void testBudget() {
+    IKSolver solver;
+    for (int i = 0; i < 256; i++) {
+        solver.addChain(fingerChain(i * IKSolver::MAX_CHAIN_JOINTS, 3));
+        solver.setTarget(i, vec2(1.2f, 1.0f + uniform(generator)));
+    }
+    map<int, float> q;
+    IKStats stats = solver.solve(q, -1.0f);
+    CHECK(stats.iterations == 1);
+
+    q.clear();
+    stats = solver.solve(q);
+    printf("256 chains in the default budget: %d sweeps, %d converged, max error %g, %.4f ms\n",
+           stats.iterations, stats.converged, stats.maxError, stats.milliseconds);
+}
+
+int main() {
+    testReachable();
+    testLimits();
+    testBudget();
+    return CHECK_RESULT();
+}
@@ -0,0 +1,118 @@
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "common/model.h"
+#include "tests/check.h"
+
+using namespace std;
+using namespace ogl;
+
+static const char* RED_PATH = "model_test_red.tga";
+static const char* GREEN_PATH = "model_test_green.tga";
+static const char* GREY_PATH = "model_test_grey.tga";
+
+/* An uncompressed TGA of one value, 3 channels of BGR or 1 of grey */
+static void writeImage(const char* path, int size, int channels, const unsigned char* value) {
+    unsigned char header[18] = {0, 0, static_cast<unsigned char>(channels == 3 ? 2 : 3)};
+    header[12] = static_cast<unsigned char>(size);
+    header[14] = static_cast<unsigned char>(size);
+    header[16] = static_cast<unsigned char>(channels * 8);
+    FILE* file = fopen(path, "wb");
+    fwrite(header, 1, sizeof(header), file);
+    for (int i = 0; i < size * size; i++) {
+        fwrite(value, 1, channels, file);
+    }
+    fclose(file);
+}
+
+static tinyobj::material_t material(float diffuse, const string& diffuseImage,
+                                    const string& specularImage) {
+    tinyobj::material_t m = tinyobj::material_t();
+    m.ambient[0] = 0.1f;
+    m.diffuse[0] = m.diffuse[1] = m.diffuse[2] = diffuse;
+    m.specular[2] = 0.5f;
+    m.shininess = 20.0f;
+    m.diffuse_texname = diffuseImage;
+    m.specular_texname = specularImage;
+    return m;
+}
+
+static bool equal(const TextureLayer& layer, int array, int index) {
+    return layer.array == array && layer.layer == index;
+}
+
+/**
+* Images of one size and format share an array, each material keeps its
+* layers, and one without images and the last, for none, have {-1, -1}
+*/
+static void testPack() {
+    vector<tinyobj::material_t> materials = {
+        material(1.0f, RED_PATH, ""),
+        material(0.8f, GREEN_PATH, GREY_PATH),
+        material(0.6f, "", ""),
+        material(0.4f, RED_PATH, GREY_PATH)
+    };
+    TextureArrays textureArrays;
+    vector<TextureLayer> diffuseLayers, specularLayers;
+    vector<PackedMaterial> packed = packMaterials(materials, textureArrays, diffuseLayers,
+                                                  specularLayers);
+    CHECK(packed.size() == 5 && diffuseLayers.size() == 5 && specularLayers.size() == 5);
+    CHECK(textureArrays.arrayCount() == 2);
+
+    CHECK(equal(diffuseLayers[0], 0, 0) && equal(specularLayers[0], -1, -1));
+    CHECK(equal(diffuseLayers[1], 0, 1) && equal(specularLayers[1], 1, 0));
+    CHECK(equal(diffuseLayers[2], -1, -1) && equal(specularLayers[2], -1, -1));
+    CHECK(equal(diffuseLayers[3], 0, 0) && equal(specularLayers[3], 1, 0));
+    CHECK(equal(diffuseLayers[4], -1, -1) && equal(specularLayers[4], -1, -1));
+
+    for (size_t i = 0; i < materials.size(); i++) {
+        CHECK(packed[i].Ka == glm::vec4(0.1f, 0.0f, 0.0f, 1.0f));
+        CHECK(packed[i].Kd == glm::vec4(glm::vec3(materials[i].diffuse[0]), 1.0f));
+        CHECK(packed[i].Ks == glm::vec4(0.0f, 0.0f, 0.5f, 1.0f));
+        CHECK(packed[i].Ns == 20.0f);
+        CHECK(packed[i].diffuseLayer == diffuseLayers[i].layer);
+        CHECK(packed[i].specularLayer == specularLayers[i].layer);
+    }
+    CHECK(packed[2].diffuseLayer == -1.0f && packed[2].specularLayer == -1.0f);
+    CHECK(packed[4].Kd == glm::vec4(0.0f) && packed[4].Ns == 0.0f);
+    CHECK(packed[4].diffuseLayer == -1.0f && packed[4].specularLayer == -1.0f);
+}
+
+/* The materials and the one for none fill the buffer at most */
+static void testCapacity() {
+    TextureArrays textureArrays;
+    vector<TextureLayer> diffuseLayers, specularLayers;
+    vector<tinyobj::material_t> materials(MATERIAL_BUFFER_CAPACITY - 1,
+                                          material(1.0f, "", ""));
+    CHECK(packMaterials(materials, textureArrays, diffuseLayers, specularLayers).size() ==
+          static_cast<size_t>(MATERIAL_BUFFER_CAPACITY));
+
+    materials.push_back(material(1.0f, "", ""));
+    diffuseLayers.clear();
+    specularLayers.clear();
+    CHECK_THROWS(packMaterials(materials, textureArrays, diffuseLayers, specularLayers));
+    materials.resize(300, material(1.0f, "", ""));
+    CHECK_THROWS(packMaterials(materials, textureArrays, diffuseLayers, specularLayers));
+}
+
+/* Missing images throw like the per-image textures do */
+static void testMissingImage() {
+    TextureArrays textureArrays;
+    vector<TextureLayer> diffuseLayers, specularLayers;
+    vector<tinyobj::material_t> materials = {material(1.0f, "model_test_missing.tga", "")};
+    CHECK_THROWS(packMaterials(materials, textureArrays, diffuseLayers, specularLayers));
+}
+
+int main() {
+    const unsigned char red[3] = {0, 0, 255}, green[3] = {0, 255, 0}, grey[1] = {128};
+    writeImage(RED_PATH, 4, 3, red);
+    writeImage(GREEN_PATH, 4, 3, green);
+    writeImage(GREY_PATH, 2, 1, grey);
+    testPack();
+    testCapacity();
+    testMissingImage();
+    remove(RED_PATH);
+    remove(GREEN_PATH);
+    remove(GREY_PATH);
+    return CHECK_RESULT();
+}
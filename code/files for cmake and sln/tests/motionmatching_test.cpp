@@ -0,0 +1,148 @@
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <random>
+#include "common/motionmatching.h"
+#include "tests/check.h"
+
+using namespace std;
+
+static const char* PATH = "motionmatching_test.features";
+
+/**
+* Features of a long synthetic take: every dimension mixes a few shared
+* rhythms (gait, breathing, turning) with its own phases and some noise, so
+* the frames lie near a low dimensional manifold like mocap features do.
+*/
+static vector<float> syntheticFeatures(int frames, int dimension) {
+    mt19937 random(7);
+    uniform_real_distribution<float> uniform(0.0f, 1.0f);
+    normal_distribution<float> noise(0.0f, 0.05f);
+    const float rhythms[] = {0.21f, 0.034f, 0.0071f, 0.0013f};
+    vector<float> amplitude(dimension * 4), phase(dimension * 4);
+    for (size_t i = 0; i < amplitude.size(); i++) {
+        amplitude[i] = uniform(random);
+        phase[i] = 6.2832f * uniform(random);
+    }
+    vector<float> features(frames * dimension);
+    for (int f = 0; f < frames; f++) {
+        for (int d = 0; d < dimension; d++) {
+            float x = noise(random);
+            for (int k = 0; k < 4; k++) {
+                x += amplitude[d * 4 + k] * sin(rhythms[k] * f + phase[d * 4 + k]);
+            }
+            features[f * dimension + d] = x;
+        }
+    }
+    return features;
+}
+
+static double millisecondsSince(chrono::steady_clock::time_point start) {
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+/**
+* Time the exact, bounded and brute force searches of the queries and print
+* how near the bounded one gets. Times are only printed, the checks are that
+* the exact search finds the nearest frame and that a bounded search is never
+* nearer than that, nor farther than with fewer leaves.
+*/
+static void measure(const char* name, const MotionDatabase& database,
+                    const vector<vector<float> >& queries, int maxLeaves) {
+    int n = static_cast<int>(queries.size());
+    vector<float> exactCost(n), boundedCost(n);
+    int exactMatches = 0, boundedMatches = 0;
+    auto start = chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        database.search(queries[i], &exactCost[i]);
+    }
+    double exactTime = millisecondsSince(start) / n;
+    start = chrono::steady_clock::now();
+    for (int i = 0; i < n; i++) {
+        CHECK(database.search(queries[i], &boundedCost[i], maxLeaves) >= 0);
+    }
+    double boundedTime = millisecondsSince(start) / n;
+    for (int i = 0; i < n; i++) {
+        // the leaves of a smaller budget are the first ones of a larger one
+        float fewerCost;
+        database.search(queries[i], &fewerCost, maxLeaves / 2);
+        CHECK(boundedCost[i] <= fewerCost);
+    }
+    start = chrono::steady_clock::now();
+    double distanceRatio = 0.0;
+    for (int i = 0; i < n; i++) {
+        float cost;
+        database.searchBruteForce(queries[i], &cost);
+        exactMatches += cost == exactCost[i];
+        boundedMatches += cost == boundedCost[i];
+        CHECK(boundedCost[i] >= cost);
+        distanceRatio += sqrt(boundedCost[i] / std::max(cost, 1e-12f));
+    }
+    double bruteForceTime = millisecondsSince(start) / n;
+    CHECK(exactMatches == n);
+
+    printf("%s queries, ms per search: exact %.4f, %d leaves %.4f, brute force %.4f; "
+           "%d leaves found %d of %d nearest, at %.3f times their distance\n", name,
+           exactTime, maxLeaves, boundedTime, bruteForceTime, maxLeaves, boundedMatches, n,
+           distanceRatio / n);
+}
+
+int main() {
+    // two joints and three trajectory samples, 24 dimensions
+    MotionFeatureLayout layout = {0, {1, 2}, {10, 20, 30}};
+    const int frames = 120000, queries = 500, maxLeaves = 8;
+
+    MotionDatabase empty(layout);
+    vector<float> query(empty.dimensions(), 0.0f);
+    CHECK(empty.search(query) == -1);
+    CHECK(empty.searchBruteForce(query) == -1);
+
+    MotionDatabase database(layout);
+    vector<float> features = syntheticFeatures(frames, database.dimensions());
+    database.addFeatures(&features[0], frames);
+    database.saveFeatures(PATH);
+    database.build();
+    CHECK(database.frameCount() == frames);
+
+    MotionDatabase loaded(layout);
+    CHECK(loaded.loadFeatures(PATH));
+    CHECK(loaded.frameCount() == frames);
+    CHECK(loaded.getFeatures(frames - 1) == database.getFeatures(frames - 1));
+    MotionDatabase narrower({0, {1}, {10}});
+    CHECK(!narrower.loadFeatures(PATH));
+    remove(PATH);
+
+    query.assign(database.dimensions(), numeric_limits<float>::quiet_NaN());
+    CHECK(database.search(query) == -1);
+    CHECK(database.search(query, NULL, maxLeaves) == -1);
+    CHECK(database.searchBruteForce(query) == -1);
+
+    // queries near the take, perturbed like a steered trajectory, and queries
+    // between two frames of it, which the exact search prunes badly
+    mt19937 random(11);
+    uniform_int_distribution<int> frame(0, frames - 1);
+    normal_distribution<float> steer(0.0f, 0.2f);
+    vector<vector<float> > nearQueries(queries), betweenQueries(queries);
+    for (int i = 0; i < queries; i++) {
+        nearQueries[i] = database.getFeatures(frame(random));
+        betweenQueries[i] = database.getFeatures(frame(random));
+        vector<float> other = database.getFeatures(frame(random));
+        for (int d = 0; d < database.dimensions(); d++) {
+            nearQueries[i][d] += steer(random);
+            betweenQueries[i][d] = 0.5f * (betweenQueries[i][d] + other[d]) + steer(random);
+        }
+    }
+    // a frame of the take is found by the first leaf visited
+    for (int i = 0; i < 100; i++) {
+        float cost;
+        int f = frame(random);
+        CHECK(database.search(database.getFeatures(f), &cost, 1) >= 0);
+        CHECK(cost == 0.0f);
+    }
+
+    printf("%d frames of %d dimensions\n", frames, database.dimensions());
+    measure("near", database, nearQueries, maxLeaves);
+    measure("between", database, betweenQueries, maxLeaves);
+    return CHECK_RESULT();
+}
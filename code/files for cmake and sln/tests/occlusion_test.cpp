@@ -0,0 +1,106 @@
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+#include "common/occlusion.h"
+#include "tests/check.h"
+
+using namespace glm;
+using namespace std;
+
+static const vec3 EYE(0.0f, 0.0f, 5.0f);
+
+static mat4 viewProjection(const vec3& eye) {
+    return perspective(radians(45.0f), 4.0f / 3.0f, 0.1f, 100.0f) *
+        lookAt(eye, vec3(0.0f, 0.0f, -2.0f), vec3(0.0f, 1.0f, 0.0f));
+}
+
+/* A 2x2 wall across the view at z = 0 */
+static void addWall(OcclusionCuller& culler) {
+    vector<vec3> wall = {vec3(-1.0f, -1.0f, 0.0f), vec3(1.0f, -1.0f, 0.0f),
+                         vec3(1.0f, 1.0f, 0.0f), vec3(-1.0f, 1.0f, 0.0f)};
+    culler.addOccluder(wall, {0, 1, 2, 0, 2, 3});
+}
+
+static BoundingBox box(const vec3& center, float halfSize) {
+    BoundingBox b = {center - vec3(halfSize), center + vec3(halfSize)};
+    return b;
+}
+
+static void testWall() {
+    mat4 view = viewProjection(EYE);
+    OcclusionCuller culler(256, 192);
+    culler.begin(&view);
+    addWall(culler);
+    culler.finish();
+    CHECK(culler.occluderTriangles == 2);
+
+    CullingStats stats;
+    CHECK(!culler.visible(box(vec3(0.0f, 0.0f, -1.75f), 0.25f), &stats));  // behind
+    CHECK(culler.visible(box(vec3(1.75f, 0.0f, -1.75f), 0.25f), &stats));  // beside
+    CHECK(culler.visible(box(vec3(1.25f, 0.0f, -1.75f), 0.25f), &stats));  // peeking out
+    CHECK(culler.visible(box(vec3(0.0f, 0.0f, 1.25f), 0.25f), &stats));    // in front
+    CHECK(culler.visible(box(vec3(0.0f, 0.0f, 0.0f), 0.25f), &stats));     // through it
+    CHECK(!culler.visible(box(vec3(0.0f, 6.0f, -1.75f), 0.25f), &stats));  // off screen
+    CHECK(stats.visible == 4 && stats.culled == 2);
+}
+
+/* A box hidden from one eye only is visible, as the other eye sees past the wall */
+static void testViews() {
+    mat4 views[2] = {viewProjection(EYE), viewProjection(vec3(4.0f, 0.0f, 5.0f))};
+    OcclusionCuller culler(256, 192, 2);
+    culler.begin(views);
+    addWall(culler);
+    culler.finish();
+    CHECK(culler.occluderTriangles == 2);
+    CHECK(culler.visible(box(vec3(0.0f, 0.0f, -1.75f), 0.25f)));
+    CHECK(!culler.visible(box(vec3(-0.5f, 0.0f, -0.5f), 0.1f)));
+}
+
+/**
+* Random boxes: none is hidden while a point of it is seen, i.e. in view and
+* not behind the wall, which a grid of points over the box checks
+*/
+static void testConservative() {
+    mat4 view = viewProjection(EYE);
+    OcclusionCuller culler(256, 192);
+    culler.begin(&view);
+    addWall(culler);
+    culler.finish();
+
+    mt19937 generator(2);
+    uniform_real_distribution<float> uniform(-1.0f, 1.0f);
+    int hidden = 0;
+    for (int t = 0; t < 3000; t++) {
+        vec3 center(2.0f * uniform(generator), 2.0f * uniform(generator),
+                    3.0f * uniform(generator) - 1.0f);
+        vec3 halfSize = 0.3f * abs(vec3(uniform(generator), uniform(generator),
+                                        uniform(generator))) + vec3(0.01f);
+        BoundingBox b = {center - halfSize, center + halfSize};
+        if (culler.visible(b)) continue;
+        hidden++;
+
+        bool seen = false;
+        for (int i = 0; i <= 8; i++) {
+            for (int j = 0; j <= 8; j++) {
+                for (int k = 0; k <= 8; k++) {
+                    vec3 p = b.lower + (b.upper - b.lower) * vec3(i, j, k) / 8.0f;
+                    vec4 clip = view * vec4(p, 1.0f);
+                    if (clip.w <= 0.0f || any(greaterThan(abs(vec3(clip) / clip.w), vec3(1.0f)))) {
+                        continue;
+                    }
+                    // where the ray from the eye crosses the wall's plane
+                    vec3 crossing = EYE + (p - EYE) * (EYE.z / (EYE.z - p.z));
+                    seen |= p.z >= 0.0f || abs(crossing.x) > 1.0f || abs(crossing.y) > 1.0f;
+                }
+            }
+        }
+        CHECK(!seen);
+    }
+    CHECK(hidden > 0);
+}
+
+int main() {
+    testWall();
+    testViews();
+    testConservative();
+    return CHECK_RESULT();
+}
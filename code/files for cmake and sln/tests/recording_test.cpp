@@ -0,0 +1,105 @@
+#include <cmath>
+#include <cstdio>
+#include <stdexcept>
+#include "common/recording.h"
+#include "tests/check.h"
+
+using namespace std;
+
+static const char* PATH = "recording_test.vrsr";
+
+/* A smooth and a noisy channel, the latter predicting badly */
+static vector<float> frameValues(int f) {
+    return {f / 90.0f, sin(0.1f * f), static_cast<float>((f * 7919) % 13) - 6.0f};
+}
+
+/* Drop the last bytes of the file, e.g. the index as if close() never ran */
+static void truncateFile(const char* path, long bytes) {
+    FILE* file = fopen(path, "rb");
+    CHECK(file != NULL);
+    if (file == NULL) return;
+    vector<char> data;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        data.insert(data.end(), buffer, buffer + n);
+    }
+    fclose(file);
+    file = fopen(path, "wb");
+    fwrite(&data[0], 1, data.size() - bytes, file);
+    fclose(file);
+}
+
+static void testRoundTrip(bool indexed) {
+    const vector<float> steps = {1e-4f, 1e-3f, 0.5f};
+    const int frames = 1000, framesPerBlock = 64, blocks = 16;
+    {
+        SessionRecorder recorder(PATH, steps, framesPerBlock);
+        for (int f = 0; f < frames; f++) {
+            recorder.append(frameValues(f));
+        }
+    }
+    if (!indexed) {
+        // offsets, total frames, block count and magic
+        truncateFile(PATH, blocks * 8 + 16);
+    }
+
+    SessionReplayer replayer(PATH);
+    CHECK(replayer.channelCount() == 3);
+    CHECK(replayer.framesPerBlock() == framesPerBlock);
+    CHECK(replayer.frameCount() == frames);
+    CHECK(replayer.blockCount() == blocks);
+
+    // sequential playback, then seeks backwards and across blocks
+    vector<float> values;
+    for (int f = 0; f < replayer.frameCount(); f++) {
+        replayer.readFrame(f, values);
+        vector<float> expected = frameValues(f);
+        for (size_t c = 0; c < steps.size(); c++) {
+            CHECK(fabs(values[c] - expected[c]) <= 0.5f * steps[c] + 1e-6f);
+        }
+    }
+    for (int f : {999, 0, 500, 63, 64, 1, 640}) {
+        replayer.readFrame(f, values);
+        vector<float> expected = frameValues(f);
+        for (size_t c = 0; c < steps.size(); c++) {
+            CHECK(fabs(values[c] - expected[c]) <= 0.5f * steps[c] + 1e-6f);
+        }
+    }
+    CHECK_THROWS(replayer.readFrame(-1, values));
+    CHECK_THROWS(replayer.readFrame(replayer.frameCount(), values));
+}
+
+static void testInvalidSteps() {
+    CHECK_THROWS(SessionRecorder(PATH, vector<float>()));
+    CHECK_THROWS(SessionRecorder(PATH, {0.1f, 0.0f}));
+    CHECK_THROWS(SessionRecorder(PATH, {-0.1f}));
+    CHECK_THROWS(SessionRecorder(PATH, {0.1f}, 0));
+}
+
+static void testCorruptIndex() {
+    {
+        SessionRecorder recorder(PATH, {0.01f});
+        for (int f = 0; f < 10; f++) {
+            recorder.append({f * 0.1f});
+        }
+    }
+    // a block count past the start of the file
+    FILE* file = fopen(PATH, "r+b");
+    CHECK(file != NULL);
+    if (file == NULL) return;
+    fseek(file, -8, SEEK_END);
+    uint32_t blocks = 0xFFFFFFF0u;
+    fwrite(&blocks, sizeof(blocks), 1, file);
+    fclose(file);
+    CHECK_THROWS(SessionReplayer replayer(PATH));
+}
+
+int main() {
+    testRoundTrip(true);
+    testRoundTrip(false);
+    testInvalidSteps();
+    testCorruptIndex();
+    remove(PATH);
+    return CHECK_RESULT();
+}
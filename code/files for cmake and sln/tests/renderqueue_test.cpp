@@ -0,0 +1,131 @@
+#include <cstdint>
+#include <random>
+#include <glm/gtc/matrix_transform.hpp>
+#include "common/renderqueue.h"
+#include "tests/check.h"
+
+using namespace glm;
+using namespace std;
+
+// programs and materials are only compared by address, so stand-ins do
+static ShaderProgram* const PROGRAM_A = reinterpret_cast<ShaderProgram*>(uintptr_t(0x1000));
+static ShaderProgram* const PROGRAM_B = reinterpret_cast<ShaderProgram*>(uintptr_t(0x2000));
+static const int MATERIALS[4] = {};
+static const mat4 MODEL_MATRIX;
+
+static DrawPacket packet(ShaderProgram* program, int material, GLenum polygonMode,
+                         GLuint vertexArray, int item) {
+    DrawPacket p = {0, program, &MATERIALS[material], polygonMode, vertexArray, 36,
+                    &MODEL_MATRIX, item};
+    return p;
+}
+
+/* A draw at the depth ahead of an eye at the origin looking down -z */
+static void add(RenderQueue& queue, const DrawPacket& p, float depth) {
+    queue.add(p, vec3(0.0f, 1.0f, -depth));
+}
+
+/**
+* Program, then material and polygon mode, then vertex array, each in the
+* order first seen, then front to back
+*/
+static void testOrder() {
+    RenderQueue queue;
+    const DrawPacket packets[] = {
+        packet(PROGRAM_A, 0, GL_FILL, 1, 0),
+        packet(PROGRAM_B, 0, GL_FILL, 1, 1),
+        packet(PROGRAM_A, 1, GL_FILL, 1, 2),
+        packet(PROGRAM_A, 0, GL_FILL, 2, 3),
+        packet(PROGRAM_A, 0, GL_FILL, 1, 4),
+        packet(PROGRAM_A, 0, GL_LINE, 1, 5)
+    };
+    const float depths[] = {5.0f, 1.0f, 2.0f, 3.0f, 1.0f, 0.5f};
+    const int expected[] = {4, 0, 3, 5, 2, 1};
+
+    queue.begin(mat4());
+    for (int i = 0; i < 6; i++) add(queue, packets[i], depths[i]);
+    queue.sort();
+    CHECK(queue.size() == 6);
+    for (int i = 0; i < 6; i++) CHECK(queue.sorted(i).item == expected[i]);
+
+    CHECK(queue.unsorted.draws == 6 && queue.submitted.draws == 6);
+    CHECK(queue.unsorted.programChanges == 3 && queue.submitted.programChanges == 2);
+    CHECK(queue.unsorted.materialChanges == 5 && queue.submitted.materialChanges == 4);
+    CHECK(queue.unsorted.vertexArrayChanges == 3 && queue.submitted.vertexArrayChanges == 3);
+
+    // the ids are kept across frames, so the order does not depend on the
+    // order of the adds
+    queue.begin(mat4());
+    for (int i = 5; i >= 0; i--) add(queue, packets[i], depths[i]);
+    queue.sort();
+    for (int i = 0; i < 6; i++) CHECK(queue.sorted(i).item == expected[i]);
+    CHECK(queue.submitted.draws == 12 && queue.submitted.programChanges == 4);
+}
+
+/**
+* Many draws of mixed state at a few depths: keys ascend, draws of equal keys
+* keep the order they were added in, and equal state goes front to back
+*/
+static void testStable() {
+    mt19937 generator(5);
+    uniform_int_distribution<int> pick(0, 1 << 20);
+    RenderQueue queue(10.0f);
+    mat4 view = lookAt(vec3(0.0f, 0.0f, 4.0f), vec3(0.0f), vec3(0.0f, 1.0f, 0.0f));
+    queue.begin(view);
+    const int n = 2000;
+    vector<float> depth(n);
+    for (int i = 0; i < n; i++) {
+        int r = pick(generator);
+        DrawPacket p = packet(r % 2 ? PROGRAM_A : PROGRAM_B, (r >> 1) % 4,
+                              (r >> 3) % 3 ? GL_FILL : GL_LINE, 1 + (r >> 5) % 3, i);
+        // depths beyond the range and behind the eye included
+        depth[i] = ((r >> 7) % 14) - 2.0f;
+        queue.add(p, vec3(0.0f, 0.0f, 4.0f - depth[i]));
+    }
+    queue.sort();
+
+    const uint64_t stateBits = ~uint64_t(0) << 28;
+    for (int i = 1; i < n; i++) {
+        const DrawPacket& a = queue.sorted(i - 1);
+        const DrawPacket& b = queue.sorted(i);
+        CHECK(a.key <= b.key);
+        if (a.key == b.key) CHECK(a.item < b.item);
+        if ((a.key & stateBits) == (b.key & stateBits)) {
+            CHECK(std::min(std::max(depth[a.item], 0.0f), 10.0f) <=
+                  std::min(std::max(depth[b.item], 0.0f), 10.0f));
+        }
+    }
+
+    // two programs, then a material and mode per program and so on
+    CHECK(queue.submitted.programChanges == 2);
+    CHECK(queue.submitted.materialChanges == 2 * 4 * 2);
+    CHECK(queue.submitted.vertexArrayChanges <= 2 * 4 * 2 * 3);
+    CHECK(queue.unsorted.programChanges > n / 3);
+}
+
+/* Keys that share every byte skip every pass and keep the order added */
+static void testEqualKeys() {
+    RenderQueue queue;
+    queue.begin(mat4());
+    for (int i = 0; i < 300; i++) add(queue, packet(PROGRAM_A, 2, GL_FILL, 7, i), 3.0f);
+    // and keys differing in the depth only
+    for (int i = 300; i < 600; i++) {
+        add(queue, packet(PROGRAM_A, 2, GL_FILL, 7, i), 3.0f + (600 - i) * 0.01f);
+    }
+    queue.sort();
+    for (int i = 0; i < 300; i++) CHECK(queue.sorted(i).item == i);
+    for (int i = 300; i < 600; i++) CHECK(queue.sorted(i).item == 899 - i);
+    CHECK(queue.submitted.programChanges == 1 && queue.submitted.materialChanges == 1 &&
+          queue.submitted.vertexArrayChanges == 1);
+
+    queue.begin(mat4());
+    queue.sort();
+    CHECK(queue.size() == 0);
+}
+
+int main() {
+    testOrder();
+    testStable();
+    testEqualKeys();
+    return CHECK_RESULT();
+}
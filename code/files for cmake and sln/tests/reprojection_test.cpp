@@ -0,0 +1,80 @@
+#include <cmath>
+#include "common/reprojection.h"
+#include "tests/check.h"
+
+using namespace std;
+
+static bool near(double a, double b) {
+    return fabs(a - b) < 1e-9;
+}
+
+/* Vsyncs every 10 ms from 0, 5 ms to draw and 1 ms to reproject, 2 ms margin */
+static FramePacer pacer() {
+    FramePacer framePacer(0.010, 0.0);
+    framePacer.renderMeasured(0.005);
+    framePacer.reprojectionMeasured(0.001);
+    return framePacer;
+}
+
+static void testDecide() {
+    FramePacer framePacer = pacer();
+    CHECK(near(framePacer.margin, 0.002));
+    CHECK(near(framePacer.targetVsync(0.001), 0.010));
+
+    // ready in time, or not ready with time left to draw
+    CHECK(framePacer.decide(0.001, true) == FRAME_RENDER);
+    CHECK(framePacer.decide(0.001, false) == FRAME_WAIT);
+    CHECK(near(framePacer.nextDecision(0.001), 0.003));
+
+    // past the render deadline, only a reprojection makes this vsync
+    CHECK(framePacer.decide(0.004, false) == FRAME_REPROJECT);
+    CHECK(near(framePacer.nextDecision(0.004), 0.007));
+
+    // past both deadlines, a frame waits for the following vsync
+    CHECK(framePacer.decide(0.0095, false) == FRAME_WAIT);
+    CHECK(framePacer.decide(0.0095, true) == FRAME_RENDER);
+    CHECK(near(framePacer.nextDecision(0.0095), 0.010));
+}
+
+/* A late frame gets its vsync reprojected and is drawn for the next one */
+static void testLateFrame() {
+    FramePacer framePacer = pacer();
+    CHECK(framePacer.decide(0.004, true) == FRAME_REPROJECT);
+    framePacer.presented(0.010, true);
+    CHECK(framePacer.reprojectedFrames == 1 && framePacer.renderedFrames == 0);
+
+    // a present returning early does not target the same vsync again
+    CHECK(near(framePacer.targetVsync(0.009), 0.020));
+    CHECK(framePacer.decide(0.0105, true) == FRAME_RENDER);
+    framePacer.presented(0.020, false);
+    CHECK(framePacer.renderedFrames == 1);
+    CHECK(near(framePacer.targetVsync(0.0201), 0.030));
+}
+
+static void testSynchronize() {
+    FramePacer framePacer = pacer();
+    framePacer.synchronize(0.0133);
+    CHECK(near(framePacer.targetVsync(0.014), 0.0233));
+    CHECK(near(framePacer.targetVsync(0.030), 0.0333));
+    CHECK(framePacer.decide(0.0245, true) == FRAME_RENDER);
+    CHECK(framePacer.decide(0.0275, false) == FRAME_REPROJECT);
+}
+
+/* Estimates follow a slower frame at once and a faster one slowly */
+static void testEstimates() {
+    FramePacer framePacer = pacer();
+    framePacer.renderMeasured(0.008);
+    CHECK(near(framePacer.renderEstimate, 0.008));
+    framePacer.renderMeasured(0.004);
+    CHECK(near(framePacer.renderEstimate, 0.0076));
+    framePacer.reprojectionMeasured(0.0005);
+    CHECK(near(framePacer.reprojectionEstimate, 0.00095));
+}
+
+int main() {
+    testDecide();
+    testLateFrame();
+    testSynchronize();
+    testEstimates();
+    return CHECK_RESULT();
+}
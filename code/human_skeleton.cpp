@@ -22,6 +22,9 @@
 #include <common/camera.h>
 #include <common/model.h>
 #include <common/skeleton.h>
+#include <common/bvh.h>
+#include <common/ik.h>
+#include <common/motionmatching.h>
 
 using namespace std;
 using namespace glm;
@@ -57,6 +60,13 @@ GLuint surfaceVAO, surfaceVerticesVBO, surfacesBoneIndecesVBO, maleBoneIndicesVB
 Drawable* segment, * skeletonSkin, * sk;
 GLuint useSkinningLocation, boneTransformationsLocation;
 Skeleton* skeleton;
+BVHClip* mocap = NULL; // optional motion capture clip, given on the command line
+string mocapPath;
+IKSolver* footIK;
+int rightFootChain, leftFootChain;
+MotionDatabase* motionDatabase = NULL; // pose search over the mocap clip
+const int MOTION_SEARCH_LEAVES = 8; // bounds a search to a few hundred frames
+float mocapTime = 0;
 
 struct Light {
     glm::vec4 La;
@@ -97,6 +107,27 @@ enum JointName {
     B0 = 0, B1, F1R, F1L, F2R, F2L, F3R, F3L, H1R, H1L, H2R, H2L, JOINTS
 };
 
+// BVH channels (CMU joint naming) that drive the generalized coordinates when
+// a motion capture clip is loaded; positions are converted from cm
+static const vector<BVHChannelMapping> bvhMapping = {
+    {"Hips", ZPOSITION, CoordinateName::B0_T_Z, 0.03f},
+    {"Hips", YROTATION, CoordinateName::B0_R_Y, 1.0f},
+    {"Chest", YROTATION, CoordinateName::B1_R_Y, 1.0f},
+    {"Chest", XROTATION, CoordinateName::B1_R_X, 1.0f},
+    {"RightUpLeg", XROTATION, CoordinateName::F1R_R_X, 1.0f},
+    {"LeftUpLeg", XROTATION, CoordinateName::F1L_R_X, 1.0f},
+    {"RightLeg", XROTATION, CoordinateName::F2R_R_X, 1.0f},
+    {"LeftLeg", XROTATION, CoordinateName::F2L_R_X, 1.0f},
+    {"RightFoot", XROTATION, CoordinateName::F3R_R_X, 1.0f},
+    {"LeftFoot", XROTATION, CoordinateName::F3L_R_X, 1.0f},
+    {"RightArm", YROTATION, CoordinateName::H1R_R_Y, 1.0f},
+    {"LeftArm", YROTATION, CoordinateName::H1L_R_Y, 1.0f},
+    {"RightArm", ZROTATION, CoordinateName::H1R_R_Z, 1.0f},
+    {"LeftArm", ZROTATION, CoordinateName::H1L_R_Z, 1.0f},
+    {"RightForeArm", YROTATION, CoordinateName::H2R_R_Y, 1.0f},
+    {"LeftForeArm", YROTATION, CoordinateName::H2L_R_Y, 1.0f}
+};
+
 // default pose used for binding the skeleton and the mesh
 static const map<int, float> bindingPose = {
     {CoordinateName::B0_T_Z, 0.0f},
@@ -356,6 +387,49 @@ void createContext() {
     h2lJoint->parent = h1lJoint;
     skeleton->joints[JointName::H2L] = h2lJoint;
 
+    // leg chains for foot placement; the leg DOFs rotate about X so the chains
+    // live in the (y, z) plane, the hinges are at the skinning region borders
+    footIK = new IKSolver();
+    rightFootChain = footIK->addChain({
+        {vec2(3.1f, 0), vec2(1.8f, 0), vec2(0.27f, 0), vec2(0.0f, 0.5f)},
+        {CoordinateName::F1R_R_X, CoordinateName::F2R_R_X, CoordinateName::F3R_R_X},
+        {vec2(-90, 60), vec2(-150, 0), vec2(-45, 45)}});
+    leftFootChain = footIK->addChain({
+        {vec2(3.1f, 0), vec2(1.8f, 0), vec2(0.27f, 0), vec2(0.0f, 0.5f)},
+        {CoordinateName::F1L_R_X, CoordinateName::F2L_R_X, CoordinateName::F3L_R_X},
+        {vec2(-90, 60), vec2(-150, 0), vec2(-45, 45)}});
+
+    // motion matching over the mocap clip: feet and a half second of hip
+    // trajectory, computed with the clip's own skeleton once per take and
+    // cached next to it, since decoding a long take on every start would undo
+    // its streaming
+    if (mocap) {
+        int hips = mocap->findJoint("Hips");
+        int rightFoot = mocap->findJoint("RightFoot");
+        int leftFoot = mocap->findJoint("LeftFoot");
+        if (hips < 0 || rightFoot < 0 || leftFoot < 0) {
+            throw runtime_error("BVH: motion matching needs Hips, RightFoot and LeftFoot");
+        }
+        int step = std::max(static_cast<int>(0.166f / mocap->frameTime), 1);
+        MotionFeatureLayout layout = {hips, {rightFoot, leftFoot}, {step, 2 * step, 3 * step}};
+        string featuresPath = mocapPath + ".features";
+        motionDatabase = new MotionDatabase(layout);
+        if (!motionDatabase->loadFeatures(featuresPath) ||
+            motionDatabase->frameCount() != mocap->frameCount) {
+            delete motionDatabase;
+            motionDatabase = new MotionDatabase(layout);
+            Skeleton mocapSkeleton(0, 0, 0);
+            mocap->createJoints(&mocapSkeleton);
+            motionDatabase->addClip(&mocapSkeleton, mocap->frameCount, [](int frame) {
+                return mocap->getJointLocalTransformations(frame);
+            });
+            if (!motionDatabase->saveFeatures(featuresPath)) {
+                cout << "Can't cache the motion features: " << featuresPath << endl;
+            }
+        }
+        motionDatabase->build();
+    }
+
     // skin
     skeletonSkin = new Drawable("models/human.obj");
     sk = new Drawable("models/human.obj");
@@ -375,6 +449,9 @@ void free() {
     delete skeleton;
     delete skeletonSkin;
     delete sk;
+    delete mocap;
+    delete footIK;
+    delete motionDatabase;
     glDeleteBuffers(1, &surfaceVAO);
     glDeleteVertexArrays(1, &surfaceVerticesVBO);
     glDeleteVertexArrays(1, &surfacesBoneIndecesVBO);
@@ -433,6 +510,44 @@ void mainLoop() {
         q[CoordinateName::H2R_R_Y] = 100;
         q[CoordinateName::H2L_R_Y] = 100;
 
+        // motion capture overrides the mapped coordinates, frames are decoded
+        // lazily so long takes start immediately
+        if (mocap) {
+            // every 0.1 s look for a frame that continues the playing pose
+            // along the desired trajectory, J and L bend it left and right
+            static float previousTime = time, searchTime = time;
+            mocapTime += time - previousTime;
+            previousTime = time;
+            if (time - searchTime > 0.1f) {
+                searchTime = time;
+                int playing = static_cast<int>(mocapTime / mocap->frameTime) %
+                    motionDatabase->frameCount();
+                auto query = motionDatabase->getFeatures(playing);
+                float steer = (glfwGetKey(window, GLFW_KEY_J) == GLFW_PRESS) -
+                    (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS);
+                for (int d = motionDatabase->trajectoryOffset(), k = 1;
+                     d < motionDatabase->dimensions(); d += 4, k++) {
+                    // position and heading of the k-th sample, turned about Y
+                    float a = 0.3f * steer * k;
+                    for (int p = d; p < d + 4; p += 2) {
+                        float x = query[p], z = query[p + 1];
+                        query[p] = cos(a) * x + sin(a) * z;
+                        query[p + 1] = -sin(a) * x + cos(a) * z;
+                    }
+                }
+                int best = motionDatabase->search(query, NULL, MOTION_SEARCH_LEAVES);
+                if (best >= 0 && abs(best - playing) > 10) {
+                    mocapTime = best * mocap->frameTime;
+                }
+            }
+            mocap->sampleCoordinates(mocapTime, bvhMapping, q);
+        } else {
+            // place the feet on the ground, stepping forward and back
+            footIK->setTarget(rightFootChain, vec2(0.0f, 0.5f + 0.6f * sin(time)));
+            footIK->setTarget(leftFootChain, vec2(0.0f, 0.5f - 0.6f * sin(time)));
+            footIK->solve(q);
+        }
+
         // Task 4.1: draw the skin using wireframe mode
         //*/
         skeletonSkin->bind();
@@ -528,8 +643,12 @@ void initialize() {
     camera = new Camera(window);
 }
 
-int main(void) {
+int main(int argc, char* argv[]) {
     try {
+        if (argc > 1) {
+            mocapPath = argv[1];
+            mocap = new BVHClip(mocapPath);
+        }
         initialize();
         createContext();
         mainLoop();
@@ -543,4 +662,4 @@ int main(void) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
\ No newline at end of file